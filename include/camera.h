@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <Eigen/Dense>
@@ -9,6 +10,19 @@
 namespace cispp {
 
 
+/**
+ * @brief Options for the sensor model stage at the end of Capture (see Camera::Digitise)
+ * 
+ */
+struct SensorOptions
+{
+    bool enable {false};  // apply the sensor model. If false, pixels are the photon counts truncated to integers.
+    bool noise {true};    // photon shot noise and read noise. If false, the mean signal is only gained and quantised.
+    uint64_t seed {0};    // selects the random number stream
+    uint64_t frame {0};   // frame index, which keys the random numbers together with the pixel index
+};
+
+
 class Camera
 {
     public:
@@ -142,6 +156,16 @@ class Camera
      */
     double GetPixelatedPhaseMask(double x, double y);
 
+    /**
+     * @brief Get pixelated phase mask values for a row segment of pixels
+     * 
+     * @param iy y-index of pixel row
+     * @param ix0 x-index of first pixel
+     * @param ix1 x-index one past the last pixel
+     * @param mask output phase mask values, length ix1 - ix0
+     */
+    void GetPixelatedPhaseMaskRow(size_t iy, size_t ix0, size_t ix1, double* mask) const;
+
     /**
      * @brief Get mueller matrix by xy-position in metres
      * 
@@ -150,6 +174,28 @@ class Camera
      * @return Eigen::Matrix4d 
      */
     Eigen::Matrix4d GetMuellerMatrix(double x, double y);
+
+    /**
+     * @brief Convert photon counts to camera counts, for a run of consecutive pixels
+     * 
+     * With the sensor model enabled, the mean signal is quantum_efficiency * photons electrons. Photon shot noise is 
+     * Poisson (exact below 32 electrons, Gaussian above) and read noise is Gaussian with cam_noise electrons RMS. 
+     * Electrons are divided by epercount, rounded to the nearest count and clipped to [0, 2^bit_depth - 1].
+     * 
+     * Random numbers come from Philox4x32-10 keyed on (seed, frame, pixel), one counter per pixel, so output depends 
+     * only on the pixel index and not on how the sensor is split between calls or threads. Pixels are processed in 
+     * fixed blocks so that every pixel goes through the same (vectorised) code.
+     * 
+     * @tparam Real float or double
+     * @param photons mean photon count per pixel, n long
+     * @param n number of pixels
+     * @param pixel0 index of the first pixel on the sensor, ix + iy * sensor_format_x
+     * @param sensor 
+     * @param counts output camera counts, n long
+     */
+    template <typename Real>
+    void Digitise(const Real* photons, size_t n, uint64_t pixel0, const SensorOptions& sensor, 
+                  unsigned short int* counts) const;
 };
 
 
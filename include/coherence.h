@@ -18,7 +18,70 @@ namespace cispp {
  * @param wld wavelength to which the interferometer delay corresponds, in metres
  * @return temporal coherence in photons. 
  */
-std::complex<double> calculate_coherence(std::vector<double> wavelength, std::vector<double> spec_flux, double delay, double wld);
+std::complex<double> calculate_coherence(const std::vector<double>& wavelength, const std::vector<double>& spec_flux, 
+                                         double delay, double wld);
+
+
+/**
+ * @brief Temporal coherence of one spectrum at many delays
+ *
+ * The coherence at delay tau is the sum over wavelengths of w_i exp(i tau k_i), with k_i = wld / wavelength_i and w_i
+ * the spectral flux times its trapezoidal-rule weight. Both are computed once, in the constructor, and stored as
+ * contiguous arrays (the real and imaginary parts of the phasors are also kept in separate arrays) so that the
+ * wavelength loops vectorise.
+ *
+ * On a uniform grid of delays the phasors are advanced by a fixed rotation exp(i dtau k_i) from one delay to the next
+ * rather than evaluating sin and cos, with an exact re-evaluation every resync_interval delays to stop rounding errors
+ * building up. Arbitrary delays each cost one sin and cos per wavelength.
+ *
+ * Evaluate is const and may be called from several threads at once. EvaluateUniform makes no allocations, but advances
+ * phasors held by the evaluator, so it is non-const: give each thread its own copy.
+ */
+class CoherenceEvaluator
+{
+    public:
+
+    /**
+     * @param wavelength wavelength in metres
+     * @param spec_flux photon spectral flux in photons/metre
+     * @param wld wavelength to which the interferometer delays correspond, in metres
+     */
+    CoherenceEvaluator(const std::vector<double>& wavelength, const std::vector<double>& spec_flux, double wld);
+
+    /**
+     * @brief Coherence at arbitrary delays
+     *
+     * @param delay interferometer delays in radians, n long
+     * @param n number of delays
+     * @param coherence output, n long, in photons
+     */
+    void Evaluate(const double* delay, size_t n, std::complex<double>* coherence) const;
+
+    /**
+     * @brief Coherence at the uniformly-spaced delays delay0 + j * ddelay, j = 0 ... n - 1, by phasor rotation
+     *
+     * @param delay0 first delay in radians
+     * @param ddelay delay step in radians
+     * @param n number of delays
+     * @param coherence output, n long, in photons
+     */
+    void EvaluateUniform(double delay0, double ddelay, size_t n, std::complex<double>* coherence);
+
+    size_t resync_interval {64};  // uniform grid steps between exact phasor evaluations
+
+    private:
+
+    std::vector<double> k;       // wld / wavelength
+    std::vector<double> weight;  // spectral flux x trapezoidal-rule weight
+    
+    // phasor scratch for EvaluateUniform
+    std::vector<double> re, im, step_re, step_im;
+
+    /**
+     * @brief Set the phasors to weight * exp(i delay k) and return their sum
+     */
+    std::complex<double> SetPhasors(double delay);
+};
 
 
 /**
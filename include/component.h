@@ -1,12 +1,15 @@
 
 #pragma once
 
+#include <memory>
 #include <string>
+#include <vector>
 #include <iostream>
 #include <cmath>
 #include <Eigen/Dense>
 
 #include "include/material.h"
+#include "include/mueller.h"
 
 namespace cispp {
 
@@ -18,6 +21,98 @@ namespace cispp {
 Eigen::Matrix4d GetRotationMatrix(double angle);
 
 
+/**
+ * @brief Directions of a batch of light rays through a component, as angles and as their sines / cosines
+ * 
+ */
+struct RayBatch
+{
+    const double* incidence_angle;  // radians
+    const double* azimuthal_angle;  // radians
+    const double* sin_inc;          // sine of incidence angle
+    const double* sin_azim;         // sine of azimuthal angle
+    const double* cos_azim;         // cosine of azimuthal angle
+    size_t n;                       // number of rays
+};
+
+
+/**
+ * @brief Single-precision copy of a RayBatch
+ * 
+ */
+struct RayBatchF
+{
+    const float* incidence_angle;  // radians
+    const float* azimuthal_angle;  // radians
+    const float* sin_inc;          // sine of incidence angle
+    const float* sin_azim;         // sine of azimuthal angle
+    const float* cos_azim;         // cosine of azimuthal angle
+    size_t n;                      // number of rays
+};
+
+
+class Component;
+
+
+/**
+ * @brief A component's delay at a fixed set of wavelengths, with the wavelength-dependent work done once up front
+ * 
+ */
+class DelayTable
+{
+    public:
+
+    std::vector<double> wavelength;
+
+    DelayTable(const std::vector<double>& wavelength)
+    : wavelength(wavelength)
+    {}
+
+    virtual ~DelayTable() = default;
+
+    /**
+     * @brief Retardance in radians for a batch of light rays at one of the tabulated wavelengths
+     * 
+     * @param iwl wavelength index
+     * @param rays ray directions
+     * @param delay output retardances (radians), length rays.n
+     */
+    virtual void GetDelayBatch(size_t iwl, const RayBatch& rays, double* delay) const = 0;
+
+    /**
+     * @brief Retardance in radians along the optical axis (zero incidence angle) at one of the tabulated wavelengths
+     * 
+     * @param iwl wavelength index
+     * @return double 
+     */
+    virtual double GetDelayOnAxis(size_t iwl) const = 0;
+
+    /**
+     * @brief Difference between the retardance and the on-axis retardance, in single precision, for a batch of light 
+     * rays at one of the tabulated wavelengths
+     * 
+     * For a thick crystal the retardance is ~1e5 radians, so it cannot be held in a float to the accuracy needed for 
+     * the fringe phase. The on-axis part is instead kept in double precision and reduced modulo 2 pi (see 
+     * GetDelayOnAxisReduced), while the much smaller deviation from it is evaluated here.
+     * 
+     * @param iwl wavelength index
+     * @param rays ray directions
+     * @param ddelay output retardance deviations (radians), length rays.n
+     */
+    virtual void GetDelayDeviationBatch(size_t iwl, const RayBatchF& rays, float* ddelay) const = 0;
+
+    /**
+     * @brief On-axis retardance reduced to [-pi, pi], in single precision
+     * 
+     * @param iwl wavelength index
+     * @return float 
+     */
+    float GetDelayOnAxisReduced(size_t iwl) const {
+        return static_cast<float>(std::remainder(GetDelayOnAxis(iwl), 2 * M_PI));
+    }
+};
+
+
 /**
  * @brief Interferometer component (abstract base class)
  * 
@@ -77,6 +172,50 @@ class Component
      */
     virtual double GetDelay(double wavelength, double incidence_angle, double azimuthal_angle) = 0;
 
+    /**
+     * @brief Retardance in radians for a batch of light rays at a single wavelength
+     * 
+     * @param wavelength wavelength of light rays (metres)
+     * @param incidence_angle incidence angles of light rays (radians), length n
+     * @param azimuthal_angle azimuthal angles of light rays (radians), length n
+     * @param delay output retardances (radians), length n
+     * @param n number of rays
+     */
+    virtual void GetDelayBatch(double wavelength, const double* incidence_angle, const double* azimuthal_angle, 
+                               double* delay, size_t n);
+
+    /**
+     * @brief Retardance in radians for a single light ray at a batch of wavelengths
+     * 
+     * @param wavelength wavelengths of light ray (metres), length n
+     * @param incidence_angle incidence angle of light ray (radians)
+     * @param azimuthal_angle azimuthal angle of light ray (radians)
+     * @param delay output retardances (radians), length n
+     * @param n number of wavelengths
+     */
+    virtual void GetDelayBatch(const double* wavelength, double incidence_angle, double azimuthal_angle, 
+                               double* delay, size_t n);
+
+    /**
+     * @brief Retardance in radians for a batch of light rays at a single wavelength, with precalculated ray geometry
+     * 
+     * @param wavelength wavelength of light rays (metres)
+     * @param rays ray directions
+     * @param delay output retardances (radians), length rays.n
+     */
+    virtual void GetDelayBatch(double wavelength, const RayBatch& rays, double* delay);
+
+    /**
+     * @brief Tabulate the wavelength-dependent part of the retardance, for repeated batch evaluation
+     * 
+     * The table refers back to this component, so must not outlive it. Delays from the table agree exactly with 
+     * GetDelay.
+     * 
+     * @param wavelength wavelengths of light (metres)
+     * @return std::unique_ptr<DelayTable> 
+     */
+    virtual std::unique_ptr<DelayTable> GetDelayTable(const std::vector<double>& wavelength);
+
     /**
     * @brief Calculate Mueller matrix for light ray
     * 
@@ -87,6 +226,33 @@ class Component
     */
     virtual Eigen::Matrix4d GetMuellerMatrix(double wavelength, double incidence_angle, double azimuthal_angle);
 
+    /**
+     * @brief Right-multiply a row vector by the Mueller matrix for light ray, row -> row * M, without building M
+     * 
+     * Propagating the S0 row of an instrument's Mueller matrix this way gives the intensity at the camera.
+     * 
+     * @param wavelength wavelength of light ray (metres)
+     * @param incidence_angle incidence angle of light ray (radians)
+     * @param azimuthal_angle azimuthal angle of light ray (radians) 
+     * @param row row vector, modified in place
+     */
+    virtual void ApplyMuellerRow(double wavelength, double incidence_angle, double azimuthal_angle, 
+                                 Eigen::RowVector4d& row);
+
+    /**
+     * @brief Whether behaviour depends on ray incidence / azimuthal angle
+     */
+    virtual bool IsAngleDependent() {
+        return true;
+    }
+
+    /**
+     * @brief Whether behaviour depends on wavelength
+     */
+    virtual bool IsWavelengthDependent() {
+        return true;
+    }
+
     virtual bool IsIdealPolariser() {
         return false;
     }
@@ -98,6 +264,18 @@ class Component
     virtual bool IsIdealQuarterWaveplate() {
         return false;
     }
+
+    protected:
+
+    /**
+     * @brief Mueller operator for light ray, in the component frame
+     * 
+     * @param wavelength wavelength of light ray (metres)
+     * @param incidence_angle incidence angle of light ray (radians)
+     * @param azimuthal_angle azimuthal angle of light ray (radians) 
+     * @return MuellerDiattenuator 
+     */
+    MuellerDiattenuator GetMuellerOperator(double wavelength, double incidence_angle, double azimuthal_angle);
 };
 
 
@@ -138,6 +316,17 @@ class Polariser: public Component
 
     Eigen::Matrix4d GetMuellerMatrix();
 
+    void ApplyMuellerRow(double wavelength, double incidence_angle, double azimuthal_angle, 
+                         Eigen::RowVector4d& row) override;
+
+    bool IsAngleDependent() override {
+        return false;
+    }
+
+    bool IsWavelengthDependent() override {
+        return false;
+    }
+
     bool IsIdealPolariser() override {
         return true;
     }
@@ -173,6 +362,9 @@ class Retarder: public Component
 
     Eigen::Matrix4d GetMuellerMatrix(double wavelength, double incidence_angle, double azimuthal_angle) override;
 
+    void ApplyMuellerRow(double wavelength, double incidence_angle, double azimuthal_angle, 
+                         Eigen::RowVector4d& row) override;
+
     bool IsIdealRetarder() override {
         return true;
     }
@@ -205,6 +397,14 @@ class QuarterWaveplate: public Retarder
         return M_PI / 2;
     }
 
+    bool IsAngleDependent() override {
+        return false;
+    }
+
+    bool IsWavelengthDependent() override {
+        return false;
+    }
+
     bool IsIdealQuarterWaveplate() override {
         return true;
     }
@@ -234,6 +434,14 @@ class HalfWaveplate: public Retarder
     double GetDelay(double wavelength, double incidence_angle, double azimuthal_angle) override {
         return M_PI;
     }
+
+    bool IsAngleDependent() override {
+        return false;
+    }
+
+    bool IsWavelengthDependent() override {
+        return false;
+    }
 };
 
 
@@ -245,9 +453,44 @@ class UniaxialCrystal: public Retarder
 {
     public:
 
+    /**
+     * @brief Wavelength-dependent terms of the delay, which do not depend on the ray direction
+     * 
+     */
+    struct DelayCoefficients
+    {
+        double factor;          // 2 pi thickness / wavelength
+        double no;
+        double no2;
+        double ne2;
+        double p;               // ne^2 sin^2(cut_angle) + no^2 cos^2(cut_angle)
+        double ne2p;            // ne^2 p
+        double no2_ne2;         // no^2 - ne^2
+        double ne2_no2_c_cut2;  // (ne^2 - no^2) cos^2(cut_angle)
+        double s_c_cut;         // sin(cut_angle) cos(cut_angle)
+    };
+
+    /**
+     * @brief Wavelength-dependent terms of the delay deviation from its on-axis value, in single precision
+     * 
+     */
+    struct DelayDeviationCoefficients
+    {
+        float factor;           // 2 pi thickness / wavelength
+        float no;
+        float no2;
+        float ne2;
+        float ne2p;             // ne^2 p
+        float sqrt_ne2p;        // sqrt(ne^2 p)
+        float ne2_no2_c_cut2;   // (ne^2 - no^2) cos^2(cut_angle)
+        float no2_ne2_s_c_cut_p;  // (no^2 - ne^2) sin(cut_angle) cos(cut_angle) / p
+        float no_p;             // no / p
+    };
+
     double thickness;
     double cut_angle;
     MaterialProperties material{};
+    DispersionModel dispersion;  // built from material on construction
 
     /**
     * @brief Constructor specifying material properties by material name
@@ -269,7 +512,8 @@ class UniaxialCrystal: public Retarder
     : Retarder(orientation, tilt_x, tilt_y), 
       thickness(thickness), 
       cut_angle(cut_angle),
-      material(GetMaterialProperties(material_name))
+      material(GetMaterialProperties(material_name)),
+      dispersion(MakeDispersionModel(material))
     {}
 
 
@@ -293,10 +537,142 @@ class UniaxialCrystal: public Retarder
     : Retarder(orientation, tilt_x, tilt_y), 
       thickness(thickness), 
       cut_angle(cut_angle),
-      material(material_properties)
+      material(material_properties),
+      dispersion(MakeDispersionModel(material))
     {}
     
     double GetDelay(double wavelength, double incidence_angle, double azimuthal_angle) override;
+
+    void GetDelayBatch(double wavelength, const double* incidence_angle, const double* azimuthal_angle, 
+                       double* delay, size_t n) override;
+
+    void GetDelayBatch(const double* wavelength, double incidence_angle, double azimuthal_angle, 
+                       double* delay, size_t n) override;
+
+    void GetDelayBatch(double wavelength, const RayBatch& rays, double* delay) override;
+
+    std::unique_ptr<DelayTable> GetDelayTable(const std::vector<double>& wavelength) override;
+
+    /**
+     * @brief Calculate the direction-independent delay terms at a given wavelength
+     * 
+     * @param wavelength wavelength of light (metres)
+     * @return DelayCoefficients 
+     */
+    DelayCoefficients GetDelayCoefficients(double wavelength);
+
+    /**
+     * @brief Calculate the direction-independent delay terms at a given wavelength, from the refractive indices there
+     * 
+     * @param wavelength wavelength of light (metres)
+     * @param ne extraordinary refractive index
+     * @param no ordinary refractive index
+     * @return DelayCoefficients 
+     */
+    DelayCoefficients GetDelayCoefficients(double wavelength, double ne, double no);
+
+    /**
+     * @brief Replace the Sellmeier dispersion model with a Chebyshev surrogate over a wavelength band (see 
+     * cispp::MakeChebyshevDispersion), for repeated evaluation within a narrow band, e.g. around a spectral line. 
+     * Delays at wavelengths outside the band then throw std::out_of_range, until the band is cleared.
+     * 
+     * @param wl_min band lower limit (metres)
+     * @param wl_max band upper limit (metres)
+     * @param tol target bound on the refractive index error
+     * @return const ChebyshevBand& the surrogate's band and error bounds
+     */
+    const ChebyshevBand& SetDispersionBand(double wl_min, double wl_max, double tol = 1e-12);
+
+    /**
+     * @brief Restore the Sellmeier dispersion model
+     */
+    void ClearDispersionBand();
+
+    /**
+     * @brief Group delay / phase delay of the birefringence (see cispp::GetKappa), from the current dispersion model
+     * 
+     * @param wavelength wavelength of light (metres)
+     * @return double 
+     */
+    double GetKappa(double wavelength) const;
+
+    /**
+     * @brief Retardance in radians, given the delay coefficients and the sines / cosines of the ray angles
+     * 
+     * All of the scalar and batch GetDelay methods evaluate the delay through this function, so they agree exactly.
+     * 
+     * @param coefs delay coefficients at the wavelength of the ray
+     * @param s_inc sine of the incidence angle
+     * @param s_azim sine of the azimuthal angle
+     * @param c_azim cosine of the azimuthal angle
+     * @return double 
+     */
+    static inline double GetDelay(const DelayCoefficients& coefs, double s_inc, double s_azim, double c_azim)
+    {
+        const double s_inc2 = s_inc * s_inc;
+        const double term_1 = sqrt(coefs.no2 - s_inc2);
+        const double term_2 = coefs.no2_ne2 * (coefs.s_c_cut * c_azim * s_inc) / coefs.p;
+        const double term_3 = - coefs.no * sqrt(coefs.ne2p - ((coefs.ne2 - coefs.ne2_no2_c_cut2 * (s_azim * s_azim)) * s_inc2)) / coefs.p;
+        return coefs.factor * (term_1 + term_2 + term_3);
+    }
+
+    /**
+     * @brief Retardance in radians for a batch of light rays, given the delay coefficients and the sines / cosines of 
+     * the ray angles. Branch-free and free of function calls, so that the compiler vectorises it.
+     * 
+     * @param coefs delay coefficients at the wavelength of the rays
+     * @param s_inc sines of the incidence angles, length n
+     * @param s_azim sines of the azimuthal angles, length n
+     * @param c_azim cosines of the azimuthal angles, length n
+     * @param delay output retardances (radians), length n
+     * @param n number of rays
+     */
+    static void GetDelayBatch(const DelayCoefficients& coefs, const double* __restrict s_inc, const double* __restrict s_azim, 
+                              const double* __restrict c_azim, double* __restrict delay, size_t n);
+
+    /**
+     * @brief Single-precision coefficients for the delay deviation, derived from the double-precision coefficients
+     * 
+     * @param coefs 
+     * @return DelayDeviationCoefficients 
+     */
+    static DelayDeviationCoefficients GetDelayDeviationCoefficients(const DelayCoefficients& coefs);
+
+    /**
+     * @brief Delay minus on-axis delay, in radians, in single precision
+     * 
+     * The square-root differences in the delay are rewritten as sqrt(a - b) - sqrt(a) = -b / (sqrt(a - b) + sqrt(a)), 
+     * so there is no cancellation and the result has float relative accuracy however thick the crystal.
+     * 
+     * @param coefs delay deviation coefficients at the wavelength of the ray
+     * @param s_inc sine of the incidence angle
+     * @param s_azim sine of the azimuthal angle
+     * @param c_azim cosine of the azimuthal angle
+     * @return float 
+     */
+    static inline float GetDelayDeviation(const DelayDeviationCoefficients& coefs, float s_inc, float s_azim, float c_azim)
+    {
+        const float s_inc2 = s_inc * s_inc;
+        const float b = (coefs.ne2 - coefs.ne2_no2_c_cut2 * (s_azim * s_azim)) * s_inc2;
+        const float term_1 = - s_inc2 / (std::sqrt(coefs.no2 - s_inc2) + coefs.no);
+        const float term_2 = coefs.no2_ne2_s_c_cut_p * c_azim * s_inc;
+        const float term_3 = coefs.no_p * b / (std::sqrt(coefs.ne2p - b) + coefs.sqrt_ne2p);
+        return coefs.factor * (term_1 + term_2 + term_3);
+    }
+
+    /**
+     * @brief Delay minus on-axis delay for a batch of light rays, in single precision. Vectorises, as GetDelayBatch.
+     * 
+     * @param coefs delay deviation coefficients at the wavelength of the rays
+     * @param s_inc sines of the incidence angles, length n
+     * @param s_azim sines of the azimuthal angles, length n
+     * @param c_azim cosines of the azimuthal angles, length n
+     * @param ddelay output retardance deviations (radians), length n
+     * @param n number of rays
+     */
+    static void GetDelayDeviationBatch(const DelayDeviationCoefficients& coefs, const float* __restrict s_inc, 
+                                       const float* __restrict s_azim, const float* __restrict c_azim, 
+                                       float* __restrict ddelay, size_t n);
 };
 
 
@@ -318,7 +694,7 @@ class SavartPlate: public Retarder
  * @return true 
  * @return false 
  */
-bool TestAlign90(std::unique_ptr<Component>& c1,  std::unique_ptr<Component>& c2);
+bool TestAlign90(const std::unique_ptr<Component>& c1, const std::unique_ptr<Component>& c2);
 
 
 /**
@@ -329,7 +705,7 @@ bool TestAlign90(std::unique_ptr<Component>& c1,  std::unique_ptr<Component>& c2
  * @return true 
  * @return false 
  */
-bool TestAlign45(std::unique_ptr<Component>& c1,  std::unique_ptr<Component>& c2);
+bool TestAlign45(const std::unique_ptr<Component>& c1, const std::unique_ptr<Component>& c2);
 
 
 } // namespace cispp
@@ -0,0 +1,262 @@
+#pragma once
+
+#include <complex>
+#include <memory>
+#include <string>
+#include <vector>
+#ifdef CISPP_HAVE_FFTW
+#include <fftw3.h>
+#endif
+
+#include "include/parallel.h"
+
+
+namespace cispp {
+
+
+/**
+ * @brief Demodulated images
+ *
+ */
+struct DemodResult
+{
+    std::vector<double> dc;        // mean intensity, counts
+    std::vector<double> phase;     // interferometer phase in radians, wrapped to [-pi, pi]
+    std::vector<double> contrast;  // fringe contrast
+};
+
+
+/**
+ * @brief Options for PixelatedDemodulator
+ *
+ */
+struct PixelatedDemodOptions
+{
+    size_t nthreads {0};      // number of threads, 0 = all hardware threads
+    bool upsample {false};    // interpolate back to full resolution, instead of one output pixel per super-pixel
+    size_t rows_per_task {16};  // super-pixel rows per parallel task
+};
+
+
+/**
+ * @brief Phase-stepping demodulation of interferograms from a pixelated polariser camera (single_delay_pixelated
+ * instruments)
+ *
+ * The camera's polariser mosaic adds phase steps of 0 and pi/2 (top row) and 3 pi/2 and pi (bottom row) within each 2x2
+ * super-pixel (see Camera::GetPixelatedPhaseMask), so that with I_m = A (1 + contrast cos(phase + m)),
+ *
+ *     C = I_0 - I_pi = 2 A contrast cos(phase),    S = I_3pi/2 - I_pi/2 = 2 A contrast sin(phase),
+ *
+ * phase = atan2(S, C), contrast = sqrt(C^2 + S^2) / (2 A) and dc = A is the mean of the four pixels. No transforms
+ * are needed. Super-pixel rows are processed as contiguous arrays, using a polynomial atan2 (error < 2e-8 rad) so the
+ * whole row loop vectorises. With upsample, C, S and the mean are bilinearly interpolated to the pixel centres before
+ * the phase and contrast are taken, so the phase is never interpolated across a wrap.
+ *
+ * Odd trailing columns / rows, which do not fill a super-pixel, are dropped (or take the nearest super-pixel's values
+ * when upsampling).
+ */
+class PixelatedDemodulator
+{
+    public:
+
+    /**
+     * @brief Construct a new PixelatedDemodulator for frames of the given size
+     *
+     * @param nx frame width in pixels
+     * @param ny frame height in pixels
+     * @param opts
+     */
+    PixelatedDemodulator(size_t nx, size_t ny, const PixelatedDemodOptions& opts = PixelatedDemodOptions());
+
+    /**
+     * @brief Output image width: nx with upsample, otherwise the number of super-pixels along x
+     */
+    size_t GetOutputWidth() const {
+        return opts.upsample ? nx : nsx;
+    }
+
+    /**
+     * @brief Output image height: ny with upsample, otherwise the number of super-pixels along y
+     */
+    size_t GetOutputHeight() const {
+        return opts.upsample ? ny : nsy;
+    }
+
+    /**
+     * @brief Demodulate a frame
+     *
+     * @param image pointer to frame (row-major order), nx * ny pixels
+     * @param result output images (row-major order), resized to GetOutputWidth() * GetOutputHeight() pixels
+     */
+    void Demodulate(const unsigned short int* image, DemodResult* result);
+
+    /**
+     * @brief Demodulate a stack of frames, in parallel over frames and blocks of super-pixel rows
+     *
+     * @param frames pointer to frames (frame-major, each frame row-major), nframes * nx * ny pixels
+     * @param nframes number of frames
+     * @param results output images, resized to nframes
+     */
+    void Demodulate(const unsigned short int* frames, size_t nframes, std::vector<DemodResult>* results);
+
+    private:
+
+    size_t nx;
+    size_t ny;
+    size_t nsx;  // super-pixels along x
+    size_t nsy;  // super-pixels along y
+    PixelatedDemodOptions opts;
+    std::unique_ptr<cispp::ThreadPool> pool;
+
+    // bilinear interpolation from super-pixel centres to pixel centres, per row
+    std::vector<size_t> interp_y0, interp_y1;
+    std::vector<double> interp_wy;
+
+    /**
+     * @brief C, S and the mean of super-pixel rows [jy0, jy1) of a frame
+     */
+    void GetQuadratures(const unsigned short int* frame, size_t jy0, size_t jy1, double* c, double* s, double* mean) const;
+
+    /**
+     * @brief Linear interpolation of a row of super-pixel values, nsx long, to the pixel centres of a row, nx long
+     */
+    void UpsampleRow(const double* v, double* row) const;
+};
+
+
+#ifdef CISPP_HAVE_FFTW
+
+
+/**
+ * @brief How much time FFTW spends choosing its plans. Better plans are faster per frame, and are only chosen once.
+ *
+ */
+enum class FFTWEffort
+{
+    Estimate,  // heuristic plan, no timing runs
+    Measure,   // times a few candidate plans
+    Patient,   // times many candidate plans (slow to plan, so best combined with a wisdom file)
+};
+
+
+/**
+ * @brief Options for LinearDemodulator
+ *
+ */
+struct DemodOptions
+{
+    int nthreads {1};                           // FFTW threads per transform
+    FFTWEffort effort {FFTWEffort::Measure};
+    std::string wisdom_file {};                 // if set, FFTW wisdom is imported from it before planning and exported
+                                                // to it afterwards, so later runs skip the planning
+    double window_radius {0.5};                 // radius of the sideband and DC filter windows, as a fraction of the
+                                                // carrier frequency
+};
+
+
+/**
+ * @brief Fourier demodulation of linear-carrier interferograms (single_delay_linear instruments)
+ *
+ * The interferogram I = I0 (1 + contrast cos(phase)) / 2 has its fringes on a linear spatial carrier, so its 2D
+ * spectrum is a DC peak plus two sidebands at +/- the carrier frequency. Each frame is transformed once (real-to-
+ * complex, so only half the spectrum is computed). The DC peak and the sideband at + the carrier are picked out with
+ * Hann windows and transformed back: the DC image by a complex-to-real transform, the sideband by a complex transform
+ * giving the analytic fringe signal, whose argument is the phase and whose modulus / DC is half the contrast.
+ *
+ * FFTW plans are made once, in the constructor, on buffers owned by the demodulator, and reused for every frame. The
+ * window taps are precomputed whenever the carrier is set. A demodulator is not safe to call from several threads at
+ * once, but separate demodulators are.
+ */
+class LinearDemodulator
+{
+    public:
+
+    /**
+     * @brief Plan the transforms for frames of the given size
+     *
+     * @param nx frame width in pixels
+     * @param ny frame height in pixels
+     * @param opts
+     */
+    LinearDemodulator(size_t nx, size_t ny, const DemodOptions& opts = DemodOptions());
+
+    ~LinearDemodulator();
+
+    LinearDemodulator(const LinearDemodulator&) = delete;
+    LinearDemodulator& operator=(const LinearDemodulator&) = delete;
+
+    /**
+     * @brief Set the carrier spatial frequency, in cycles/pixel along x and y. (fx, fy) and (-fx, -fy) describe the
+     * same fringes, but give phases of opposite sign.
+     *
+     * @param fx
+     * @param fy
+     */
+    void SetCarrier(double fx, double fy);
+
+    /**
+     * @brief Set the carrier to the strongest non-DC peak in the spectrum of a frame, with fx >= 0
+     *
+     * @param image pointer to frame (row-major order), nx * ny pixels
+     */
+    void EstimateCarrier(const unsigned short int* image);
+
+    double GetCarrierX() const {
+        return fx;
+    }
+
+    double GetCarrierY() const {
+        return fy;
+    }
+
+    /**
+     * @brief Demodulate a frame. The carrier is estimated from the first frame if it has not been set.
+     *
+     * @param image pointer to frame (row-major order), nx * ny pixels
+     * @param result output images (row-major order), resized to nx * ny pixels
+     */
+    void Demodulate(const unsigned short int* image, DemodResult* result);
+
+    private:
+
+    size_t nx;
+    size_t ny;
+    size_t nxh;  // nx / 2 + 1, width of the half spectrum
+    DemodOptions opts;
+    double fx {0};
+    double fy {0};
+    bool carrier_set {false};
+
+    // FFTW buffers and plans
+    double* real_in {nullptr};           // frame, ny x nx
+    fftw_complex* spec {nullptr};        // half spectrum of the frame, ny x nxh
+    fftw_complex* spec_dc {nullptr};     // windowed half spectrum around DC, ny x nxh
+    double* real_dc {nullptr};           // DC image, ny x nx
+    fftw_complex* spec_sb {nullptr};     // windowed full spectrum around the carrier, ny x nx
+    fftw_complex* analytic {nullptr};    // sideband image, ny x nx
+    fftw_plan plan_forward {nullptr};
+    fftw_plan plan_dc {nullptr};
+    fftw_plan plan_sb {nullptr};
+
+    /**
+     * @brief Window tap: weight applied to half-spectrum element ihalf, stored at element ifull of the target
+     * spectrum, conjugated if it comes from the mirrored half (Hermitian symmetry)
+     */
+    struct Tap
+    {
+        size_t ifull;
+        size_t ihalf;
+        bool conjugate;
+        double weight;
+    };
+    std::vector<Tap> taps_dc;
+    std::vector<Tap> taps_sb;
+
+    std::vector<Tap> GetTaps(double fx0, double fy0, double radius, bool half) const;
+};
+
+
+
+#endif  // CISPP_HAVE_FFTW
+
+} // namespace cispp
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <hdf5.h>
+
+
+namespace cispp {
+
+
+/**
+ * @brief Options for H5FrameWriter
+ * 
+ */
+struct H5WriterOptions
+{
+    int deflate_level {4};     // gzip level 1-9, 0 = no deflate
+    bool shuffle {true};       // byte shuffle before deflate, which helps with 16-bit pixels
+    size_t chunk_frames {16};  // chunk size along the frame axis
+    size_t chunk_rows {0};     // chunk size along y, 0 = auto
+    size_t chunk_cols {0};     // chunk size along x, 0 = auto
+    size_t queue_depth {8};    // frames that may wait for the writer thread before Write blocks, 0 = write synchronously
+};
+
+
+/**
+ * @brief Appends frames to an extendible, chunked 3D dataset (frame, y, x) of uint16 in an HDF5 file
+ * 
+ * Chunks span chunk_frames frames and a tile of pixels (by default up to 128 x 256, ~1 MiB per chunk), so reading a 
+ * whole frame or the time series of a single pixel both touch few chunks. Frames are staged until a full chunk of 
+ * frames has arrived, so each chunk is compressed and written once. Compression and I/O run on a writer thread: Write 
+ * copies the frame into a recycled buffer and returns, blocking only if queue_depth frames are already waiting.
+ * 
+ * Errors on the writer thread are rethrown by the next Write, Flush or Close. Calls into HDF5 from all writers share 
+ * one lock, so several writers can run at once without a thread-safe HDF5 build.
+ */
+class H5FrameWriter
+{
+    public:
+
+    /**
+     * @brief Create (or truncate) the file and create the dataset
+     * 
+     * @param fpath filepath (.h5)
+     * @param dataset_name 
+     * @param nx frame width in pixels
+     * @param ny frame height in pixels
+     * @param bit_depth stored as a dataset attribute
+     * @param opts 
+     */
+    H5FrameWriter(const std::string& fpath, const std::string& dataset_name, size_t nx, size_t ny, int bit_depth, 
+                  const H5WriterOptions& opts = H5WriterOptions());
+
+    ~H5FrameWriter();
+
+    H5FrameWriter(const H5FrameWriter&) = delete;
+    H5FrameWriter& operator=(const H5FrameWriter&) = delete;
+
+    /**
+     * @brief Set a string attribute on the dataset
+     */
+    void SetAttribute(const std::string& name, const std::string& value);
+
+    /**
+     * @brief Set a scalar attribute on the dataset
+     */
+    void SetAttribute(const std::string& name, double value);
+
+    /**
+     * @brief Set a 1D array attribute on the dataset, e.g. a spectrum
+     */
+    void SetAttribute(const std::string& name, const std::vector<double>& value);
+
+    /**
+     * @brief Store the contents of an instrument .YAML config file as the "instrument_config" attribute
+     * 
+     * @param fp_config 
+     */
+    void SetInstrumentConfig(const std::string& fp_config);
+
+    /**
+     * @brief Append a frame
+     * 
+     * @param frame pointer to frame (row-major order), nx * ny pixels
+     */
+    void Write(const unsigned short int* frame);
+
+    /**
+     * @brief Block until every frame passed to Write is in the file
+     */
+    void Flush();
+
+    /**
+     * @brief Flush, then close the file
+     */
+    void Close();
+
+    /**
+     * @brief Number of frames passed to Write so far
+     */
+    size_t GetFrameCount() const {
+        return nframes_in;
+    }
+
+    size_t GetChunkRows() const {
+        return chunk_rows;
+    }
+
+    size_t GetChunkCols() const {
+        return chunk_cols;
+    }
+
+    private:
+
+    std::string fpath;
+    size_t nx;
+    size_t ny;
+    H5WriterOptions opts;
+    size_t chunk_rows;
+    size_t chunk_cols;
+    hid_t file {-1};
+    hid_t dataset {-1};
+    size_t nframes_in {0};   // frames passed to Write
+    size_t nframes_out {0};  // frames in the file
+
+    // staging for one chunk of frames, only touched by whichever thread writes to the file
+    std::vector<unsigned short int> staging;
+    size_t nstaged {0};
+
+    // asynchronous writer
+    std::thread writer;
+    std::mutex mtx;
+    std::condition_variable cv_free;
+    std::condition_variable cv_full;
+    std::condition_variable cv_idle;
+    std::vector<std::vector<unsigned short int>> buffers;
+    std::deque<size_t> free_buffers;
+    std::deque<size_t> queue;
+    bool busy {false};
+    bool stop {false};
+    std::exception_ptr error {nullptr};
+
+    void WriterLoop();
+    void Stage(const unsigned short int* frame);
+    void WriteStaged();
+    void RethrowError();
+};
+
+
+} // namespace cispp
@@ -0,0 +1,257 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+namespace cispp {
+
+
+/**
+ * @brief How image data reaches the file
+ * 
+ */
+enum class WriteMethod
+{
+    Write,      // header and data in a single writev() call
+    MemoryMap,  // size the file, map it and copy into the mapping
+};
+
+
+/**
+ * @brief Header of a multi-frame container file (.cisf)
+ * 
+ * On disk, the header is 64 bytes: the fields below in order, little-endian, zero-padded. It is followed by nframes 
+ * frames of nx * ny little-endian uint16 pixels, each frame row-major.
+ */
+struct FrameStackHeader
+{
+    static constexpr char magic[8] = {'C', 'I', 'S', 'P', 'P', 'F', 'S', '\0'};
+    static constexpr uint32_t version = 1;
+    static constexpr size_t size = 64;
+
+    uint32_t bit_depth {0};
+    uint64_t nx {0};
+    uint64_t ny {0};
+    uint64_t nframes {0};
+};
+
+
+/**
+ * @brief Write image to binary 16-bit PGM (P5) file
+ * 
+ * Pixels are big-endian, as the Netpbm format requires, and maxval is 2^bit_depth - 1. bit_depth <= 8 gives 1 byte 
+ * per pixel.
+ * 
+ * @param fpath filepath (.pgm)
+ * @param image pointer to image (row-major order), nx * ny pixels
+ * @param nx image width in pixels
+ * @param ny image height in pixels
+ * @param bit_depth 
+ * @param method 
+ */
+void WritePGM(const std::string& fpath, const unsigned short int* image, size_t nx, size_t ny, int bit_depth, 
+              WriteMethod method = WriteMethod::Write);
+
+/**
+ * @brief Write image as raw little-endian uint16 pixels, with no header
+ * 
+ * @param fpath filepath
+ * @param image pointer to image (row-major order)
+ * @param npix number of pixels
+ * @param method 
+ */
+void WriteRaw(const std::string& fpath, const unsigned short int* image, size_t npix, 
+              WriteMethod method = WriteMethod::Write);
+
+/**
+ * @brief Write frames to a multi-frame container file (.cisf), see FrameStackHeader
+ * 
+ * @param fpath filepath (.cisf)
+ * @param frames pointer to frames (frame-major, each frame row-major), nframes * nx * ny pixels
+ * @param nx frame width in pixels
+ * @param ny frame height in pixels
+ * @param nframes number of frames
+ * @param bit_depth 
+ * @param method 
+ */
+void WriteFrameStack(const std::string& fpath, const unsigned short int* frames, size_t nx, size_t ny, size_t nframes, 
+                     int bit_depth, WriteMethod method = WriteMethod::Write);
+
+/**
+ * @brief Read a binary PGM (P5) file
+ * 
+ * @param fpath filepath (.pgm)
+ * @param nx output image width in pixels
+ * @param ny output image height in pixels
+ * @param maxval output maxval
+ * @return std::vector<unsigned short int> image (row-major order)
+ */
+std::vector<unsigned short int> ReadPGM(const std::string& fpath, size_t* nx, size_t* ny, int* maxval);
+
+/**
+ * @brief Read the header of a multi-frame container file (.cisf)
+ * 
+ * @param fpath filepath (.cisf)
+ * @return FrameStackHeader 
+ */
+FrameStackHeader ReadFrameStackHeader(const std::string& fpath);
+
+/**
+ * @brief Read every frame of a multi-frame container file (.cisf)
+ * 
+ * @param fpath filepath (.cisf)
+ * @param header output header
+ * @return std::vector<unsigned short int> frames (frame-major, each frame row-major)
+ */
+std::vector<unsigned short int> ReadFrameStack(const std::string& fpath, FrameStackHeader* header);
+
+
+/**
+ * @brief Appends frames to a multi-frame container file (.cisf) as they arrive, one write per call
+ * 
+ * The frame count in the header is updated on Close (or destruction).
+ */
+class FrameStackWriter
+{
+    public:
+
+    /**
+     * @brief Create (or truncate) the file and write its header
+     * 
+     * @param fpath filepath (.cisf)
+     * @param nx frame width in pixels
+     * @param ny frame height in pixels
+     * @param bit_depth 
+     */
+    FrameStackWriter(const std::string& fpath, size_t nx, size_t ny, int bit_depth);
+
+    ~FrameStackWriter();
+
+    FrameStackWriter(const FrameStackWriter&) = delete;
+    FrameStackWriter& operator=(const FrameStackWriter&) = delete;
+
+    /**
+     * @brief Append frames
+     * 
+     * @param frames pointer to frames (frame-major, each frame row-major), nframes * nx * ny pixels
+     * @param nframes number of frames
+     */
+    void Write(const unsigned short int* frames, size_t nframes = 1);
+
+    /**
+     * @brief Write the final frame count to the header and close the file
+     */
+    void Close();
+
+    size_t GetFrameCount() const {
+        return header.nframes;
+    }
+
+    private:
+
+    std::string fpath;
+    int fd {-1};
+    FrameStackHeader header;
+    std::vector<unsigned short int> swapped;  // byte-swapped copy, used on big-endian hosts only
+};
+
+
+
+/**
+ * @brief Multi-frame container file (.cisf) mapped into memory, so frames can be captured into and read from the file 
+ * directly, without staging copies
+ * 
+ * Pages are read in and written back by the kernel on demand, so the stack may be much larger than RAM. Create sizes 
+ * the file up front (sparse, where the filesystem allows) with the header already complete. Frames are returned as 
+ * pointers into the mapping, which stay valid until Close (or destruction). Zero-copy access relies on the 
+ * little-endian pixel layout of the file matching the host, so both Create and Open throw on big-endian hosts.
+ */
+class MappedFrameStack
+{
+    public:
+
+    MappedFrameStack() = default;
+
+    ~MappedFrameStack();
+
+    MappedFrameStack(MappedFrameStack&& other) noexcept;
+    MappedFrameStack& operator=(MappedFrameStack&& other) noexcept;
+
+    MappedFrameStack(const MappedFrameStack&) = delete;
+    MappedFrameStack& operator=(const MappedFrameStack&) = delete;
+
+    /**
+     * @brief Create (or truncate) a frame stack file of nframes zeroed frames and map it read-write
+     * 
+     * @param fpath filepath (.cisf)
+     * @param nx frame width in pixels
+     * @param ny frame height in pixels
+     * @param nframes number of frames
+     * @param bit_depth 
+     * @return MappedFrameStack 
+     */
+    static MappedFrameStack Create(const std::string& fpath, size_t nx, size_t ny, size_t nframes, int bit_depth);
+
+    /**
+     * @brief Map an existing frame stack file
+     * 
+     * @param fpath filepath (.cisf)
+     * @param writable map read-write instead of read-only
+     * @return MappedFrameStack 
+     */
+    static MappedFrameStack Open(const std::string& fpath, bool writable = false);
+
+    const FrameStackHeader& GetHeader() const {
+        return header;
+    }
+
+    size_t GetFrameCount() const {
+        return header.nframes;
+    }
+
+    bool IsWritable() const {
+        return writable;
+    }
+
+    /**
+     * @brief Pointer to a frame (row-major order) in the mapping, for reading
+     * 
+     * @param iframe frame index
+     * @return const unsigned short int* 
+     */
+    const unsigned short int* GetFrame(size_t iframe) const;
+
+    /**
+     * @brief Pointer to a frame (row-major order) in the mapping, for writing. Throws if the stack is read-only.
+     * 
+     * @param iframe frame index
+     * @return unsigned short int* 
+     */
+    unsigned short int* GetWritableFrame(size_t iframe);
+
+    /**
+     * @brief Write dirty pages back to the file
+     * 
+     * @param wait block until written (MS_SYNC), or only schedule the writeback (MS_ASYNC)
+     */
+    void Flush(bool wait = true);
+
+    /**
+     * @brief Unmap and close the file. Changes reach the file even without Flush, once the kernel writes them back.
+     */
+    void Close();
+
+    private:
+
+    std::string fpath;
+    FrameStackHeader header;
+    bool writable {false};
+    char* map {nullptr};
+    size_t map_size {0};
+
+    static MappedFrameStack Map(const std::string& fpath, int fd, size_t map_size, bool writable);
+};
+
+} // namespace cispp
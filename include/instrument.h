@@ -1,5 +1,8 @@
 #pragma once
 
+#include <cassert>
+#include <filesystem>
+#include <functional>
 #include <memory>
 #include <vector>
 #include <string>
@@ -13,6 +16,10 @@
 
 #include "include/camera.h"
 #include "include/component.h"
+#include "include/imageio.h"
+#include "include/parallel.h"
+#include "include/quadrature.h"
+#include "include/transfer.h"
 
 using std::vector;
 using std::unique_ptr;
@@ -22,6 +29,169 @@ using std::string;
 namespace cispp {
 
 
+/**
+ * @brief Options controlling how a Capture call is executed. Output does not depend on these options, except for 
+ * single_precision and sensor.
+ * 
+ * In single precision, the per-pixel arithmetic is done in float. Retarder delays are split into an on-axis part, 
+ * reduced modulo 2 pi in double precision, and a float deviation from it (see DelayTable::GetDelayDeviationBatch), so 
+ * the fringe phase stays accurate for thick crystals. Mueller model captures in single precision always use the 
+ * compiled model (see Instrument::Compile). Use Instrument::ComparePrecision to check the accuracy for a given 
+ * instrument.
+ * 
+ * The sensor model (photon shot noise, read noise, gain and clipping to the camera bit depth, see Camera::Digitise) is 
+ * off by default, leaving pixels as photon counts. In CaptureBatch, frame i of the batch uses sensor.frame + i as its 
+ * frame index, so a batch matches the same frames captured one at a time.
+ */
+struct CaptureOptions
+{
+    size_t nthreads {0};    // number of threads, 0 = all hardware threads
+    size_t tile_rows {16};  // tile height in pixels, 0 = full sensor height
+    size_t tile_cols {0};   // tile width in pixels, 0 = full sensor width
+    bool single_precision {false};  // evaluate pixels in float instead of double
+    cispp::SensorOptions sensor;    // sensor model stage
+};
+
+
+/**
+ * @brief Accuracy of single-precision capture with respect to double-precision capture (Instrument::ComparePrecision)
+ * 
+ */
+struct PrecisionReport
+{
+    int max_count_error;     // max absolute difference between the single- and double-precision images (counts)
+    double max_phase_error;  // max single-precision fringe phase error over all pixels and pixel-dependent retarders, 
+                             // at the shortest, central and longest wavelengths (radians)
+    double duration_double;  // double-precision capture time (seconds)
+    double duration_single;  // single-precision capture time (seconds)
+};
+
+
+/**
+ * @brief Per-pixel ray geometry through one interferometer component. Row-major, one array per quantity.
+ * 
+ */
+struct ComponentGeometry
+{
+    // parameters the geometry was calculated for
+    int sensor_format_x {0};
+    int sensor_format_y {0};
+    double pixel_size {0};
+    double lens_3_focal_length {0};
+    double orientation {0};
+    double tilt_x {0};
+    double tilt_y {0};
+
+    vector<double> incidence_angle;
+    vector<double> azimuthal_angle;
+    vector<double> sin_inc;
+    vector<double> sin_azim;
+    vector<double> cos_azim;
+};
+
+
+/**
+ * @brief Scratch space for one row of ray geometry
+ * 
+ */
+struct RayScratch
+{
+    vector<double> incidence_angle;
+    vector<double> azimuthal_angle;
+    vector<double> sin_inc;
+    vector<double> sin_azim;
+    vector<double> cos_azim;
+
+    RayScratch(size_t n)
+    : incidence_angle(n),
+      azimuthal_angle(n),
+      sin_inc(n),
+      sin_azim(n),
+      cos_azim(n)
+    {}
+};
+
+
+/**
+ * @brief Scratch space for one row of ray geometry, in single precision
+ * 
+ */
+struct RayScratchF
+{
+    vector<float> incidence_angle;
+    vector<float> azimuthal_angle;
+    vector<float> sin_inc;
+    vector<float> sin_azim;
+    vector<float> cos_azim;
+
+    RayScratchF(size_t n)
+    : incidence_angle(n),
+      azimuthal_angle(n),
+      sin_inc(n),
+      sin_azim(n),
+      cos_azim(n)
+    {}
+};
+
+
+/**
+ * @brief Instrument Mueller model, reduced to the factors that must be evaluated at every pixel (see Instrument::Compile)
+ * 
+ * Components are split into runs of pixel-independent components (which are multiplied out once per wavelength, or 
+ * once only if they are also wavelength-independent) separated by pixel-dependent stages.
+ */
+struct CompiledMueller
+{
+    /**
+     * @brief Pixel-dependent component
+     */
+    struct PixelStage
+    {
+        size_t icomp;                // component index
+        bool is_retarder;            // ideal retarder: the orientation rotations are folded into the neighbouring runs
+        Eigen::Matrix4d rot;         // rotation matrix for component orientation
+    };
+
+    vector<PixelStage> stages;
+    vector<vector<size_t>> runs;     // component indices of the runs either side of the stages, stages.size() + 1 runs
+    vector<bool> run_is_constant;    // whether each run is also wavelength-independent
+    vector<Eigen::Matrix4d> run_constant;  // product of each constant run
+
+    // instrument state at compile time
+    vector<double> orientation;
+    string camera_type;
+};
+
+
+/**
+ * @brief Everything needed to construct an instrument: lenses, camera and components. Parsed once from a .yaml config 
+ * file (Instrument::ParseConfig) or read from a snapshot, then classified (ClassifyInstrument) and moved into the 
+ * instrument of that type.
+ */
+struct InstrumentConfig
+{
+    string fp_config;
+    double lens_1_focal_length {0};
+    double lens_2_focal_length {0};
+    double lens_3_focal_length {0};
+    cispp::Camera camera;
+    vector<unique_ptr<cispp::Component>> components;
+};
+
+
+class Instrument;
+
+
+/**
+ * @brief Load an instrument snapshot, written by Instrument::SaveSnapshot, with a single read and no YAML parsing or 
+ * material lookups
+ * 
+ * @param fpath snapshot filepath
+ * @return unique_ptr<cispp::Instrument>, of the type the snapshot was saved from
+ */
+unique_ptr<cispp::Instrument> LoadInstrumentSnapshot(const string& fpath);
+
+
 class Instrument
 {
     public:
@@ -41,14 +211,44 @@ class Instrument
      */
     Instrument(std::filesystem::path fp_config);
 
+    /**
+     * @brief Construct Instrument from a parsed configuration
+     * 
+     * @param config 
+     */
+    Instrument(InstrumentConfig config);
+
     virtual ~Instrument() = default;
 
+    /**
+     * @brief Parse a .YAML config file, reading it once
+     * 
+     * @param fp_config 
+     * @return InstrumentConfig 
+     */
+    static InstrumentConfig ParseConfig(std::filesystem::path fp_config);
+
     static cispp::Camera ParseNodeCamera(YAML::Node nd_camera);
 
     static void ParseNodeComponents(YAML::Node nd_components, vector<unique_ptr<cispp::Component>>& components);
 
     void write_config();
 
+    /**
+     * @brief Save the fully resolved instrument (type, lenses, camera, components and their Sellmeier coefficients) to 
+     * a binary snapshot, which LoadInstrumentSnapshot reads back with a single read
+     * 
+     * The file is the 8-byte magic "CISPPIS\0", a uint32 version, then the fields in order, little-endian: integers 
+     * as uint32 / uint64, reals as IEEE doubles, strings and arrays as a uint64 length then the elements. With 
+     * include_geometry, the geometry cache (see EnableGeometryCache) is brought up to date and saved too, so the 
+     * loaded instrument skips building it. Component dispersion bands (UniaxialCrystal::SetDispersionBand) are not 
+     * saved.
+     * 
+     * @param fpath snapshot filepath
+     * @param include_geometry 
+     */
+    void SaveSnapshot(const string& fpath, bool include_geometry = false);
+
     /**
      * @brief Incidence angle in radians of ray through interferometer component
      * 
@@ -69,6 +269,56 @@ class Instrument
      */
     double GetAzimuthalAngle(double x, double y, unique_ptr<cispp::Component>& component);
 
+    /**
+     * @brief Incidence and azimuthal angles in radians of rays through interferometer component, for a row segment 
+     * of pixels. Agrees exactly with GetIncidenceAngle and GetAzimuthalAngle.
+     * 
+     * @param iy y-index of pixel row
+     * @param ix0 x-index of first pixel
+     * @param ix1 x-index one past the last pixel
+     * @param component unique pointer to component
+     * @param incidence_angle output incidence angles, length ix1 - ix0
+     * @param azimuthal_angle output azimuthal angles, length ix1 - ix0
+     */
+    void GetRayAnglesRow(size_t iy, size_t ix0, size_t ix1, unique_ptr<cispp::Component>& component, 
+                         double* incidence_angle, double* azimuthal_angle);
+
+    /**
+     * @brief Turn the per-pixel geometry cache on or off
+     * 
+     * When on, the incidence / azimuthal angles (and their sines / cosines) of every angle-dependent component are 
+     * stored for every pixel, so repeated captures skip the trigonometry. The cache is built by the next Capture and is 
+     * rebuilt only when the camera, lens_3_focal_length or a component's orientation / tilt changes. It costs 40 bytes 
+     * per pixel per angle-dependent component. Capture output does not depend on whether the cache is used.
+     * 
+     * @param enable 
+     */
+    void EnableGeometryCache(bool enable = true);
+
+    /**
+     * @brief Total Mueller matrix for instrument, by pixel index. Uses the geometry cache, if it is up to date.
+     * 
+     * @param ix x-index of pixel
+     * @param iy y-index of pixel
+     * @param wavelength wavelength of ray
+     * @return Eigen::Matrix4d 
+     */
+    Eigen::Matrix4d GetPixelMuellerMatrix(size_t ix, size_t iy, double wavelength);
+
+    /**
+     * @brief Compile the Mueller model, so that Mueller captures evaluate only the factors that vary in the hot loop
+     * 
+     * Components are classified as constant, wavelength-dependent or pixel-dependent. Runs of components that do not 
+     * depend on the pixel are pre-multiplied once per Capture (and once only, if they are also wavelength-independent).
+     * For pixel-dependent ideal retarders, the rotations into and out of the component frame are folded into these 
+     * runs, leaving a 2x2 rotation by the delay per pixel. Only the S0 row of the total matrix is propagated. Results 
+     * agree with the uncompiled model to rounding error. The model is recompiled automatically if the component list, 
+     * an orientation or the camera type changes.
+     * 
+     * @param enable false returns to the reference, uncompiled calculation
+     */
+    void Compile(bool enable = true);
+
     /**
      * @brief Total Mueller matrix for instrument
      * 
@@ -80,9 +330,10 @@ class Instrument
     Eigen::Matrix4d GetMuellerMatrix(double x, double y, double wavelength);
 
     /**
-     * @brief save Captured image to .PGM (portable GrayMap) file
+     * @brief save Captured image to binary 16-bit .PGM (portable GrayMap) file, with maxval set by the camera bit depth. 
+     * See imageio.h for raw and multi-frame output.
      * 
-     * @param fpath filepath (.PPM)
+     * @param fpath filepath (.PGM)
      * @param image pointer to image vector (row-major order)
      */
     void SaveImage(string fpath, vector<unsigned short int>* image);
@@ -95,53 +346,570 @@ class Instrument
      * @param wavelength wavelength of light in metres
      * @param flux photon flux
      * @param image pointer to image vector (row-major order)
+     * @param opts threading and tiling options
      */
-    virtual void Capture(double wavelength, double flux, vector<unsigned short int>* image);
+    void Capture(double wavelength, double flux, vector<unsigned short int>* image, 
+                 const CaptureOptions& opts = CaptureOptions());
 
     /**
-     * @brief Capture interferogram for a uniform scene of monochromatic, unpolarised light (Mueller model)
+     * @brief Capture interferogram for a uniform scene of monochromatic, unpolarised light (Mueller model) into a 
+     * caller-owned buffer, e.g. a frame of a MappedFrameStack
+     * 
+     * @param wavelength wavelength of light in metres
+     * @param flux photon flux
+     * @param image pointer to sensor_format_x * sensor_format_y pixels (row-major order)
+     * @param opts threading and tiling options
+     */
+    virtual void Capture(double wavelength, double flux, unsigned short int* image, 
+                         const CaptureOptions& opts = CaptureOptions());
+
+    /**
+     * @brief Capture interferogram for a uniform scene of unpolarised light with the given spectrum (Mueller model)
+     * 
+     * @param wavelength wavelength of light in metres
+     * @param spec_flux photon spectral flux in photons/metre
+     * @param image pointer to image vector (row-major order)
+     * @param opts threading and tiling options
+     */
+    void Capture(vector<double>& wavelength, vector<double>& spec_flux, vector<unsigned short int>* image, 
+                 const CaptureOptions& opts = CaptureOptions());
+
+    /**
+     * @brief Capture interferogram for a uniform scene of unpolarised light with the given spectrum (Mueller model) 
+     * into a caller-owned buffer, e.g. a frame of a MappedFrameStack
+     * 
+     * @param wavelength wavelength of light in metres
+     * @param spec_flux photon spectral flux in photons/metre
+     * @param image pointer to sensor_format_x * sensor_format_y pixels (row-major order)
+     * @param opts threading and tiling options
+     */
+    virtual void Capture(vector<double>& wavelength, vector<double>& spec_flux, unsigned short int* image, 
+                         const CaptureOptions& opts = CaptureOptions());
+
+    /**
+     * @brief Capture a sequence of frames of a uniform scene of unpolarised light, where only the spectrum changes from 
+     * frame to frame
+     * 
+     * The transmission of the instrument at every pixel and wavelength does not depend on the spectrum, so it is 
+     * evaluated once per pixel row and applied to all frames at once as a matrix product (frames x wavelengths) x 
+     * (wavelengths x pixels). Work is split across tiles and, when there are too few tiles to occupy every thread, 
+     * across blocks of frames. Frames agree with Capture to within rounding (1 count). single_precision is ignored.
+     * 
+     * @param wavelength wavelength of light in metres, shared by all frames
+     * @param spec_flux photon spectral flux in photons/metre, one vector per frame
+     * @param frames pointer to frame stack vector (frame-major, each frame row-major), spec_flux.size() frames long
+     * @param opts threading and tiling options
+     */
+    void CaptureBatch(const vector<double>& wavelength, const vector<vector<double>>& spec_flux, 
+                      vector<unsigned short int>* frames, const CaptureOptions& opts = CaptureOptions());
+
+    /**
+     * @brief Capture a sequence of frames, each with its own wavelength grid. Frames that share a wavelength grid are 
+     * captured together, as in CaptureBatch with a single grid.
+     * 
+     * @param wavelength wavelength of light in metres, one vector per frame
+     * @param spec_flux photon spectral flux in photons/metre, one vector per frame
+     * @param frames pointer to frame stack vector (frame-major, each frame row-major), spec_flux.size() frames long
+     * @param opts threading and tiling options
+     */
+    void CaptureBatch(const vector<vector<double>>& wavelength, const vector<vector<double>>& spec_flux, 
+                      vector<unsigned short int>* frames, const CaptureOptions& opts = CaptureOptions());
+
+    /**
+     * @brief CaptureBatch into a caller-owned buffer, e.g. the frames of a MappedFrameStack
+     * 
+     * @param wavelength wavelength of light in metres, shared by all frames
+     * @param spec_flux photon spectral flux in photons/metre, one vector per frame
+     * @param frames pointer to spec_flux.size() frames (frame-major, each frame row-major)
+     * @param opts threading and tiling options
+     */
+    void CaptureBatch(const vector<double>& wavelength, const vector<vector<double>>& spec_flux, 
+                      unsigned short int* frames, const CaptureOptions& opts = CaptureOptions());
+
+    /**
+     * @brief CaptureBatch with a wavelength grid per frame, into a caller-owned buffer
+     * 
+     * @param wavelength wavelength of light in metres, one vector per frame
+     * @param spec_flux photon spectral flux in photons/metre, one vector per frame
+     * @param frames pointer to spec_flux.size() frames (frame-major, each frame row-major)
+     * @param opts threading and tiling options
+     */
+    void CaptureBatch(const vector<vector<double>>& wavelength, const vector<vector<double>>& spec_flux, 
+                      unsigned short int* frames, const CaptureOptions& opts = CaptureOptions());
+
+    /**
+     * @brief Capture interferogram for a uniform scene of unpolarised light, integrating over wavelength with a 
+     * precomputed quadrature grid (see quadrature.h) instead of the trapezoidal rule
+     * 
+     * Each pixel is the dot product of the grid weights with the instrument's transmission at the grid nodes, 
+     * evaluated a pixel row at a time as in CaptureBatch. High-order rules (Gauss-Hermite for lines, Clenshaw-Curtis 
+     * or Simpson for sampled spectra) reach the accuracy of a fine trapezoidal grid with far fewer wavelengths. 
+     * single_precision is ignored.
+     * 
+     * @param grid wavelength nodes and weights, weights in photons
+     * @param image pointer to image vector (row-major order)
+     * @param opts threading and tiling options
+     */
+    void CaptureQuadrature(const cispp::QuadratureGrid& grid, vector<unsigned short int>* image, 
+                           const CaptureOptions& opts = CaptureOptions());
+
+    /**
+     * @brief CaptureQuadrature into a caller-owned buffer
+     * 
+     * @param grid wavelength nodes and weights, weights in photons
+     * @param image pointer to nx * ny pixels (row-major order)
+     * @param opts threading and tiling options
+     */
+    void CaptureQuadrature(const cispp::QuadratureGrid& grid, unsigned short int* image, 
+                           const CaptureOptions& opts = CaptureOptions());
+
+    /**
+     * @brief Create a memory-mapped frame stack file sized for this instrument's camera, to Capture into
+     * 
+     * @param fpath filepath (.cisf)
+     * @param nframes number of frames
+     * @return cispp::MappedFrameStack 
+     */
+    cispp::MappedFrameStack CreateFrameStack(const string& fpath, size_t nframes);
+
+    /**
+     * @brief Compare single- and double-precision capture of monochromatic light
      * 
      * @param wavelength wavelength of light in metres
      * @param flux photon flux
+     * @param opts threading and tiling options. single_precision is ignored.
+     * @return PrecisionReport 
+     */
+    PrecisionReport ComparePrecision(double wavelength, double flux, const CaptureOptions& opts = CaptureOptions());
+
+    /**
+     * @brief Compare single- and double-precision capture of light with the given spectrum
+     * 
+     * @param wavelength wavelength of light in metres
+     * @param spec_flux photon spectral flux in photons/metre
+     * @param opts threading and tiling options. single_precision is ignored.
+     * @return PrecisionReport 
+     */
+    PrecisionReport ComparePrecision(vector<double>& wavelength, vector<double>& spec_flux, 
+                                     const CaptureOptions& opts = CaptureOptions());
+
+    protected:
+
+    /**
+     * @brief Call fn(tile, iworker) for every tile of the sensor, in parallel
+     * 
+     * @param opts threading and tiling options
+     * @param fn iworker is in [0, GetWorkerCount(opts)) and can be used to index per-worker scratch buffers
+     */
+    void ForEachTile(const CaptureOptions& opts, const std::function<void(const cispp::Tile&, size_t)>& fn);
+
+    /**
+     * @brief Thread pool sized for the given options, for parallel loops that are not over tiles
+     * 
+     * @param opts 
+     * @return cispp::ThreadPool& 
+     */
+    cispp::ThreadPool& GetPool(const CaptureOptions& opts);
+
+    /**
+     * @brief Number of workers that ForEachTile will use for the given options
+     * 
+     * @param opts 
+     * @return size_t 
+     */
+    size_t GetWorkerCount(const CaptureOptions& opts);
+
+    /**
+     * @brief (Re)build any out-of-date entries in the geometry cache, if it is enabled. Called at the start of Capture.
+     * 
+     * @param opts threading and tiling options
+     */
+    void UpdateGeometryCache(const CaptureOptions& opts);
+
+    /**
+     * @brief Cached geometry for a component, or nullptr if it is not cached or the cache is out of date
+     * 
+     * @param icomp component index
+     * @return const ComponentGeometry* 
+     */
+    const ComponentGeometry* GetCachedGeometry(size_t icomp);
+
+    /**
+     * @brief Ray geometry for a row segment of pixels through a component. Points into the geometry cache if possible, 
+     * otherwise it is calculated into scratch.
+     * 
+     * @param icomp component index
+     * @param iy y-index of pixel row
+     * @param ix0 x-index of first pixel
+     * @param ix1 x-index one past the last pixel
+     * @param scratch at least ix1 - ix0 long
+     * @return RayBatch 
+     */
+    cispp::RayBatch GetRayBatchRow(size_t icomp, size_t iy, size_t ix0, size_t ix1, RayScratch& scratch);
+
+    /**
+     * @brief Fills t[iwl * n + i], the fraction of unpolarised source flux reaching pixel (ix0 + i, iy) at wavelength 
+     * iwl, for a row segment of n = ix1 - ix0 pixels. Called as fn(iy, ix0, ix1, iworker, t).
+     */
+    using TransmissionRowFn = std::function<void(size_t, size_t, size_t, size_t, double*)>;
+
+    /**
+     * @brief Set up the per-wavelength state for evaluating the instrument transmission a pixel row at a time
+     * 
+     * @param wavelength wavelength of light in metres
+     * @param opts threading and tiling options
+     * @return TransmissionRowFn safe to call concurrently from different workers
+     */
+    virtual TransmissionRowFn GetTransmissionRowFn(const vector<double>& wavelength, const CaptureOptions& opts);
+
+    /**
+     * @brief Single-precision copy of a ray batch
+     * 
+     * @param rays 
+     * @param scratch at least rays.n long
+     * @return RayBatchF 
+     */
+    static cispp::RayBatchF GetRayBatchF(const cispp::RayBatch& rays, RayScratchF& scratch);
+
+    /**
+     * @brief Mueller model capture using the compiled model
+     * 
+     * @tparam Real double, or float for single precision
+     * @param wavelength wavelength of light in metres
+     * @param spec_flux photon spectral flux in photons/metre, or photon flux if integrate is false
+     * @param integrate whether to integrate over wavelength, or to capture at wavelength[0] only
+     * @param image pointer to image (row-major order)
+     * @param opts threading and tiling options
+     */
+    template <typename Real>
+    void CaptureCompiled(const vector<double>& wavelength, const vector<double>& spec_flux, bool integrate, 
+                         unsigned short int* image, const CaptureOptions& opts);
+
+    private:
+
+    friend unique_ptr<cispp::Instrument> LoadInstrumentSnapshot(const string& fpath);
+
+    unique_ptr<cispp::ThreadPool> pool;
+    unique_ptr<CompiledMueller> compiled;
+    bool use_geometry_cache {false};
+    vector<ComponentGeometry> geometry_cache;  // indexed by component
+
+    bool IsGeometryCurrent(const ComponentGeometry& geom, size_t icomp);
+
+    unique_ptr<CompiledMueller> BuildCompiledMueller();
+
+    void CaptureBatch(const vector<double>& wavelength, const vector<const vector<double>*>& spec_flux, 
+                      const vector<size_t>& iframes, unsigned short int* frames, const CaptureOptions& opts);
+
+    using WeightMatrix = Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+
+    /**
+     * @brief Capture frames whose pixels are weights (frames x wavelengths) times the transmission (wavelengths x 
+     * pixels), into frames iframes of the stack
+     */
+    void CaptureWeighted(const vector<double>& wavelength, const WeightMatrix& weights, const vector<size_t>& iframes, 
+                         unsigned short int* frames, const CaptureOptions& opts);
+
+    PrecisionReport ComparePrecision(const std::function<void(vector<unsigned short int>*, const CaptureOptions&)>& capture, 
+                                     const vector<double>& wavelength, const CaptureOptions& opts);
+};
+
+
+/**
+ * @brief Accuracy of a coherence-based capture (InstrumentSingleDelay::CaptureCoherence)
+ * 
+ */
+struct CoherenceCaptureReport
+{
+    double wavelength_ref;  // flux-weighted mean wavelength, about which the delay is expanded (metres)
+    double kappa;           // group delay / phase delay at wavelength_ref
+    double delay_ref;       // reference delay at wavelength_ref, about which the coherence is expanded (radians)
+    double error_bound;     // bound on the error from truncating the coherence expansion (counts)
+    double error_max;       // max absolute error with respect to the full spectral integral, over sampled pixels (counts)
+    double error_rms;       // RMS error with respect to the full spectral integral, over sampled pixels (counts)
+    size_t nsamples;        // number of sampled pixels
+};
+
+
+/**
+ * @brief Instrument whose interferogram depends on a single delay (abstract base class)
+ * 
+ * The interferometer is a polariser, then retarders at +/- 45 degrees to it, then either a polariser or a quarter 
+ * waveplate in front of a pixelated polariser camera. Capture uses the closed-form two-beam interferogram instead of 
+ * the full Mueller matrix calculation, evaluated a pixel row at a time.
+ */
+class InstrumentSingleDelay: public Instrument
+{
+    public:
+
+    InstrumentSingleDelay(std::filesystem::path fp_config, bool pixelated)
+    : Instrument(fp_config),
+      pixelated(pixelated)
+    {}
+
+    InstrumentSingleDelay(InstrumentConfig config, bool pixelated)
+    : Instrument(std::move(config)),
+      pixelated(pixelated)
+    {}
+
+    using Instrument::Capture;
+
+    void Capture(double wavelength, double flux, unsigned short int* image, 
+                 const CaptureOptions& opts = CaptureOptions()) override;
+
+    void Capture(vector<double>& wavelength, vector<double>& spec_flux, unsigned short int* image, 
+                 const CaptureOptions& opts = CaptureOptions()) override;
+
+    /**
+     * @brief Interferometer delay at every pixel, at a single wavelength
+     * 
+     * @param wavelength wavelength of light in metres
+     * @param delay pointer to delay vector in radians (row-major order)
+     * @param opts threading and tiling options
+     */
+    void GetDelayMap(double wavelength, vector<double>* delay, const CaptureOptions& opts = CaptureOptions());
+
+    /**
+     * @brief Capture interferogram for a uniform scene of unpolarised light with the given spectrum, using the 
+     * spectrum's temporal coherence instead of integrating over wavelength at every pixel
+     * 
+     * The delay at each pixel is expanded to first order in optical frequency about the flux-weighted mean wavelength 
+     * wl0, delay(wl) = delay0 * (1 + kappa * (wl0 - wl) / wl), where kappa is the group delay / phase delay (as in 
+     * cispp::GetKappa). The coherence envelope is then expanded to first order about a reference delay at the centre 
+     * of the sensor's delay range, so the spectrum is integrated only twice: the cost is O(pixels + nbins) instead of 
+     * O(pixels x nbins). The accuracy is estimated against the full spectral integral at a grid of sampled pixels. A 
+     * spectrum with zero total flux gives a dark frame and a zeroed report.
+     * 
+     * @param wavelength wavelength of light in metres
+     * @param spec_flux photon spectral flux in photons/metre
+     * @param image pointer to image vector (row-major order)
+     * @param opts threading and tiling options
+     * @param nsamples_x number of pixels sampled along each sensor axis for the error estimate, 0 = no sampling
+     * @return CoherenceCaptureReport 
+     */
+    CoherenceCaptureReport CaptureCoherence(vector<double>& wavelength, vector<double>& spec_flux, 
+                                            vector<unsigned short int>* image, 
+                                            const CaptureOptions& opts = CaptureOptions(), size_t nsamples_x = 16);
+
+    /**
+     * @brief Capture interferogram for a uniform scene of unpolarised light with the given spectrum, by looking up the 
+     * spectrum's temporal coherence in a table
+     * 
+     * Two stages: the delay at wl0 is computed at every pixel from the geometry only (GetDelayMap), then each pixel's 
+     * intensity is found by linear interpolation in a table of the coherence envelope, sampled finely enough over the 
+     * delay range spanned by the sensor that the interpolation error is at most max_error. The delay model is the 
+     * same as CaptureCoherence's, but without the expansion about a reference delay, so wide delay ranges stay 
+     * accurate. Building the table costs O(ntable x nbins), then each pixel costs about as much as a monochromatic 
+     * capture. A spectrum with zero total flux gives a dark frame and a zeroed report.
+     * 
+     * @param wavelength wavelength of light in metres
+     * @param spec_flux photon spectral flux in photons/metre
      * @param image pointer to image vector (row-major order)
+     * @param max_error bound on the interpolation error (counts)
+     * @param opts threading and tiling options
+     * @param nsamples_x number of pixels sampled along each sensor axis for the error estimate, 0 = no sampling
+     * @return CoherenceCaptureReport, with error_bound the interpolation error bound
+     */
+    CoherenceCaptureReport CaptureCoherenceTable(vector<double>& wavelength, vector<double>& spec_flux, 
+                                                 vector<unsigned short int>* image, double max_error = 0.01, 
+                                                 const CaptureOptions& opts = CaptureOptions(), 
+                                                 size_t nsamples_x = 16);
+
+    protected:
+
+    bool pixelated;  // whether the pixelated polariser camera adds a phase mask to the delay
+
+    /**
+     * @brief Flux-weighted mean wavelength and group delay / phase delay ratio of a spectrum, for the coherence-based 
+     * captures. Sets report->wavelength_ref and report->kappa, or zeroes them if the total flux is zero.
+     * 
+     * @return total photon flux
+     */
+    double GetCoherenceReference(const vector<double>& wavelength, const vector<double>& spec_flux, 
+                                 CoherenceCaptureReport* report);
+
+    /**
+     * @brief Capture with no light: the sensor model applied to zero photons at every pixel
      */
-    virtual void Capture(vector<double>& wavelength, vector<double>& spec_flux, vector<unsigned short int>* image);
+    void CaptureDark(unsigned short int* image, const CaptureOptions& opts);
+
+    /**
+     * @brief Error of a coherence-based capture with respect to the full spectral integral, on a grid of sampled 
+     * pixels. Sets report->error_max, report->error_rms and report->nsamples.
+     * 
+     * @param delay delay at report->wavelength_ref at every pixel
+     * @param get_intensity pixel intensity (counts) from its delay and phase mask
+     */
+    void SampleCoherenceError(vector<double>& wavelength, vector<double>& spec_flux, const vector<double>& delay, 
+                              const std::function<double(double, double)>& get_intensity, size_t nsamples_x, 
+                              CoherenceCaptureReport* report);
+
+    TransmissionRowFn GetTransmissionRowFn(const vector<double>& wavelength, const CaptureOptions& opts) override;
+
+    /**
+     * @brief Single-precision capture
+     * 
+     * @param wavelength wavelength of light in metres
+     * @param spec_flux photon spectral flux in photons/metre, or photon flux if integrate is false
+     * @param integrate whether to integrate over wavelength, or to capture at wavelength[0] only
+     * @param image pointer to image (row-major order)
+     * @param opts threading and tiling options
+     */
+    void CaptureSingle(const vector<double>& wavelength, const vector<double>& spec_flux, bool integrate, 
+                       unsigned short int* image, const CaptureOptions& opts);
 };
 
 
-class InstrumentSingleDelayLinear: public Instrument
+class InstrumentSingleDelayLinear: public InstrumentSingleDelay
 {
     public:
 
     InstrumentSingleDelayLinear(std::filesystem::path fp_config)
-    : Instrument(fp_config)
+    : InstrumentSingleDelay(fp_config, false)
     {
         type = "single_delay_linear";
     }
 
-    static bool TestType(const YAML::Node node);
+    InstrumentSingleDelayLinear(InstrumentConfig config)
+    : InstrumentSingleDelay(std::move(config), false)
+    {
+        type = "single_delay_linear";
+    }
 
-    void Capture(double wavelength, double flux, vector<unsigned short int>* image) override;
+    static bool TestType(const YAML::Node node);
 
-    void Capture(vector<double>& wavelength, vector<double>& spec_flux, vector<unsigned short int>* image) override;
+    /**
+     * @brief test whether a parsed camera and interferometer are of this instrument type
+     */
+    static bool TestType(const cispp::Camera& camera, const vector<unique_ptr<cispp::Component>>& components);
 };
 
 
-class InstrumentSingleDelayPixelated: public Instrument
+class InstrumentSingleDelayPixelated: public InstrumentSingleDelay
 {
     public:
 
     InstrumentSingleDelayPixelated(std::filesystem::path fp_config)
-    : Instrument(fp_config)
+    : InstrumentSingleDelay(fp_config, true)
+    {
+        type = "single_delay_pixelated";
+    }
+
+    InstrumentSingleDelayPixelated(InstrumentConfig config)
+    : InstrumentSingleDelay(std::move(config), true)
     {
         type = "single_delay_pixelated";
     }
 
     static bool TestType(const YAML::Node node);
 
-    void Capture(double wavelength, double flux, vector<unsigned short int>* image) override;
+    /**
+     * @brief test whether a parsed camera and interferometer are of this instrument type
+     */
+    static bool TestType(const cispp::Camera& camera, const vector<unique_ptr<cispp::Component>>& components);
+};
+
+
+/**
+ * @brief Instrument of ideal polarisers and retarders in any arrangement (e.g. several delays), captured through its 
+ * closed-form transfer function
+ * 
+ * The interferometer is reduced symbolically (see cispp::ReduceInterferometer) to a constant plus cos / sin terms of 
+ * the retarders' delays and their sums / differences, which the generic kernel TransferFunction::EvaluateBatch 
+ * evaluates a pixel row at a time. The transfer function is reduced again if a component orientation or the camera 
+ * type changes; if the instrument no longer reduces, or for single-precision capture, the Mueller model is used.
+ */
+class InstrumentReduced: public Instrument
+{
+    public:
+
+    InstrumentReduced(std::filesystem::path fp_config)
+    : Instrument(fp_config)
+    {
+        type = "reduced";
+    }
+
+    InstrumentReduced(InstrumentConfig config)
+    : Instrument(std::move(config))
+    {
+        type = "reduced";
+    }
+
+    using Instrument::Capture;
+
+    void Capture(double wavelength, double flux, unsigned short int* image, 
+                 const CaptureOptions& opts = CaptureOptions()) override;
+
+    void Capture(vector<double>& wavelength, vector<double>& spec_flux, unsigned short int* image, 
+                 const CaptureOptions& opts = CaptureOptions()) override;
+
+    /**
+     * @brief The current transfer function
+     * 
+     * @return const cispp::TransferFunction* nullptr if the instrument does not reduce
+     */
+    const cispp::TransferFunction* GetTransferFunction();
 
-    void Capture(vector<double>& wavelength, vector<double>& spec_flux, vector<unsigned short int>* image) override;
+    /**
+     * @brief test whether a parsed camera and interferometer reduce to a transfer function
+     */
+    static bool TestType(const cispp::Camera& camera, const vector<unique_ptr<cispp::Component>>& components);
+
+    protected:
+
+    TransmissionRowFn GetTransmissionRowFn(const vector<double>& wavelength, const CaptureOptions& opts) override;
+
+    private:
+
+    cispp::TransferFunction transfer;
+    bool reduced {false};
+
+    // instrument state the transfer function was reduced for
+    vector<double> orientation;
+    string camera_type;
+
+    /**
+     * @brief Camera Mueller matrix for each TransferFunction variant: one per super-pixel position for a pixelated 
+     * polariser camera, none otherwise
+     */
+    static vector<Eigen::Matrix4d> GetCameraMueller(cispp::Camera& camera);
+
+    /**
+     * @brief Reduce the transfer function again if the instrument has changed
+     * 
+     * @return whether the instrument reduces
+     */
+    bool UpdateTransferFunction();
+
+    /**
+     * @brief Scratch space for one row of pixels
+     */
+    struct RowScratch
+    {
+        vector<RayScratch> rays;            // per delay
+        vector<cispp::RayBatch> rays_row;   // per delay, into rays
+        vector<double> delay;               // per delay, one row each
+        vector<const double*> delay_row;    // per delay
+        vector<uint8_t> variant;
+        vector<double> kernel;              // TransferFunction::EvaluateBatch scratch
+
+        RowScratch(size_t ndelays, size_t n)
+        : rays(ndelays, RayScratch(n)),
+          rays_row(ndelays),
+          delay(ndelays * n),
+          delay_row(ndelays),
+          variant(n),
+          kernel((2 * ndelays + 2) * n)
+        {}
+    };
+
+    /**
+     * @brief Transmission of pixels [ix0, ix1) of row iy at each of nwl wavelengths, (wavelength, pixel) row-major
+     * 
+     * @param delay_tables delay table of each transfer function delay
+     */
+    void GetTransmissionRow(const vector<unique_ptr<cispp::DelayTable>>& delay_tables, size_t nwl, size_t iy, 
+                            size_t ix0, size_t ix1, RowScratch& scratch, double* t);
 };
 
 /**
@@ -153,5 +921,23 @@ class InstrumentSingleDelayPixelated: public Instrument
  */
 unique_ptr<cispp::Instrument> LoadInstrument(std::filesystem::path fp_config, bool force_mueller=false);
 
+/**
+ * @brief Instrument type of a parsed configuration: "single_delay_linear", "single_delay_pixelated", "reduced" (any 
+ * other chain of ideal polarisers and retarders) or "mueller"
+ * 
+ * @param config 
+ * @return string 
+ */
+string ClassifyInstrument(const InstrumentConfig& config);
+
+/**
+ * @brief Construct the instrument of the given type (as from ClassifyInstrument) from a parsed configuration
+ * 
+ * @param config 
+ * @param type 
+ * @return unique_ptr<cispp::Instrument> 
+ */
+unique_ptr<cispp::Instrument> MakeInstrument(InstrumentConfig config, const string& type);
+
 
 } // namespace cispp
@@ -1,10 +1,24 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
 #include <string>
+#include <utility>
+#include <variant>
 #include <vector>
 #include <cmath>
 
 
+namespace YAML {
+class Node;
+}
+
+
 namespace cispp {
 
 struct MaterialProperties
@@ -12,8 +26,90 @@ struct MaterialProperties
     std::string name {};
     std::vector<double> sellmeier_e;
     std::vector<double> sellmeier_o;
+    std::string source {};  // reference for the Sellmeier coefficients, e.g. "kato1986"
+};
+
+
+/**
+ * @brief Material database, parsed once and shared by the whole process
+ * 
+ * The database file is parsed on first use. Each material's entries are converted to MaterialProperties on its first 
+ * lookup and cached, so building many crystals of the same material costs a map lookup each. All lookups are 
+ * thread-safe.
+ * 
+ * The process-wide registry (Instance) reads $CISPP_ROOT/data/material.yaml, or, if the library was built with 
+ * CISPP_EMBED_MATERIALS, a copy of that file compiled into the library, so that no file I/O is needed.
+ */
+class MaterialRegistry
+{
+    public:
+
+    /**
+     * @brief Registry backed by the given database file
+     * 
+     * @param fpath path to a material .yaml file
+     */
+    explicit MaterialRegistry(std::filesystem::path fpath);
+
+    ~MaterialRegistry();
+
+    MaterialRegistry(const MaterialRegistry&) = delete;
+    MaterialRegistry& operator=(const MaterialRegistry&) = delete;
+
+    /**
+     * @brief The process-wide registry
+     */
+    static MaterialRegistry& Instance();
+
+    /**
+     * @brief Material properties from the first (default) Sellmeier source listed for the material
+     * 
+     * @param material_name 
+     * @return MaterialProperties 
+     */
+    MaterialProperties Get(const std::string& material_name);
+
+    /**
+     * @brief Material properties from the named Sellmeier source
+     * 
+     * @param material_name 
+     * @param source e.g. "kato1986"
+     * @return MaterialProperties 
+     */
+    MaterialProperties Get(const std::string& material_name, const std::string& source);
+
+    /**
+     * @brief Sellmeier sources listed for a material, default first
+     */
+    std::vector<std::string> GetSources(const std::string& material_name);
+
+    /**
+     * @brief Names of all materials in the database
+     */
+    std::vector<std::string> GetMaterialNames();
+
+    private:
+
+    std::filesystem::path fpath;
+    bool embedded {false};
+    std::unique_ptr<YAML::Node> data;
+    std::map<std::string, std::vector<MaterialProperties>> cache;  // material name -> one entry per source
+    std::mutex mutex;
+
+    MaterialRegistry();
+
+    /**
+     * @brief Parse the database, if not yet done. Called with mutex locked.
+     */
+    void Parse();
+
+    /**
+     * @brief Convert the material's entries, if not yet cached. Called with mutex locked.
+     */
+    const std::vector<MaterialProperties>& Load(const std::string& material_name);
 };
 
+
 /**
  * @brief get default material properties by material name
  * 
@@ -21,10 +117,268 @@ struct MaterialProperties
  */
 cispp::MaterialProperties GetMaterialProperties(std::string material_name);
 
+/**
+ * @brief get material properties by material name and Sellmeier source
+ * 
+ * @return MaterialProperties 
+ */
+cispp::MaterialProperties GetMaterialProperties(const std::string& material_name, const std::string& source);
+
+/**
+ * @brief Sellmeier dispersion model with N coefficients per polarisation, fixed at compile time
+ * 
+ * The form of the equation (see SellmeierEqn) is chosen by N with if constexpr and the coefficients are held in 
+ * fixed-size arrays, so evaluation has no branches and no heap indirection and inlines into the caller. 
+ * 
+ * @tparam N number of coefficients: 4, 5 or 6
+ */
+template <size_t N>
+struct SellmeierEvaluator
+{
+    static_assert(N >= 4 && N <= 6, "Sellmeier equations have 4, 5 or 6 coefficients");
+
+    std::array<double, N> e;  // extraordinary
+    std::array<double, N> o;  // ordinary
+
+    /**
+     * @brief Refractive index
+     * 
+     * @param wl_um2 wavelength in microns, squared
+     * @param c coefficients
+     */
+    static inline double Index(double wl_um2, const std::array<double, N>& c)
+    {
+        if constexpr (N == 4) {
+            return sqrt(c[0] + (c[1] / (wl_um2 + c[2])) + (c[3] * wl_um2));
+        }
+        else if constexpr (N == 5) {
+            return sqrt(c[0] + (c[1] / (wl_um2 + c[2])) + (c[3] / (wl_um2 + c[4])));
+        }
+        else {
+            return sqrt((c[0] * wl_um2 / (wl_um2 - c[1])) + (c[2] * wl_um2 / (wl_um2 - c[3])) + 
+                        (c[4] * wl_um2 / (wl_um2 - c[5])) + 1);
+        }
+    }
+
+    /**
+     * @brief Extraordinary and ordinary refractive indices
+     * 
+     * @param wavelength wavelength in metres
+     */
+    inline std::pair<double, double> operator()(double wavelength) const
+    {
+        const double wl_um2 = pow(wavelength * 1e6, 2);
+        return std::pair<double, double>(Index(wl_um2, e), Index(wl_um2, o));
+    }
+
+    /**
+     * @brief Extraordinary and ordinary refractive indices for an array of wavelengths. The loop is branch-free, so 
+     * the compiler can vectorise it.
+     * 
+     * @param wavelength wavelengths in metres, length n
+     * @param ne output extraordinary indices, length n
+     * @param no output ordinary indices, length n
+     * @param n 
+     */
+    void operator()(const double* __restrict wavelength, double* __restrict ne, double* __restrict no, size_t n) const
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            const double wl_um2 = pow(wavelength[i] * 1e6, 2);
+            ne[i] = Index(wl_um2, e);
+            no[i] = Index(wl_um2, o);
+        }
+    }
+};
+
+
+/**
+ * @brief Band and error bounds of a ChebyshevDispersion, of any degree
+ */
+struct ChebyshevBand
+{
+    double wl_min;
+    double wl_max;
+    size_t degree;        // degree of the expansions
+    double error;         // bound on the error in ne and no (see MakeChebyshevDispersion)
+    double error_deriv;   // bound on the error in d(ne - no)/dwl (per metre)
+};
+
+
+/**
+ * @brief Chebyshev surrogate of degree N for a dispersion model over a wavelength band
+ * 
+ * ne, no and the birefringence ne - no are expanded in Chebyshev polynomials T_k(x) of 
+ * x = (2 wavelength - wl_max - wl_min) / (wl_max - wl_min), with the expansion of d(ne - no)/dwl derived from them, so 
+ * that evaluation inside the band is a Clenshaw recurrence of a few FMAs, with no square roots or divisions, and kappa 
+ * is two recurrences. The coefficients are held in fixed-size arrays, as in SellmeierEvaluator, so the recurrences 
+ * unroll. Built by MakeChebyshevDispersion, which records bounds on the errors. Evaluation of the indices outside 
+ * [wl_min, wl_max] throws std::out_of_range; Kappa does not check the band.
+ * 
+ * @tparam N degree: 4, 8, 16, 32 or 64
+ */
+template <size_t N>
+struct ChebyshevDispersion: public ChebyshevBand
+{
+    std::array<double, N + 1> ce;  // coefficients of ne
+    std::array<double, N + 1> co;  // coefficients of no
+    std::array<double, N + 1> cb;  // coefficients of ne - no
+    std::array<double, N> dcb;     // coefficients of d(ne - no)/dwl (per metre)
+
+    /**
+     * @brief Sum of c[k] T_k(x), by Clenshaw's recurrence
+     */
+    template <size_t M>
+    static inline double Clenshaw(const std::array<double, M>& c, double x)
+    {
+        double b1 = 0, b2 = 0;
+        for (size_t k = M - 1; k > 0; k--)
+        {
+            const double b = 2 * x * b1 - b2 + c[k];
+            b2 = b1;
+            b1 = b;
+        }
+        return x * b1 - b2 + c[0];
+    }
+
+    inline double GetX(double wavelength) const
+    {
+        if (!(wavelength >= wl_min && wavelength <= wl_max)) {
+            throw std::out_of_range("wavelength outside the band of the Chebyshev dispersion model");
+        }
+        return (2 * wavelength - wl_max - wl_min) / (wl_max - wl_min);
+    }
+
+    /**
+     * @brief Extraordinary and ordinary refractive indices
+     * 
+     * @param wavelength wavelength in metres
+     */
+    inline std::pair<double, double> operator()(double wavelength) const
+    {
+        const double x = GetX(wavelength);
+        return std::pair<double, double>(Clenshaw(ce, x), Clenshaw(co, x));
+    }
+
+    /**
+     * @brief Extraordinary and ordinary refractive indices for an array of wavelengths. The band is checked once, 
+     * before the loop.
+     * 
+     * @param wavelength wavelengths in metres, length n
+     * @param ne output extraordinary indices, length n
+     * @param no output ordinary indices, length n
+     * @param n 
+     */
+    void operator()(const double* __restrict wavelength, double* __restrict ne, double* __restrict no, size_t n) const
+    {
+        if (n == 0) {
+            return;
+        }
+        double wl_lo = wavelength[0], wl_hi = wavelength[0];
+        for (size_t i = 1; i < n; i++)
+        {
+            wl_lo = std::min(wl_lo, wavelength[i]);
+            wl_hi = std::max(wl_hi, wavelength[i]);
+        }
+        GetX(wl_lo);
+        GetX(wl_hi);
+        const double scale = 2 / (wl_max - wl_min);
+        const double offset = (wl_max + wl_min) / (wl_max - wl_min);
+        for (size_t i = 0; i < n; i++)
+        {
+            const double x = scale * wavelength[i] - offset;
+            ne[i] = Clenshaw(ce, x);
+            no[i] = Clenshaw(co, x);
+        }
+    }
+
+    /**
+     * @brief Birefringence ne - no and its wavelength derivative (per metre)
+     * 
+     * @param wavelength wavelength in metres
+     */
+    inline std::pair<double, double> Birefringence(double wavelength) const
+    {
+        const double x = GetX(wavelength);
+        return std::pair<double, double>(Clenshaw(cb, x), Clenshaw(dcb, x));
+    }
+
+    /**
+     * @brief Group delay / phase delay of the birefringence (see cispp::GetKappa). The band is not checked: outside 
+     * it the expansions no longer follow the model.
+     * 
+     * @param wavelength wavelength in metres
+     */
+    inline double Kappa(double wavelength) const
+    {
+        const double x = (2 * wavelength - wl_max - wl_min) / (wl_max - wl_min);
+        return 1 - wavelength * Clenshaw(dcb, x) / Clenshaw(cb, x);
+    }
+};
+
+
+/**
+ * @brief Dispersion model of any supported form: a Sellmeier equation, or a Chebyshev surrogate for one. Built once 
+ * (MakeDispersionModel, MakeChebyshevDispersion), then evaluated with std::visit, so that the form is dispatched once 
+ * per call rather than inside the evaluation.
+ */
+using DispersionModel = std::variant<SellmeierEvaluator<4>, SellmeierEvaluator<5>, SellmeierEvaluator<6>, 
+                                     ChebyshevDispersion<4>, ChebyshevDispersion<8>, ChebyshevDispersion<16>, 
+                                     ChebyshevDispersion<32>, ChebyshevDispersion<64>>;
+
+
+/**
+ * @brief Band and error bounds of a dispersion model's Chebyshev surrogate, or nullptr for a Sellmeier equation
+ */
+const ChebyshevBand* GetChebyshevBand(const DispersionModel& model);
+
+
+/**
+ * @brief Dispersion model for a material's Sellmeier coefficients
+ * 
+ * @param mp 
+ * @return DispersionModel 
+ */
+DispersionModel MakeDispersionModel(const cispp::MaterialProperties& mp);
+
+
+/**
+ * @brief Fit a Chebyshev surrogate to a dispersion model over a wavelength band
+ * 
+ * The error is bounded from the analyticity of the Sellmeier equation: ne and no are analytic inside a Bernstein 
+ * ellipse of parameter rho about the band that excludes the poles of the equation and the zeros of n^2, and if 
+ * |n| <= M on that ellipse, the Chebyshev coefficients are bounded by 2 M rho^-k. M is bounded on a few ellipses 
+ * between the band and the nearest pole, by sampling each ellipse with a bound on the derivative of n^2 between the 
+ * samples. The model is interpolated at the Chebyshev extreme points with degree 2n, for n = 4, 8, 16, 32, 64, and 
+ * truncated to degree n, so that the error is at most 2 M rho^-n / (rho - 1) plus the aliasing of the terms of degree 
+ * 3n and above. The error in d(ne - no)/dwl follows from the same coefficient bounds for both indices, with 
+ * |T_k'| <= k^2. The smallest of these bounds over the ellipses is recorded, and the degree stops increasing once the 
+ * index bound is below tol, or at 64. The bounds leave out floating-point rounding in the evaluation, of order 1e-15.
+ * 
+ * @param model a Sellmeier model: std::invalid_argument is thrown for a surrogate, or if the band contains a pole
+ * @param wl_min band lower limit (metres)
+ * @param wl_max band upper limit (metres)
+ * @param tol target error bound in ne and no
+ * @return DispersionModel a ChebyshevDispersion<N>
+ */
+DispersionModel MakeChebyshevDispersion(const DispersionModel& model, double wl_min, double wl_max, double tol = 1e-12);
+
+
 std::pair<double, double> GetRefractiveIndices(double wavelength, cispp::MaterialProperties &mp);
 
 double GetKappa(double wavelength, cispp::MaterialProperties &mp);
 
+/**
+ * @brief Group delay / phase delay of the birefringence, 1 - (wavelength / B) dB/dwavelength with B = ne - no. For a 
+ * ChebyshevDispersion this is two recurrences on the expansions of B and dB/dwavelength, and the wavelength is not 
+ * checked against the band; otherwise the derivative is a central difference.
+ * 
+ * @param wavelength wavelength in metres
+ * @param model 
+ * @return double 
+ */
+double GetKappa(double wavelength, const DispersionModel& model);
+
 double SellmeierEqn(double wl_um2, double A, double B, double C, double D);
 
 double SellmeierEqn(double wl_um2, double A, double B, double C, double D, double E);
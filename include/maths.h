@@ -15,7 +15,7 @@ namespace cispp {
  * @return 
  */
 template <typename T>
-T trapz(std::vector<T> x, std::vector<T> y)
+T trapz(const std::vector<T>& x, const std::vector<T>& y)
 {
     assert (x.size() == y.size());
     T out = 0;
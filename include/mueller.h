@@ -0,0 +1,270 @@
+#pragma once
+
+#include <cmath>
+#include <Eigen/Dense>
+
+
+namespace cispp {
+
+
+/**
+ * @brief Mueller operator (CRTP base class)
+ *
+ * Mueller operators are fixed-structure alternatives to dense Eigen::Matrix4d Mueller matrices. Each derived type
+ * knows which of its elements are zero, so can be applied to a Stokes vector (Apply: s -> M s) or to a row vector
+ * (ApplyRow: r -> r M) in a handful of multiplications. Operators compose with operator* into a MuellerProduct,
+ * whose structure is known at compile time. Propagating only the S0 row through a chain of operators gives the
+ * intensity at the camera without building any dense matrix.
+ *
+ * Every operator also provides Matrix(), the equivalent dense Mueller matrix.
+ *
+ * @tparam Derived
+ */
+template <class Derived>
+struct MuellerOperator
+{
+    const Derived& Self() const {
+        return static_cast<const Derived&>(*this);
+    }
+};
+
+
+/**
+ * @brief Mueller operator for frame rotation by angle θ: identity on S0 and S3, 2x2 rotation by 2θ on S1 and S2
+ *
+ * Matches GetRotationMatrix.
+ */
+struct MuellerRotator: public MuellerOperator<MuellerRotator>
+{
+    double c;  // cos(2θ)
+    double s;  // sin(2θ)
+
+    MuellerRotator(double c, double s)
+    : c(c),
+      s(s)
+    {}
+
+    /**
+     * @param angle angle of rotation in radians, anti-clockwise from x-axis.
+     */
+    static MuellerRotator FromAngle(double angle) {
+        return MuellerRotator(cos(2 * angle), sin(2 * angle));
+    }
+
+    MuellerRotator Transpose() const {
+        return MuellerRotator(c, -s);
+    }
+
+    Eigen::Matrix4d Matrix() const
+    {
+        Eigen::Matrix4d m;
+        m << 1,  0,  0,  0,
+             0,  c,  s,  0,
+             0, -s,  c,  0,
+             0,  0,  0,  1;
+        return m;
+    }
+
+    void Apply(Eigen::Vector4d& stokes) const
+    {
+        const double s1 = stokes(1);
+        stokes(1) = c * s1 + s * stokes(2);
+        stokes(2) = -s * s1 + c * stokes(2);
+    }
+
+    void ApplyRow(Eigen::RowVector4d& row) const
+    {
+        const double r1 = row(1);
+        row(1) = r1 * c - row(2) * s;
+        row(2) = r1 * s + row(2) * c;
+    }
+};
+
+
+/**
+ * @brief Mueller operator for an ideal linear retarder aligned with the x-axis: identity on S0 and S1, 2x2 rotation
+ * by the delay on S2 and S3
+ */
+struct MuellerRetarder: public MuellerOperator<MuellerRetarder>
+{
+    double c;  // cos(delay)
+    double s;  // sin(delay)
+
+    MuellerRetarder(double c, double s)
+    : c(c),
+      s(s)
+    {}
+
+    /**
+     * @param delay retardance in radians
+     */
+    static MuellerRetarder FromDelay(double delay) {
+        return MuellerRetarder(cos(delay), sin(delay));
+    }
+
+    Eigen::Matrix4d Matrix() const
+    {
+        Eigen::Matrix4d m;
+        m <<   1,  0,  0,  0,
+               0,  1,  0,  0,
+               0,  0,  c,  s,
+               0,  0, -s,  c;
+        return m;
+    }
+
+    void Apply(Eigen::Vector4d& stokes) const
+    {
+        const double s2 = stokes(2);
+        stokes(2) = c * s2 + s * stokes(3);
+        stokes(3) = -s * s2 + c * stokes(3);
+    }
+
+    void ApplyRow(Eigen::RowVector4d& row) const
+    {
+        const double r2 = row(2);
+        row(2) = r2 * c - row(3) * s;
+        row(3) = r2 * s + row(3) * c;
+    }
+};
+
+
+/**
+ * @brief Mueller operator for an ideal linear polariser aligned with the x-axis
+ */
+struct MuellerPolariser: public MuellerOperator<MuellerPolariser>
+{
+    Eigen::Matrix4d Matrix() const
+    {
+        Eigen::Matrix4d m;
+        m << 0.5, 0.5,   0,   0,
+             0.5, 0.5,   0,   0,
+               0,   0,   0,   0,
+               0,   0,   0,   0;
+        return m;
+    }
+
+    void Apply(Eigen::Vector4d& stokes) const
+    {
+        stokes(0) = 0.5 * (stokes(0) + stokes(1));
+        stokes(1) = stokes(0);
+        stokes(2) = 0;
+        stokes(3) = 0;
+    }
+
+    void ApplyRow(Eigen::RowVector4d& row) const
+    {
+        row(0) = 0.5 * (row(0) + row(1));
+        row(1) = row(0);
+        row(2) = 0;
+        row(3) = 0;
+    }
+};
+
+
+/**
+ * @brief Mueller operator for a homogeneous diattenuating retarder aligned with the x-axis: a symmetric 2x2 block on
+ * S0 and S1, a scaled 2x2 rotation on S2 and S3
+ */
+struct MuellerDiattenuator: public MuellerOperator<MuellerDiattenuator>
+{
+    double sum;   // (t1 + t2) / 2
+    double diff;  // (t1 - t2) / 2
+    double cosd;  // 2 sqrt(t1 t2) cos(delay)
+    double sind;  // 2 sqrt(t1 t2) sin(delay)
+
+    MuellerDiattenuator(double sum, double diff, double cosd, double sind)
+    : sum(sum),
+      diff(diff),
+      cosd(cosd),
+      sind(sind)
+    {}
+
+    Eigen::Matrix4d Matrix() const
+    {
+        Eigen::Matrix4d m;
+        m <<   sum,  diff,     0,     0,
+              diff,   sum,     0,     0,
+                 0,     0,  cosd,  sind,
+                 0,     0, -sind,  cosd;
+        return m;
+    }
+
+    void Apply(Eigen::Vector4d& stokes) const
+    {
+        const double s0 = stokes(0);
+        const double s2 = stokes(2);
+        stokes(0) = sum * s0 + diff * stokes(1);
+        stokes(1) = diff * s0 + sum * stokes(1);
+        stokes(2) = cosd * s2 + sind * stokes(3);
+        stokes(3) = -sind * s2 + cosd * stokes(3);
+    }
+
+    void ApplyRow(Eigen::RowVector4d& row) const
+    {
+        const double r0 = row(0);
+        const double r2 = row(2);
+        row(0) = r0 * sum + row(1) * diff;
+        row(1) = r0 * diff + row(1) * sum;
+        row(2) = r2 * cosd - row(3) * sind;
+        row(3) = r2 * sind + row(3) * cosd;
+    }
+};
+
+
+/**
+ * @brief Product a * b of two Mueller operators, i.e. b acts on the light first
+ *
+ * @tparam A
+ * @tparam B
+ */
+template <class A, class B>
+struct MuellerProduct: public MuellerOperator<MuellerProduct<A, B>>
+{
+    A a;
+    B b;
+
+    MuellerProduct(const A& a, const B& b)
+    : a(a),
+      b(b)
+    {}
+
+    Eigen::Matrix4d Matrix() const {
+        return a.Matrix() * b.Matrix();
+    }
+
+    void Apply(Eigen::Vector4d& stokes) const
+    {
+        b.Apply(stokes);
+        a.Apply(stokes);
+    }
+
+    void ApplyRow(Eigen::RowVector4d& row) const
+    {
+        a.ApplyRow(row);
+        b.ApplyRow(row);
+    }
+};
+
+
+template <class A, class B>
+MuellerProduct<A, B> operator*(const MuellerOperator<A>& a, const MuellerOperator<B>& b) {
+    return MuellerProduct<A, B>(a.Self(), b.Self());
+}
+
+
+/**
+ * @brief Operator rotated into the lab frame, for a component with its axis at the given orientation: R^T M R
+ *
+ * @param op operator in the component frame
+ * @param orientation component orientation in radians, anti-clockwise from x-axis.
+ */
+template <class Op>
+MuellerProduct<MuellerProduct<MuellerRotator, Op>, MuellerRotator> Rotate(const MuellerOperator<Op>& op,
+                                                                           double orientation)
+{
+    MuellerRotator rot = MuellerRotator::FromAngle(orientation);
+    return rot.Transpose() * op * rot;
+}
+
+
+} // namespace cispp
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+namespace cispp {
+
+
+/**
+ * @brief Rectangular block of sensor pixels, [ix0, ix1) x [iy0, iy1)
+ *
+ */
+struct Tile
+{
+    size_t ix0;
+    size_t ix1;
+    size_t iy0;
+    size_t iy1;
+};
+
+
+/**
+ * @brief Split a sensor into tiles, in row-major order
+ *
+ * @param nx sensor width in pixels
+ * @param ny sensor height in pixels
+ * @param tile_cols tile width in pixels, 0 = full sensor width
+ * @param tile_rows tile height in pixels, 0 = full sensor height
+ * @return std::vector<Tile>
+ */
+std::vector<Tile> GetTiles(size_t nx, size_t ny, size_t tile_cols, size_t tile_rows);
+
+
+/**
+ * @brief Number of hardware threads available, at least 1
+ *
+ * @return size_t
+ */
+size_t GetHardwareThreadCount();
+
+
+/**
+ * @brief Fixed-size pool of worker threads for data-parallel loops
+ *
+ * The calling thread takes part in the work, so a pool of size 1 starts no threads and runs everything inline.
+ */
+class ThreadPool
+{
+    public:
+
+    /**
+     * @brief Construct a new ThreadPool
+     *
+     * @param nthreads total number of threads, including the calling thread. 0 = all hardware threads
+     */
+    ThreadPool(size_t nthreads);
+
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t GetThreadCount() const {
+        return workers.size() + 1;
+    }
+
+    /**
+     * @brief Call fn(itask, iworker) for every itask in [0, ntasks), blocking until all tasks are done
+     *
+     * Tasks are handed out dynamically. iworker is in [0, GetThreadCount()) and is fixed for a given thread during
+     * the call, so can be used to index per-worker scratch buffers. The first exception thrown by a task is rethrown
+     * here. Must not be called from inside a task.
+     *
+     * @param ntasks
+     * @param fn
+     */
+    void ParallelFor(size_t ntasks, const std::function<void(size_t, size_t)>& fn);
+
+    private:
+
+    void WorkerLoop(size_t iworker);
+
+    void RunTasks(size_t iworker);
+
+    std::vector<std::thread> workers;
+    std::mutex mtx_call;  // serialises ParallelFor calls
+    std::mutex mtx;
+    std::condition_variable cv_start;
+    std::condition_variable cv_done;
+    const std::function<void(size_t, size_t)>* job {nullptr};
+    size_t job_ntasks {0};
+    std::atomic<size_t> next_task {0};
+    size_t generation {0};
+    size_t nbusy {0};
+    bool stop {false};
+    std::exception_ptr error {nullptr};
+};
+
+
+} // namespace cispp
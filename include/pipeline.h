@@ -0,0 +1,97 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+
+namespace cispp {
+
+
+/**
+ * @brief Throughput of a FramePipeline run
+ * 
+ */
+struct PipelineStats
+{
+    size_t nframes {0};          // frames captured and written
+    double duration {0};         // end-to-end wall time (seconds)
+    double fps {0};              // end-to-end throughput (frames/second)
+    double capture_time {0};     // time spent capturing (seconds)
+    double write_time {0};       // time spent writing (seconds)
+    double capture_wait {0};     // time the capture stage was blocked by a full queue (seconds)
+};
+
+
+/**
+ * @brief Two-stage capture-and-write pipeline with a bounded queue of reusable frame buffers
+ *
+ * The capture stage runs on the calling thread (Instrument::Capture is itself multithreaded), while a writer thread 
+ * serialises finished frames in order, so that capture and I/O overlap. Frame buffers are allocated once and 
+ * recycled. When queue_depth frames are waiting to be written, capture blocks until the writer frees a buffer 
+ * (backpressure), so memory use is bounded however slow the writer is.
+ */
+class FramePipeline
+{
+    public:
+
+    /**
+     * @brief Fill the frame buffer for frame iframe. The buffer holds frame_size pixels and may contain an earlier 
+     * frame.
+     */
+    using CaptureFn = std::function<void(size_t iframe, std::vector<unsigned short int>* frame)>;
+
+    /**
+     * @brief Write frame iframe. Called from the writer thread, in frame order.
+     */
+    using WriteFn = std::function<void(size_t iframe, std::vector<unsigned short int>* frame)>;
+
+    /**
+     * @brief Construct a new FramePipeline
+     * 
+     * @param frame_size number of pixels per frame
+     * @param queue_depth max number of captured frames waiting to be written, at least 1
+     */
+    FramePipeline(size_t frame_size, size_t queue_depth = 4);
+
+    FramePipeline(const FramePipeline&) = delete;
+    FramePipeline& operator=(const FramePipeline&) = delete;
+
+    size_t GetQueueDepth() const {
+        return queue_depth;
+    }
+
+    /**
+     * @brief Capture and write nframes frames, blocking until the last frame is written
+     * 
+     * The first exception thrown by either stage stops the pipeline and is rethrown here.
+     * 
+     * @param nframes 
+     * @param capture 
+     * @param write 
+     * @return PipelineStats 
+     */
+    PipelineStats Run(size_t nframes, const CaptureFn& capture, const WriteFn& write);
+
+    private:
+
+    size_t queue_depth;
+    std::vector<std::vector<unsigned short int>> buffers;  // queue_depth + 1: queued or capturing, plus one writing
+
+    std::mutex mtx;
+    std::condition_variable cv_free;                       // a frame was dequeued or its buffer freed, or stopped
+    std::condition_variable cv_full;                       // a frame was queued, or the pipeline stopped
+    std::deque<size_t> free_buffers;
+    std::deque<std::pair<size_t, size_t>> queue;           // (iframe, ibuffer) waiting to be written
+    bool capture_done {false};
+    bool stop {false};
+    std::exception_ptr error {nullptr};
+
+    void WriterLoop(const WriteFn& write, PipelineStats& stats);
+};
+
+
+} // namespace cispp
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+#include "include/spectrum.h"
+
+
+namespace cispp {
+
+
+/**
+ * @brief Wavelength nodes and weights for integrating over a spectrum
+ *
+ * The weights include the spectrum itself: for a transmission t(wl), sum_i weight[i] * t(wavelength[i]) approximates
+ * int spec_flux(wl) * t(wl) dwl, in photons. Weights are computed once per spectrum, so that the capture inner loop
+ * is a dot product (see Instrument::CaptureQuadrature).
+ *
+ */
+struct QuadratureGrid
+{
+    std::vector<double> wavelength;  // nodes, in metres
+    std::vector<double> weight;      // photons per node
+    double error {0};                // estimated error in the total flux, for rules that provide one (photons)
+};
+
+
+/**
+ * @brief Quadrature rule for sampled spectra
+ *
+ */
+enum class QuadratureRule
+{
+    Trapezoid,  // second order, any grid
+    Simpson,    // fourth order on uniform grids, at least third order on non-uniform grids
+};
+
+
+/**
+ * @brief Trapezoidal rule weights: sum_i w[i] * y[i] equals cispp::trapz(x, y) up to rounding
+ *
+ * @param x sample points, ascending
+ * @return std::vector<double>
+ */
+std::vector<double> trapz_weights(const std::vector<double>& x);
+
+
+/**
+ * @brief Composite Simpson's rule weights for a (possibly non-uniform) grid, exact for quadratics (and for cubics on
+ * uniform grids). Pairs of intervals are integrated with the quadratic through their three points; with an odd
+ * number of intervals the last interval is integrated with the quadratic through the last three points.
+ *
+ * @param x sample points, ascending, at least 2 (2 points fall back to the trapezoidal rule)
+ * @return std::vector<double>
+ */
+std::vector<double> simpson_weights(const std::vector<double>& x);
+
+
+/**
+ * @brief Quadrature grid for a sampled spectrum
+ *
+ * @param wavelength wavelength in metres, ascending
+ * @param spec_flux photon spectral flux in photons/metre
+ * @param rule
+ * @return QuadratureGrid, on the same wavelengths
+ */
+QuadratureGrid sampled_quadrature(const std::vector<double>& wavelength, const std::vector<double>& spec_flux,
+                                  QuadratureRule rule = QuadratureRule::Simpson);
+
+
+/**
+ * @brief Clenshaw-Curtis quadrature grid for a spectrum given as a function, on [wl_min, wl_max]
+ *
+ * Nodes are the n + 1 Chebyshev extreme points, so the rule integrates polynomials of degree n exactly and converges
+ * geometrically for smooth spectra (continua, broad features), with far fewer nodes than a uniform grid.
+ *
+ * @param spec_flux photon spectral flux in photons/metre, as a function of wavelength in metres
+ * @param wl_min
+ * @param wl_max
+ * @param n number of intervals (n + 1 nodes)
+ * @return QuadratureGrid
+ */
+QuadratureGrid clenshaw_curtis(const std::function<double(double)>& spec_flux, double wl_min, double wl_max, size_t n);
+
+
+/**
+ * @brief Gauss-Hermite quadrature grid for a sum of Gaussian lines (as in gaussian() and get_gaussian_multiplet())
+ *
+ * The line shape is Gaussian in u = (wl0 - wl) / wl, with standard deviation sigma / (sigma + wl0), so each line
+ * gets the n-point Gauss-Hermite rule in u (nodes and weights by the Golub-Welsch method), mapped back to wavelength.
+ * The rule is exact for transmissions that are polynomials of degree 2n - 1 in u. For two-beam fringes, about
+ * (delay x sigma / wl0)^2 + 10 nodes per line reach double precision, so the rule is most economical at delays where
+ * the line still has appreciable fringe contrast.
+ *
+ * @param lines line list
+ * @param n nodes per line
+ * @return QuadratureGrid, line by line (not sorted by wavelength)
+ */
+QuadratureGrid gauss_hermite(const std::vector<SpectralLine>& lines, size_t n);
+
+
+/**
+ * @brief Adaptive Simpson quadrature grid for a spectrum given as a function, on [wl_min, wl_max]
+ *
+ * Intervals are bisected until Simpson's rule on the interval and on its two halves agree to within the interval's
+ * share (in proportion to its width) of 15 x tol x the total flux; the accepted half-interval rules become the grid.
+ * The estimated error, sum |S_halves - S| / 15, is returned in QuadratureGrid::error. Adaptive sampling suits
+ * spectra with localised structure on a smooth background; the error estimate is of the flux integral only, so for
+ * fringes at large delays pass a tighter tol.
+ *
+ * @param spec_flux photon spectral flux in photons/metre, as a function of wavelength in metres
+ * @param wl_min
+ * @param wl_max
+ * @param tol integration tolerance, relative to the total flux
+ * @param max_depth maximum number of bisections of the initial interval
+ * @return QuadratureGrid, sorted by wavelength
+ */
+QuadratureGrid adaptive_simpson(const std::function<double(double)>& spec_flux, double wl_min, double wl_max,
+                                double tol = 1e-6, size_t max_depth = 40);
+
+
+} // namespace cispp
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+
+namespace cispp {
+
+
+/**
+ * @brief Philox4x32-10 counter-based random number generator (Salmon et al., SC'11), for N counters at once
+ * 
+ * Each 128-bit counter is mapped to 4 independent 32-bit random numbers under a 64-bit key, with no state carried 
+ * between calls. Keying the counter on e.g. (pixel, frame) gives random numbers that do not depend on the order in 
+ * which pixels are visited, so results are reproducible for any thread count or tiling. The lanes are independent 
+ * and use only 32 x 32 -> 64-bit multiplies, so the loop over N vectorises.
+ * 
+ * @tparam N number of counters
+ * @param ctr counters, ctr[word][lane], replaced by the random numbers
+ * @param key 
+ */
+template <size_t N>
+inline void Philox4x32(uint32_t (&ctr)[4][N], const std::array<uint32_t, 2>& key)
+{
+    constexpr uint64_t m0 = 0xD2511F53;
+    constexpr uint64_t m1 = 0xCD9E8D57;
+    constexpr uint32_t w0 = 0x9E3779B9;
+    constexpr uint32_t w1 = 0xBB67AE85;
+
+    uint32_t k0 = key[0];
+    uint32_t k1 = key[1];
+    for (int round = 0; round < 10; round++)
+    {
+        for (size_t j = 0; j < N; j++)
+        {
+            const uint64_t p0 = m0 * ctr[0][j];
+            const uint64_t p1 = m1 * ctr[2][j];
+            const uint32_t c1 = ctr[1][j];
+            const uint32_t c3 = ctr[3][j];
+            ctr[0][j] = static_cast<uint32_t>(p1 >> 32) ^ c1 ^ k0;
+            ctr[1][j] = static_cast<uint32_t>(p1);
+            ctr[2][j] = static_cast<uint32_t>(p0 >> 32) ^ c3 ^ k1;
+            ctr[3][j] = static_cast<uint32_t>(p0);
+        }
+        k0 += w0;
+        k1 += w1;
+    }
+}
+
+
+/**
+ * @brief Philox4x32-10 for a single counter
+ * 
+ * @param ctr 
+ * @param key 
+ * @return std::array<uint32_t, 4> 
+ */
+inline std::array<uint32_t, 4> Philox4x32(const std::array<uint32_t, 4>& ctr, const std::array<uint32_t, 2>& key)
+{
+    uint32_t c[4][1] = {{ctr[0]}, {ctr[1]}, {ctr[2]}, {ctr[3]}};
+    Philox4x32<1>(c, key);
+    return {c[0][0], c[1][0], c[2][0], c[3][0]};
+}
+
+
+/**
+ * @brief Map a 32-bit random integer to a uniform double in the open interval (0, 1)
+ */
+inline double ToUniform(uint32_t x)
+{
+    return (x + 0.5) * (1. / 4294967296.);
+}
+
+
+} // namespace cispp
@@ -49,7 +49,35 @@ struct Spectrum
 Spectrum gaussian(double wl0, double wlsigma, double flux, size_t nbins, size_t nsigma);
 
 
-Spectrum get_gaussian_multiplet();
+/**
+ * @brief Gaussian spectral line, with the same line shape as gaussian()
+ * 
+ */
+struct SpectralLine
+{
+    double wavelength;  // central wavelength in metres
+    double sigma;       // standard deviation wavelength in metres
+    double flux;        // photon flux in the line (area under its spectral flux)
+};
+
+
+/**
+ * @brief Sum of Gaussian lines, on a wavelength grid chosen from an integration tolerance
+ * 
+ * Lines whose significant wavelength ranges overlap are grouped into clusters, and each cluster gets its own uniform 
+ * grid; the gaps between clusters, where the spectrum is negligible, get no points. For smooth lines the trapezoidal 
+ * rule on a uniform grid converges exponentially, its error coming from aliasing, so the spacing in a cluster is set 
+ * from its narrowest line by exp(-sigma^2 (2 pi / dwl - max_delay / wl)^2 / 2) <= tol: the coherence integral is then 
+ * accurate to about tol x the flux at all delays up to max_delay. Each line is cut off where its spectral flux, 
+ * integrated over the whole wavelength range, would be below tol x the flux. So the number of bins follows from tol 
+ * and max_delay rather than being fixed up front, and grows only logarithmically as tol is tightened.
+ * 
+ * @param lines line list
+ * @param tol integration tolerance, relative to the total flux
+ * @param max_delay largest interferometer delay (radians) at which the spectrum's coherence will be evaluated
+ * @return Spectrum, sorted by wavelength
+ */
+Spectrum get_gaussian_multiplet(const std::vector<SpectralLine>& lines, double tol = 1e-6, double max_delay = 0);
 
 
 } // namespace cispp
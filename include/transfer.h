@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <Eigen/Dense>
+
+#include "include/component.h"
+
+
+namespace cispp {
+
+
+/**
+ * @brief One Fourier term of a TransferFunction: a cos(phase) + b sin(phase), with phase = sum_k m[k] delay[k]
+ *
+ */
+struct FourierTerm
+{
+    std::vector<int> m;       // multiplier of each delay: -1, 0 or 1, first non-zero multiplier +1
+    std::vector<double> a;    // cos coefficient, per variant
+    std::vector<double> b;    // sin coefficient, per variant
+};
+
+
+/**
+ * @brief Closed-form S0 transmission of a chain of ideal polarisers and retarders, as a function of the retarders'
+ * delays (see ReduceInterferometer)
+ *
+ * t = constant + sum over terms of a cos(phase) + b sin(phase), where each phase is a sum / difference of delays. A
+ * variant is one camera super-pixel position, for a pixelated polariser camera (4 variants, q = (ix % 2) + 2 (iy % 2),
+ * as in Camera::GetMuellerMatrix); otherwise there is a single variant.
+ */
+struct TransferFunction
+{
+    std::vector<size_t> icomp;       // components whose delays are the variables, in chain order
+    std::vector<double> constant;    // per variant
+    std::vector<FourierTerm> terms;
+
+    size_t GetVariantCount() const {
+        return constant.size();
+    }
+
+    /**
+     * @brief Transmission for one set of delays
+     *
+     * @param delay delays of components icomp (radians)
+     * @param variant
+     * @return double
+     */
+    double Evaluate(const double* delay, size_t variant = 0) const;
+
+    /**
+     * @brief Transmission for a row of pixels: the generic fast-path kernel
+     *
+     * The sines and cosines of the delays are taken once per pixel and each term's phasor is built from them by
+     * complex multiplication, so the kernel needs no trigonometry per term. Every loop runs over the pixels, with no
+     * branches, so that it vectorises.
+     *
+     * @param delay delays of components icomp, one row of n pixels per component (radians)
+     * @param variant variant of each pixel, length n (ignored if there is a single variant)
+     * @param n number of pixels
+     * @param scratch (2 * icomp.size() + 2) * n doubles
+     * @param t output transmission, length n
+     */
+    void EvaluateBatch(const double* const* delay, const uint8_t* variant, size_t n, double* scratch, double* t) const;
+};
+
+
+/**
+ * @brief Reduce a chain of ideal polarisers and retarders to its S0 transfer function
+ *
+ * The row vector (1, 0, 0, 0) is multiplied through the chain, and then the camera, symbolically. Each element is a
+ * trigonometric polynomial in the delays of the pixel- or wavelength-dependent ideal retarders, held as its
+ * coefficients of exp(i sum_k m_k delay_k) for m_k in {-1, 0, 1}. The Mueller matrix of such a retarder is
+ * A + B cos(delay) + C sin(delay), so its delay only ever shifts the m_k of its own index. All other components must
+ * be independent of pixel and wavelength, and enter as constant matrices. Terms whose coefficients are below 1e-12 of
+ * the total are dropped as rounding error. Matches Instrument::GetPixelMuellerMatrix(...)(0, 0) to rounding error.
+ *
+ * @param components interferometer components
+ * @param camera_mueller camera Mueller matrix for each variant, or empty for a camera with no polariser
+ * @param transfer output transfer function
+ * @param max_delays most variable delays to reduce (the number of terms grows as 3^n / 2)
+ * @return true if the chain reduced, false if a component is neither constant nor an ideal retarder, or if there
+ * are more than max_delays variable delays
+ */
+bool ReduceInterferometer(const std::vector<std::unique_ptr<Component>>& components,
+                          const std::vector<Eigen::Matrix4d>& camera_mueller, TransferFunction* transfer,
+                          size_t max_delays = 8);
+
+
+} // namespace cispp
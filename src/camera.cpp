@@ -1,7 +1,9 @@
 #include <algorithm>
+#include <cmath>
 #include <vector>
 #include "include/camera.h"
 #include "include/component.h"
+#include "include/random.h"
 
 
 namespace cispp {
@@ -63,11 +65,11 @@ size_t cispp::Camera::GetPixelIndexY(double y)
 }
 
 
-double cispp::Camera::GetPixelatedPhaseMask(double x, double y)
+/**
+ * @brief pixelated phase mask value by pixel index
+ */
+static double GetPixelatedPhaseMaskByIndex(size_t ix, size_t iy)
 {
-    size_t ix = GetPixelIndexX(x);
-    size_t iy = GetPixelIndexY(y);
-
     if (ix % 2 == 0){
         if (iy % 2 == 0){
             return 0.;
@@ -87,6 +89,20 @@ double cispp::Camera::GetPixelatedPhaseMask(double x, double y)
 }
 
 
+double cispp::Camera::GetPixelatedPhaseMask(double x, double y)
+{
+    return GetPixelatedPhaseMaskByIndex(GetPixelIndexX(x), GetPixelIndexY(y));
+}
+
+
+void cispp::Camera::GetPixelatedPhaseMaskRow(size_t iy, size_t ix0, size_t ix1, double* mask) const
+{
+    for (size_t ix = ix0; ix < ix1; ix++) {
+        mask[ix - ix0] = GetPixelatedPhaseMaskByIndex(ix, iy);
+    }
+}
+
+
 Eigen::Matrix4d cispp::Camera::GetMuellerMatrix(double x, double y)
 {
     size_t ix = GetPixelIndexX(x);
@@ -111,4 +127,91 @@ Eigen::Matrix4d cispp::Camera::GetMuellerMatrix(double x, double y)
 }
 
 
+template <typename Real>
+void cispp::Camera::Digitise(const Real* photons, size_t n, uint64_t pixel0, const SensorOptions& sensor, 
+                             unsigned short int* counts) const
+{
+    if (!sensor.enable)
+    {
+        for (size_t i = 0; i < n; i++) {
+            counts[i] = static_cast<unsigned short int>(photons[i]);
+        }
+        return;
+    }
+
+    constexpr size_t block = 8;
+    constexpr double poisson_max = 32;  // exact Poisson shot noise below this mean, Gaussian above
+    const double max_count = std::ldexp(1., bit_depth) - 1;
+    const double gain = 1. / epercount;
+    const std::array<uint32_t, 2> key = {static_cast<uint32_t>(sensor.seed), static_cast<uint32_t>(sensor.seed >> 32)};
+
+    for (size_t i0 = 0; i0 < n; i0 += block)
+    {
+        const size_t m = std::min(block, n - i0);
+        double mean[block] = {};
+        double electrons[block];
+        for (size_t j = 0; j < m; j++) {
+            mean[j] = quantum_efficiency * std::max(static_cast<double>(photons[i0 + j]), 0.);
+        }
+
+        if (sensor.noise)
+        {
+            uint32_t r[4][block];
+            for (size_t j = 0; j < block; j++)
+            {
+                const uint64_t pixel = pixel0 + i0 + j;
+                r[0][j] = static_cast<uint32_t>(pixel);
+                r[1][j] = static_cast<uint32_t>(pixel >> 32);
+                r[2][j] = static_cast<uint32_t>(sensor.frame);
+                r[3][j] = static_cast<uint32_t>(sensor.frame >> 32);
+            }
+            cispp::Philox4x32(r, key);
+
+            // Box-Muller: a pair of independent standard normals per pixel, for shot and read noise
+            double z_read[block];
+            for (size_t j = 0; j < block; j++)
+            {
+                const double radius = std::sqrt(-2 * std::log(cispp::ToUniform(r[0][j])));
+                const double angle = 2 * M_PI * cispp::ToUniform(r[1][j]);
+                z_read[j] = cam_noise * radius * std::sin(angle);
+                electrons[j] = mean[j] + std::sqrt(mean[j]) * radius * std::cos(angle) + z_read[j];
+            }
+
+            // low signal: Poisson by inversion of the cumulative distribution
+            for (size_t j = 0; j < m; j++)
+            {
+                if (mean[j] >= poisson_max) {
+                    continue;
+                }
+                const double u = cispp::ToUniform(r[2][j]);
+                double p = std::exp(-mean[j]);
+                double cdf = p;
+                int k = 0;
+                while (u > cdf && k < 4 * poisson_max)
+                {
+                    k++;
+                    p *= mean[j] / k;
+                    cdf += p;
+                }
+                electrons[j] = k + z_read[j];
+            }
+        }
+        else 
+        {
+            std::copy(mean, mean + block, electrons);
+        }
+
+        for (size_t j = 0; j < m; j++) {
+            counts[i0 + j] = static_cast<unsigned short int>(std::clamp(std::floor(electrons[j] * gain + 0.5), 0., max_count));
+        }
+    }
+}
+
+
+template void cispp::Camera::Digitise<float>(const float* photons, size_t n, uint64_t pixel0, 
+                                             const SensorOptions& sensor, unsigned short int* counts) const;
+template void cispp::Camera::Digitise<double>(const double* photons, size_t n, uint64_t pixel0, 
+                                              const SensorOptions& sensor, unsigned short int* counts) const;
+
+
 } // namespace cispp
\ No newline at end of file
@@ -1,25 +1,148 @@
 #include "include/coherence.h"
+
+#include <algorithm>
+#include <cassert>
+
 #include "include/maths.h"
 
 
 namespace cispp {
 
 
-std::complex<double> calculate_coherence(std::vector<double> wavelength, std::vector<double> spec_flux, double delay, double wld)
+std::complex<double> calculate_coherence(const std::vector<double>& wavelength, const std::vector<double>& spec_flux, 
+                                         double delay, double wld)
 {
     assert (wavelength.size() == spec_flux.size());
 
-    std::vector<std::complex<double>> integrand(wavelength.size(),0);
-    std::vector<std::complex<double>> wlc(wavelength.size(),0);  // complex wavelength
-
+    // trapezoidal rule, in the same order as cispp::trapz
+    std::complex<double> out = 0;
+    std::complex<double> integrand_prev = 0;
     for (size_t i=0; i < wavelength.size(); i++) 
     {
         std::complex<double> exponent(0., delay + delay * (wld - wavelength[i]) / wavelength[i]);
-        std::complex<double> wlc_i(wavelength[i]); 
-        integrand[i] = spec_flux[i] * std::exp(exponent);
-        wlc[i] = wlc_i;
+        std::complex<double> integrand = spec_flux[i] * std::exp(exponent);
+        if (i > 0) {
+            out += 0.5 * (integrand_prev + integrand) * (wavelength[i] - wavelength[i-1]);
+        }
+        integrand_prev = integrand;
+    }
+    return out;
+}
+
+
+CoherenceEvaluator::CoherenceEvaluator(const std::vector<double>& wavelength, const std::vector<double>& spec_flux, 
+                                       double wld)
+: k(wavelength.size()),
+  weight(wavelength.size(), 0.),
+  re(wavelength.size()),
+  im(wavelength.size()),
+  step_re(wavelength.size()),
+  step_im(wavelength.size())
+{
+    assert (wavelength.size() == spec_flux.size());
+
+    const size_t n = wavelength.size();
+    for (size_t i = 0; i < n; i++)
+    {
+        k[i] = wld / wavelength[i];
+        if (i > 0) {
+            weight[i] += 0.5 * spec_flux[i] * (wavelength[i] - wavelength[i-1]);
+        }
+        if (i + 1 < n) {
+            weight[i] += 0.5 * spec_flux[i] * (wavelength[i+1] - wavelength[i]);
+        }
+    }
+}
+
+
+void CoherenceEvaluator::Evaluate(const double* delay, size_t n, std::complex<double>* coherence) const
+{
+    const size_t nwl = k.size();
+    for (size_t j = 0; j < n; j++)
+    {
+        double sum_re = 0;
+        double sum_im = 0;
+        for (size_t i = 0; i < nwl; i++)
+        {
+            const double phase = delay[j] * k[i];
+            sum_re += weight[i] * cos(phase);
+            sum_im += weight[i] * sin(phase);
+        }
+        coherence[j] = std::complex<double>(sum_re, sum_im);
+    }
+}
+
+
+std::complex<double> CoherenceEvaluator::SetPhasors(double delay)
+{
+    const size_t nwl = k.size();
+    double sum_re = 0;
+    double sum_im = 0;
+    for (size_t i = 0; i < nwl; i++)
+    {
+        const double phase = delay * k[i];
+        re[i] = weight[i] * cos(phase);
+        im[i] = weight[i] * sin(phase);
+        sum_re += re[i];
+        sum_im += im[i];
+    }
+    return std::complex<double>(sum_re, sum_im);
+}
+
+
+void CoherenceEvaluator::EvaluateUniform(double delay0, double ddelay, size_t n, std::complex<double>* coherence)
+{
+    const size_t nwl = k.size();
+    double* re_p = re.data();
+    double* im_p = im.data();
+    const double* step_re_p = step_re.data();
+    const double* step_im_p = step_im.data();
+    for (size_t i = 0; i < nwl; i++)
+    {
+        step_re[i] = cos(ddelay * k[i]);
+        step_im[i] = sin(ddelay * k[i]);
+    }
+
+    const size_t interval = std::max<size_t>(resync_interval, 1);
+    for (size_t j = 0; j < n; j++)
+    {
+        if (j % interval == 0)
+        {
+            coherence[j] = SetPhasors(delay0 + j * ddelay);
+            continue;
+        }
+        
+        // complex multiply by the step phasor, on separate real and imaginary arrays and with a partial sum per
+        // vector lane, so that the loop vectorises without reassociating the sums
+        constexpr size_t nlanes = 4;
+        double sum_re_l[nlanes] = {0., 0., 0., 0.};
+        double sum_im_l[nlanes] = {0., 0., 0., 0.};
+        size_t i = 0;
+        for (; i + nlanes <= nwl; i += nlanes)
+        {
+            for (size_t l = 0; l < nlanes; l++)
+            {
+                const double r = re_p[i + l] * step_re_p[i + l] - im_p[i + l] * step_im_p[i + l];
+                const double m = re_p[i + l] * step_im_p[i + l] + im_p[i + l] * step_re_p[i + l];
+                re_p[i + l] = r;
+                im_p[i + l] = m;
+                sum_re_l[l] += r;
+                sum_im_l[l] += m;
+            }
+        }
+        for (; i < nwl; i++)
+        {
+            const double r = re_p[i] * step_re_p[i] - im_p[i] * step_im_p[i];
+            const double m = re_p[i] * step_im_p[i] + im_p[i] * step_re_p[i];
+            re_p[i] = r;
+            im_p[i] = m;
+            sum_re_l[0] += r;
+            sum_im_l[0] += m;
+        }
+        const double sum_re = (sum_re_l[0] + sum_re_l[1]) + (sum_re_l[2] + sum_re_l[3]);
+        const double sum_im = (sum_im_l[0] + sum_im_l[1]) + (sum_im_l[2] + sum_im_l[3]);
+        coherence[j] = std::complex<double>(sum_re, sum_im);
     }
-    return cispp::trapz(wlc, integrand);
 }
 
 
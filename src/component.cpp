@@ -1,5 +1,6 @@
 #include "include/component.h"
 
+#include <algorithm>
 #include <string>
 #include <iostream>
 #include <cmath>
@@ -13,20 +14,11 @@ namespace cispp {
 
 Eigen::Matrix4d GetRotationMatrix(double angle)
 {
-    const double s = sin(2 * angle);
-    const double c = cos(2 * angle);
-
-    Eigen::Matrix4d m;
-    m << 1,  0,  0,  0, 
-         0,  c,  s,  0,
-         0, -s,  c,  0,
-         0,  0,  0,  1;
-
-    return m;
+    return MuellerRotator::FromAngle(angle).Matrix();
 }
 
 
-Eigen::Matrix4d Component::GetMuellerMatrix(double wavelength, double incidence_angle, double azimuthal_angle)
+MuellerDiattenuator Component::GetMuellerOperator(double wavelength, double incidence_angle, double azimuthal_angle)
 {
     const double delay = GetDelay(wavelength, incidence_angle, azimuthal_angle);
     const double t1 = GetT1(wavelength, incidence_angle, azimuthal_angle);
@@ -35,28 +27,26 @@ Eigen::Matrix4d Component::GetMuellerMatrix(double wavelength, double incidence_
     const double diff = (t1 - t2) / 2;
     const double sind = 2 * sqrt(t1 * t2) * sin(delay);
     const double cosd = 2 * sqrt(t1 * t2) * cos(delay);
+    return MuellerDiattenuator(sum, diff, cosd, sind);
+}
 
-    Eigen::Matrix4d m;
-    m <<   sum,  diff,     0,     0, 
-          diff,   sum,     0,     0,
-             0,     0,  cosd,  sind,
-             0,     0, -sind,  cosd;
 
-    Eigen::Matrix4d rot = GetRotationMatrix(orientation);
-    return rot.transpose() * m * rot;
+Eigen::Matrix4d Component::GetMuellerMatrix(double wavelength, double incidence_angle, double azimuthal_angle)
+{
+    return Rotate(GetMuellerOperator(wavelength, incidence_angle, azimuthal_angle), orientation).Matrix();
 }
 
 
-Eigen::Matrix4d Polariser::GetMuellerMatrix()
+void Component::ApplyMuellerRow(double wavelength, double incidence_angle, double azimuthal_angle, 
+                                Eigen::RowVector4d& row)
 {
-    Eigen::Matrix4d m;
-    m << 0.5, 0.5,   0,   0, 
-         0.5, 0.5,   0,   0,
-           0,   0,   0,   0,
-           0,   0,   0,   0;
+    Rotate(GetMuellerOperator(wavelength, incidence_angle, azimuthal_angle), orientation).ApplyRow(row);
+}
+
 
-    Eigen::Matrix4d rot = GetRotationMatrix(orientation);
-    return rot.transpose() * m * rot;
+Eigen::Matrix4d Polariser::GetMuellerMatrix()
+{
+    return Rotate(MuellerPolariser(), orientation).Matrix();
 }
 
 
@@ -65,55 +55,283 @@ Eigen::Matrix4d Polariser::GetMuellerMatrix(double wavelength, double incidence_
 }
 
 
+void Polariser::ApplyMuellerRow(double wavelength, double incidence_angle, double azimuthal_angle, 
+                                Eigen::RowVector4d& row)
+{
+    Rotate(MuellerPolariser(), orientation).ApplyRow(row);
+}
+
+
 Eigen::Matrix4d Retarder::GetMuellerMatrix(double wavelength, double incidence_angle, double azimuthal_angle)
 {
-    double delay = GetDelay(wavelength, incidence_angle, azimuthal_angle);
-    double s = sin(delay);
-    double c = cos(delay);
-    Eigen::Matrix4d m;
+    MuellerRetarder m = MuellerRetarder::FromDelay(GetDelay(wavelength, incidence_angle, azimuthal_angle));
+    return Rotate(m, orientation).Matrix();
+}
 
-    m <<   1,  0,  0,  0, 
-           0,  1,  0,  0,
-           0,  0,  c,  s,
-           0,  0, -s,  c;
 
-    Eigen::Matrix4d rot = GetRotationMatrix(orientation);
-    return rot.transpose() * m * rot;
+void Retarder::ApplyMuellerRow(double wavelength, double incidence_angle, double azimuthal_angle, 
+                               Eigen::RowVector4d& row)
+{
+    MuellerRetarder m = MuellerRetarder::FromDelay(GetDelay(wavelength, incidence_angle, azimuthal_angle));
+    Rotate(m, orientation).ApplyRow(row);
 }
 
 
-double UniaxialCrystal::GetDelay(double wavelength, double incidence_angle, double azimuthal_angle)
+void Component::GetDelayBatch(double wavelength, const double* incidence_angle, const double* azimuthal_angle, 
+                              double* delay, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        delay[i] = GetDelay(wavelength, incidence_angle[i], azimuthal_angle[i]);
+    }
+}
+
+
+void Component::GetDelayBatch(const double* wavelength, double incidence_angle, double azimuthal_angle, 
+                              double* delay, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        delay[i] = GetDelay(wavelength[i], incidence_angle, azimuthal_angle);
+    }
+}
+
+
+void Component::GetDelayBatch(double wavelength, const RayBatch& rays, double* delay)
+{
+    GetDelayBatch(wavelength, rays.incidence_angle, rays.azimuthal_angle, delay, rays.n);
+}
+
+
+/**
+ * @brief Delay table that calls back into the component at each wavelength
+ */
+class ComponentDelayTable: public DelayTable
+{
+    public:
+
+    Component* component;
+
+    ComponentDelayTable(const std::vector<double>& wavelength, Component* component)
+    : DelayTable(wavelength),
+      component(component)
+    {}
+
+    void GetDelayBatch(size_t iwl, const RayBatch& rays, double* delay) const override {
+        component->GetDelayBatch(wavelength[iwl], rays, delay);
+    }
+
+    double GetDelayOnAxis(size_t iwl) const override {
+        return component->GetDelay(wavelength[iwl], 0, 0);
+    }
+
+    void GetDelayDeviationBatch(size_t iwl, const RayBatchF& rays, float* ddelay) const override 
+    {
+        const double delay_0 = GetDelayOnAxis(iwl);
+        for (size_t i = 0; i < rays.n; i++) {
+            ddelay[i] = static_cast<float>(
+                component->GetDelay(wavelength[iwl], rays.incidence_angle[i], rays.azimuthal_angle[i]) - delay_0
+            );
+        }
+    }
+};
+
+
+/**
+ * @brief Delay table holding the UniaxialCrystal delay coefficients (refractive indices and derived terms) at 
+ * each wavelength
+ */
+class UniaxialCrystalDelayTable: public DelayTable
+{
+    public:
+
+    std::vector<UniaxialCrystal::DelayCoefficients> coefs;
+    std::vector<UniaxialCrystal::DelayDeviationCoefficients> coefs_f;
+
+    UniaxialCrystalDelayTable(const std::vector<double>& wavelength, UniaxialCrystal& crystal)
+    : DelayTable(wavelength)
+    {
+        for (double wl : wavelength) 
+        {
+            coefs.push_back(crystal.GetDelayCoefficients(wl));
+            coefs_f.push_back(UniaxialCrystal::GetDelayDeviationCoefficients(coefs.back()));
+        }
+    }
+
+    void GetDelayBatch(size_t iwl, const RayBatch& rays, double* delay) const override {
+        UniaxialCrystal::GetDelayBatch(coefs[iwl], rays.sin_inc, rays.sin_azim, rays.cos_azim, delay, rays.n);
+    }
+
+    double GetDelayOnAxis(size_t iwl) const override {
+        return UniaxialCrystal::GetDelay(coefs[iwl], 0, 0, 1);
+    }
+
+    void GetDelayDeviationBatch(size_t iwl, const RayBatchF& rays, float* ddelay) const override {
+        UniaxialCrystal::GetDelayDeviationBatch(coefs_f[iwl], rays.sin_inc, rays.sin_azim, rays.cos_azim, ddelay, rays.n);
+    }
+};
+
+
+std::unique_ptr<DelayTable> Component::GetDelayTable(const std::vector<double>& wavelength)
+{
+    return std::make_unique<ComponentDelayTable>(wavelength, this);
+}
+
+
+std::unique_ptr<DelayTable> UniaxialCrystal::GetDelayTable(const std::vector<double>& wavelength)
+{
+    return std::make_unique<UniaxialCrystalDelayTable>(wavelength, *this);
+}
+
+
+UniaxialCrystal::DelayCoefficients UniaxialCrystal::GetDelayCoefficients(double wavelength)
+{
+    std::pair<double, double> neno = std::visit([wavelength](const auto& model) { return model(wavelength); }, dispersion);
+    return GetDelayCoefficients(wavelength, neno.first, neno.second);
+}
+
+
+const ChebyshevBand& UniaxialCrystal::SetDispersionBand(double wl_min, double wl_max, double tol)
+{
+    dispersion = MakeChebyshevDispersion(MakeDispersionModel(material), wl_min, wl_max, tol);
+    return *GetChebyshevBand(dispersion);
+}
+
+
+void UniaxialCrystal::ClearDispersionBand()
+{
+    dispersion = MakeDispersionModel(material);
+}
+
+
+double UniaxialCrystal::GetKappa(double wavelength) const
+{
+    return cispp::GetKappa(wavelength, dispersion);
+}
+
+
+UniaxialCrystal::DelayCoefficients UniaxialCrystal::GetDelayCoefficients(double wavelength, double ne, double no)
 {
-    std::pair<double, double> neno = GetRefractiveIndices(wavelength, material);
-    const double ne = neno.first; 
-    const double no = neno.second;
-    const double s_inc = sin(incidence_angle);
     const double s_cut = sin(cut_angle);
     const double c_cut = cos(cut_angle);
-    const double s_azim = sin(azimuthal_angle);
-    const double c_azim = cos(azimuthal_angle);
-    const double s_inc2 = pow(s_inc, 2);
     const double s_cut2 = pow(s_cut, 2);
     const double c_cut2 = pow(c_cut, 2);
     const double no2 = pow(no, 2);
     const double ne2 = pow(ne, 2);
     const double p = ne2 * s_cut2 + no2 * c_cut2;
 
-    const double term_1 = sqrt(no2 - s_inc2);
-    const double term_2 = (no2 - ne2) * (s_cut * c_cut * c_azim * s_inc) / p;
-    const double term_3 = - no * sqrt((ne2 * p) - ((ne2 - (ne2 - no2) * c_cut2 * pow(s_azim,2)) * s_inc2)) / p;
+    DelayCoefficients coefs;
+    coefs.factor = 2 * M_PI * (thickness / wavelength);
+    coefs.no = no;
+    coefs.no2 = no2;
+    coefs.ne2 = ne2;
+    coefs.p = p;
+    coefs.ne2p = ne2 * p;
+    coefs.no2_ne2 = no2 - ne2;
+    coefs.ne2_no2_c_cut2 = (ne2 - no2) * c_cut2;
+    coefs.s_c_cut = s_cut * c_cut;
+    return coefs;
+}
+
+
+UniaxialCrystal::DelayDeviationCoefficients UniaxialCrystal::GetDelayDeviationCoefficients(const DelayCoefficients& coefs)
+{
+    DelayDeviationCoefficients coefs_f;
+    coefs_f.factor = static_cast<float>(coefs.factor);
+    coefs_f.no = static_cast<float>(coefs.no);
+    coefs_f.no2 = static_cast<float>(coefs.no2);
+    coefs_f.ne2 = static_cast<float>(coefs.ne2);
+    coefs_f.ne2p = static_cast<float>(coefs.ne2p);
+    coefs_f.sqrt_ne2p = static_cast<float>(sqrt(coefs.ne2p));
+    coefs_f.ne2_no2_c_cut2 = static_cast<float>(coefs.ne2_no2_c_cut2);
+    coefs_f.no2_ne2_s_c_cut_p = static_cast<float>(coefs.no2_ne2 * coefs.s_c_cut / coefs.p);
+    coefs_f.no_p = static_cast<float>(coefs.no / coefs.p);
+    return coefs_f;
+}
+
+
+double UniaxialCrystal::GetDelay(double wavelength, double incidence_angle, double azimuthal_angle)
+{
+    return GetDelay(GetDelayCoefficients(wavelength), sin(incidence_angle), sin(azimuthal_angle), cos(azimuthal_angle));
+}
+
+
+void UniaxialCrystal::GetDelayBatch(const DelayCoefficients& coefs, const double* __restrict s_inc, const double* __restrict s_azim, 
+                                    const double* __restrict c_azim, double* __restrict delay, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        delay[i] = GetDelay(coefs, s_inc[i], s_azim[i], c_azim[i]);
+    }
+}
+
+void UniaxialCrystal::GetDelayDeviationBatch(const DelayDeviationCoefficients& coefs, const float* __restrict s_inc, 
+                                             const float* __restrict s_azim, const float* __restrict c_azim, 
+                                             float* __restrict ddelay, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        ddelay[i] = GetDelayDeviation(coefs, s_inc[i], s_azim[i], c_azim[i]);
+    }
+}
+
+
+void UniaxialCrystal::GetDelayBatch(double wavelength, const double* incidence_angle, const double* azimuthal_angle, 
+                                    double* delay, size_t n)
+{
+    const DelayCoefficients coefs = GetDelayCoefficients(wavelength);
+
+    // trig is done in blocks on the stack, so that the delay kernel runs over contiguous arrays without allocating
+    constexpr size_t nblock = 256;
+    double s_inc[nblock];
+    double s_azim[nblock];
+    double c_azim[nblock];
+
+    for (size_t i0 = 0; i0 < n; i0 += nblock)
+    {
+        const size_t m = std::min(nblock, n - i0);
+        for (size_t i = 0; i < m; i++)
+        {
+            s_inc[i] = sin(incidence_angle[i0 + i]);
+            s_azim[i] = sin(azimuthal_angle[i0 + i]);
+            c_azim[i] = cos(azimuthal_angle[i0 + i]);
+        }
+        GetDelayBatch(coefs, s_inc, s_azim, c_azim, delay + i0, m);
+    }
+}
+
+
+void UniaxialCrystal::GetDelayBatch(double wavelength, const RayBatch& rays, double* delay)
+{
+    GetDelayBatch(GetDelayCoefficients(wavelength), rays.sin_inc, rays.sin_azim, rays.cos_azim, delay, rays.n);
+}
+
+
+void UniaxialCrystal::GetDelayBatch(const double* wavelength, double incidence_angle, double azimuthal_angle, 
+                                    double* delay, size_t n)
+{
+    const double s_inc = sin(incidence_angle);
+    const double s_azim = sin(azimuthal_angle);
+    const double c_azim = cos(azimuthal_angle);
 
-    return 2 * M_PI * (thickness / wavelength) * (term_1 + term_2 + term_3);
+    // refractive indices in blocks on the stack, with the dispersion model dispatched once per block
+    constexpr size_t nblock = 256;
+    double ne[nblock];
+    double no[nblock];
+    for (size_t i0 = 0; i0 < n; i0 += nblock)
+    {
+        const size_t m = std::min(nblock, n - i0);
+        std::visit([&](const auto& model) { model(wavelength + i0, ne, no, m); }, dispersion);
+        for (size_t i = 0; i < m; i++) {
+            delay[i0 + i] = GetDelay(GetDelayCoefficients(wavelength[i0 + i], ne[i], no[i]), s_inc, s_azim, c_azim);
+        }
+    }
 }
 
 
-bool TestAlign90(std::unique_ptr<Component>& c1,  std::unique_ptr<Component>& c2)
+bool TestAlign90(const std::unique_ptr<Component>& c1, const std::unique_ptr<Component>& c2)
 {
     return std::abs(fmod(c1->orientation - c2->orientation, M_PI / 2)) == 0.;
 }
 
 
-bool TestAlign45(std::unique_ptr<Component>& c1,  std::unique_ptr<Component>& c2)
+bool TestAlign45(const std::unique_ptr<Component>& c1, const std::unique_ptr<Component>& c2)
 {
     return std::abs(fmod(c1->orientation - c2->orientation, M_PI / 2)) == M_PI / 4;
 }
@@ -0,0 +1,477 @@
+#include "include/demodulate.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <stdexcept>
+
+
+namespace cispp {
+
+
+namespace {
+
+
+/**
+ * @brief atan2 by octant reduction and a minimax polynomial for atan on [0, 1] (Abramowitz & Stegun 4.4.49, error 
+ * < 2e-8 rad), written without branches so that loops over it vectorise
+ */
+inline double FastAtan2(double y, double x)
+{
+    const double ax = std::abs(x);
+    const double ay = std::abs(y);
+    const double mx = std::max(ax, ay);
+    const double mn = std::min(ax, ay);
+    const double t = mn / (mx > 0 ? mx : 1.);
+    const double z = t * t;
+    const double p = t * (1. + z * (-0.3333314528 + z * (0.1999355085 + z * (-0.1420889944 + z * (0.1065626393 + 
+                     z * (-0.0752896400 + z * (0.0429096138 + z * (-0.0161657367 + z * 0.0028662257))))))));
+    const double p_octant = M_PI_2 - p;
+    const double r = (ay > ax) ? p_octant : p;
+    const double r_quadrant = M_PI - r;
+    const double r_half = (x < 0) ? r_quadrant : r;
+    const double r_neg = -r_half;
+    return (y < 0) ? r_neg : r_half;
+}
+
+
+/**
+ * @brief Phase and contrast from quadratures C, S and mean A, for n super-pixels
+ */
+void GetPhaseContrast(const double* c, const double* s, const double* mean, size_t n, double* phase, double* contrast)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        phase[i] = FastAtan2(s[i], c[i]);
+        const double amplitude = std::sqrt(c[i] * c[i] + s[i] * s[i]);
+        const double contrast_i = amplitude / (2 * std::max(mean[i], 1e-300));
+        contrast[i] = (mean[i] > 0) ? contrast_i : 0.;
+    }
+}
+
+
+#ifdef CISPP_HAVE_FFTW
+
+
+// the FFTW planner and its global settings (thread count, wisdom) are not thread-safe
+std::mutex mtx_planner;
+std::once_flag init_threads;
+
+
+unsigned GetPlannerFlags(FFTWEffort effort)
+{
+    switch (effort)
+    {
+        case FFTWEffort::Estimate:
+            return FFTW_ESTIMATE;
+        case FFTWEffort::Patient:
+            return FFTW_PATIENT;
+        default:
+            return FFTW_MEASURE;
+    }
+}
+
+
+/**
+ * @brief Signed frequency index of FFT bin i of n, in [-n/2, n/2)
+ */
+inline long GetSignedIndex(size_t i, size_t n)
+{
+    return (i < (n + 1) / 2) ? static_cast<long>(i) : static_cast<long>(i) - static_cast<long>(n);
+}
+
+
+inline std::complex<double>* AsComplex(fftw_complex* x)
+{
+    return reinterpret_cast<std::complex<double>*>(x);
+}
+
+
+#endif  // CISPP_HAVE_FFTW
+
+
+} // namespace
+
+
+PixelatedDemodulator::PixelatedDemodulator(size_t nx, size_t ny, const PixelatedDemodOptions& opts)
+: nx(nx),
+  ny(ny),
+  nsx(nx / 2),
+  nsy(ny / 2),
+  opts(opts),
+  pool(std::make_unique<cispp::ThreadPool>(opts.nthreads))
+{
+    if (nx < 2 || ny < 2) {
+        throw std::invalid_argument("PixelatedDemodulator: frames must be at least 2 x 2 pixels.");
+    }
+    this->opts.rows_per_task = std::max<size_t>(opts.rows_per_task, 1);
+
+    // super-pixel row j is centred between pixel rows 2j and 2j + 1
+    interp_y0.resize(ny);
+    interp_y1.resize(ny);
+    interp_wy.resize(ny);
+    for (size_t iy = 0; iy < ny; iy++)
+    {
+        const double u = (iy - 0.5) / 2;
+        const double j = std::floor(u);
+        if (j < 0 || j >= nsy - 1)
+        {
+            interp_y0[iy] = interp_y1[iy] = (j < 0) ? 0 : nsy - 1;
+            interp_wy[iy] = 0;
+        }
+        else
+        {
+            interp_y0[iy] = static_cast<size_t>(j);
+            interp_y1[iy] = static_cast<size_t>(j) + 1;
+            interp_wy[iy] = u - j;
+        }
+    }
+}
+
+
+void PixelatedDemodulator::UpsampleRow(const double* v, double* row) const
+{
+    // pixel 2j + 1 is a quarter of the way from super-pixel j to j + 1, and pixel 2j + 2 three quarters
+    row[0] = v[0];
+    for (size_t jx = 0; jx + 1 < nsx; jx++)
+    {
+        row[2 * jx + 1] = 0.75 * v[jx] + 0.25 * v[jx + 1];
+        row[2 * jx + 2] = 0.25 * v[jx] + 0.75 * v[jx + 1];
+    }
+    std::fill(row + 2 * nsx - 1, row + nx, v[nsx - 1]);
+}
+
+
+void PixelatedDemodulator::GetQuadratures(const unsigned short int* frame, size_t jy0, size_t jy1, double* c, 
+                                          double* s, double* mean) const
+{
+    for (size_t jy = jy0; jy < jy1; jy++)
+    {
+        const unsigned short int* row0 = frame + 2 * jy * nx;  // phase steps 0, pi/2
+        const unsigned short int* row1 = row0 + nx;             // phase steps 3 pi/2, pi
+        double* c_row = c + (jy - jy0) * nsx;
+        double* s_row = s + (jy - jy0) * nsx;
+        double* mean_row = mean + (jy - jy0) * nsx;
+        for (size_t jx = 0; jx < nsx; jx++)
+        {
+            const double i_0 = row0[2 * jx];
+            const double i_pi_2 = row0[2 * jx + 1];
+            const double i_3pi_2 = row1[2 * jx];
+            const double i_pi = row1[2 * jx + 1];
+            c_row[jx] = i_0 - i_pi;
+            s_row[jx] = i_3pi_2 - i_pi_2;
+            mean_row[jx] = 0.25 * (i_0 + i_pi_2 + i_3pi_2 + i_pi);
+        }
+    }
+}
+
+
+void PixelatedDemodulator::Demodulate(const unsigned short int* image, DemodResult* result)
+{
+    std::vector<DemodResult> results;
+    Demodulate(image, 1, &results);
+    *result = std::move(results[0]);
+}
+
+
+void PixelatedDemodulator::Demodulate(const unsigned short int* frames, size_t nframes, std::vector<DemodResult>* results)
+{
+    const size_t nox = GetOutputWidth();
+    const size_t noy = GetOutputHeight();
+    results->resize(nframes);
+    for (DemodResult& result : *results)
+    {
+        result.dc.resize(nox * noy);
+        result.phase.resize(nox * noy);
+        result.contrast.resize(nox * noy);
+    }
+
+    // tasks are blocks of output rows. Upsampled blocks need up to one extra super-pixel row at each end.
+    const size_t rows_per_block = opts.upsample ? 2 * opts.rows_per_task : opts.rows_per_task;
+    const size_t nblocks = (noy + rows_per_block - 1) / rows_per_block;
+    const size_t nsrows_max = opts.rows_per_task + 2;
+
+    // per-worker scratch
+    const size_t nworkers = pool->GetThreadCount();
+    std::vector<std::vector<double>> quad(nworkers, std::vector<double>(3 * nsrows_max * nsx));
+    std::vector<std::vector<double>> rows(nworkers, std::vector<double>(opts.upsample ? 3 * nsx + 2 * nx : 0));
+
+    pool->ParallelFor(nframes * nblocks, [&](size_t itask, size_t iworker)
+    {
+        const size_t iframe = itask / nblocks;
+        const size_t iy0 = (itask % nblocks) * rows_per_block;
+        const size_t iy1 = std::min(iy0 + rows_per_block, noy);
+        const unsigned short int* frame = frames + iframe * nx * ny;
+        DemodResult& result = (*results)[iframe];
+
+        // quadratures of the super-pixel rows this block needs
+        const size_t jy0 = opts.upsample ? interp_y0[iy0] : iy0;
+        const size_t jy1 = opts.upsample ? interp_y1[iy1 - 1] + 1 : iy1;
+        double* c = quad[iworker].data();
+        double* s = c + nsrows_max * nsx;
+        double* mean = s + nsrows_max * nsx;
+        GetQuadratures(frame, jy0, jy1, c, s, mean);
+
+        if (!opts.upsample)
+        {
+            const size_t n = (iy1 - iy0) * nsx;
+            std::copy(mean, mean + n, &result.dc[iy0 * nsx]);
+            GetPhaseContrast(c, s, mean, n, &result.phase[iy0 * nsx], &result.contrast[iy0 * nsx]);
+            return;
+        }
+
+        // interpolate C, S and the mean to pixel centres, first along y (per super-pixel) then along x
+        double* c_v = rows[iworker].data();
+        double* s_v = c_v + nsx;
+        double* mean_v = s_v + nsx;
+        double* c_h = mean_v + nsx;
+        double* s_h = c_h + nx;
+        for (size_t iy = iy0; iy < iy1; iy++)
+        {
+            const size_t k0 = (interp_y0[iy] - jy0) * nsx;
+            const size_t k1 = (interp_y1[iy] - jy0) * nsx;
+            const double wy = interp_wy[iy];
+            for (size_t jx = 0; jx < nsx; jx++)
+            {
+                c_v[jx] = (1 - wy) * c[k0 + jx] + wy * c[k1 + jx];
+                s_v[jx] = (1 - wy) * s[k0 + jx] + wy * s[k1 + jx];
+                mean_v[jx] = (1 - wy) * mean[k0 + jx] + wy * mean[k1 + jx];
+            }
+            double* dc_row = &result.dc[iy * nx];
+            UpsampleRow(c_v, c_h);
+            UpsampleRow(s_v, s_h);
+            UpsampleRow(mean_v, dc_row);
+            GetPhaseContrast(c_h, s_h, dc_row, nx, &result.phase[iy * nx], &result.contrast[iy * nx]);
+        }
+    });
+}
+
+
+#ifdef CISPP_HAVE_FFTW
+
+
+LinearDemodulator::LinearDemodulator(size_t nx, size_t ny, const DemodOptions& opts)
+: nx(nx),
+  ny(ny),
+  nxh(nx / 2 + 1),
+  opts(opts)
+{
+    if (nx < 2 || ny < 2) {
+        throw std::invalid_argument("LinearDemodulator: frames must be at least 2 x 2 pixels.");
+    }
+    real_in = static_cast<double*>(fftw_malloc(sizeof(double) * nx * ny));
+    spec = static_cast<fftw_complex*>(fftw_malloc(sizeof(fftw_complex) * ny * nxh));
+    spec_dc = static_cast<fftw_complex*>(fftw_malloc(sizeof(fftw_complex) * ny * nxh));
+    real_dc = static_cast<double*>(fftw_malloc(sizeof(double) * nx * ny));
+    spec_sb = static_cast<fftw_complex*>(fftw_malloc(sizeof(fftw_complex) * nx * ny));
+    analytic = static_cast<fftw_complex*>(fftw_malloc(sizeof(fftw_complex) * nx * ny));
+
+    {
+        std::lock_guard<std::mutex> lock(mtx_planner);
+        std::call_once(init_threads, [] { fftw_init_threads(); });
+        fftw_plan_with_nthreads(std::max(opts.nthreads, 1));
+        if (!opts.wisdom_file.empty() && std::filesystem::exists(opts.wisdom_file)) {
+            fftw_import_wisdom_from_filename(opts.wisdom_file.c_str());
+        }
+        const unsigned flags = GetPlannerFlags(opts.effort);
+        const int n0 = static_cast<int>(ny);
+        const int n1 = static_cast<int>(nx);
+        plan_forward = fftw_plan_dft_r2c_2d(n0, n1, real_in, spec, flags);
+        plan_dc = fftw_plan_dft_c2r_2d(n0, n1, spec_dc, real_dc, flags);
+        plan_sb = fftw_plan_dft_2d(n0, n1, spec_sb, analytic, FFTW_BACKWARD, flags);
+        if (!opts.wisdom_file.empty()) {
+            fftw_export_wisdom_to_filename(opts.wisdom_file.c_str());
+        }
+    }
+    if (plan_forward == nullptr || plan_dc == nullptr || plan_sb == nullptr) {
+        throw std::runtime_error("LinearDemodulator: FFTW planning failed.");
+    }
+    // planning may have written to the buffers, and the sideband spectrum must be zero away from the window
+    std::memset(spec_sb, 0, sizeof(fftw_complex) * nx * ny);
+}
+
+
+LinearDemodulator::~LinearDemodulator()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx_planner);
+        for (fftw_plan plan : {plan_forward, plan_dc, plan_sb})
+        {
+            if (plan != nullptr) {
+                fftw_destroy_plan(plan);
+            }
+        }
+    }
+    fftw_free(real_in);
+    fftw_free(spec);
+    fftw_free(spec_dc);
+    fftw_free(real_dc);
+    fftw_free(spec_sb);
+    fftw_free(analytic);
+}
+
+
+void LinearDemodulator::SetCarrier(double fx, double fy)
+{
+    if (fx == 0 && fy == 0) {
+        throw std::invalid_argument("LinearDemodulator: carrier frequency must be non-zero.");
+    }
+    this->fx = fx;
+    this->fy = fy;
+    carrier_set = true;
+
+    const double radius = opts.window_radius * std::hypot(fx, fy);
+    for (const Tap& tap : taps_sb)
+    {
+        spec_sb[tap.ifull][0] = 0;
+        spec_sb[tap.ifull][1] = 0;
+    }
+    taps_dc = GetTaps(0, 0, radius, true);
+    taps_sb = GetTaps(fx, fy, radius, false);
+}
+
+
+std::vector<LinearDemodulator::Tap> LinearDemodulator::GetTaps(double fx0, double fy0, double radius, bool half) const
+{
+    // Hann window, with the 1 / (nx * ny) normalisation of the inverse transforms folded in
+    const double norm = 1. / (nx * ny);
+    const size_t nxt = half ? nxh : nx;
+    std::vector<Tap> taps;
+    for (size_t iy = 0; iy < ny; iy++)
+    {
+        const long ky = GetSignedIndex(iy, ny);
+        for (size_t ix = 0; ix < nxt; ix++)
+        {
+            const long kx = half ? static_cast<long>(ix) : GetSignedIndex(ix, nx);
+            const double d = std::hypot(static_cast<double>(kx) / nx - fx0, static_cast<double>(ky) / ny - fy0);
+            if (d >= radius) {
+                continue;
+            }
+            Tap tap;
+            tap.ifull = iy * nxt + ix;
+            tap.weight = norm * 0.5 * (1 + std::cos(M_PI * d / radius));
+            if (ix < nxh)
+            {
+                tap.ihalf = iy * nxh + ix;
+                tap.conjugate = false;
+            }
+            else
+            {
+                tap.ihalf = ((ny - iy) % ny) * nxh + (nx - ix);
+                tap.conjugate = true;
+            }
+            taps.push_back(tap);
+        }
+    }
+    return taps;
+}
+
+
+void LinearDemodulator::EstimateCarrier(const unsigned short int* image)
+{
+    std::copy(image, image + nx * ny, real_in);
+    fftw_execute(plan_forward);
+    const std::complex<double>* s = AsComplex(spec);
+
+    // power at signed frequency indices, using Hermitian symmetry for kx < 0
+    auto power = [&](long kx, long ky)
+    {
+        if (kx < 0)
+        {
+            kx = -kx;
+            ky = -ky;
+        }
+        if (kx >= static_cast<long>(nxh)) {
+            return 0.;
+        }
+        const size_t iy = static_cast<size_t>((ky % static_cast<long>(ny) + static_cast<long>(ny)) % static_cast<long>(ny));
+        return std::norm(s[iy * nxh + static_cast<size_t>(kx)]);
+    };
+
+    // strongest peak, away from the low frequencies
+    const long kmin = 2;
+    long kx_peak = 0;
+    long ky_peak = 0;
+    double p_peak = -1;
+    for (size_t iy = 0; iy < ny; iy++)
+    {
+        const long ky = GetSignedIndex(iy, ny);
+        for (size_t ix = 0; ix < nxh; ix++)
+        {
+            const long kx = static_cast<long>(ix);
+            if (std::abs(kx) <= kmin && std::abs(ky) <= kmin) {
+                continue;
+            }
+            const double p = std::norm(s[iy * nxh + ix]);
+            if (p > p_peak)
+            {
+                p_peak = p;
+                kx_peak = kx;
+                ky_peak = ky;
+            }
+        }
+    }
+
+    // sub-bin refinement: parabola through the log power at the peak and its neighbours
+    auto refine = [](double pm, double p0, double pp) {
+        const double lm = std::log(pm + 1e-300);
+        const double l0 = std::log(p0 + 1e-300);
+        const double lp = std::log(pp + 1e-300);
+        const double denom = lm - 2 * l0 + lp;
+        return (denom < 0) ? std::clamp(0.5 * (lm - lp) / denom, -0.5, 0.5) : 0.;
+    };
+    const double dkx = refine(power(kx_peak - 1, ky_peak), p_peak, power(kx_peak + 1, ky_peak));
+    const double dky = refine(power(kx_peak, ky_peak - 1), p_peak, power(kx_peak, ky_peak + 1));
+    double fx_est = (kx_peak + dkx) / nx;
+    double fy_est = (ky_peak + dky) / ny;
+    if (fx_est < 0 || (fx_est == 0 && fy_est < 0))
+    {
+        fx_est = -fx_est;
+        fy_est = -fy_est;
+    }
+    SetCarrier(fx_est, fy_est);
+}
+
+
+void LinearDemodulator::Demodulate(const unsigned short int* image, DemodResult* result)
+{
+    if (!carrier_set) {
+        EstimateCarrier(image);
+    }
+    std::copy(image, image + nx * ny, real_in);
+    fftw_execute(plan_forward);
+
+    const std::complex<double>* s = AsComplex(spec);
+    std::complex<double>* s_dc = AsComplex(spec_dc);
+    std::complex<double>* s_sb = AsComplex(spec_sb);
+    std::memset(spec_dc, 0, sizeof(fftw_complex) * ny * nxh);  // the complex-to-real transform overwrites its input
+    for (const Tap& tap : taps_dc) {
+        s_dc[tap.ifull] = tap.weight * s[tap.ihalf];
+    }
+    for (const Tap& tap : taps_sb) {
+        s_sb[tap.ifull] = tap.weight * (tap.conjugate ? std::conj(s[tap.ihalf]) : s[tap.ihalf]);
+    }
+    fftw_execute(plan_dc);
+    fftw_execute(plan_sb);
+
+    const size_t npix = nx * ny;
+    result->dc.resize(npix);
+    result->phase.resize(npix);
+    result->contrast.resize(npix);
+    const std::complex<double>* a = AsComplex(analytic);
+    for (size_t i = 0; i < npix; i++)
+    {
+        const double dc = real_dc[i];
+        result->dc[i] = dc;
+        result->phase[i] = std::arg(a[i]);
+        result->contrast[i] = (dc > 0) ? 2 * std::abs(a[i]) / dc : 0.;
+    }
+}
+
+
+
+#endif  // CISPP_HAVE_FFTW
+
+} // namespace cispp
@@ -0,0 +1,346 @@
+#include "include/h5output.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+
+
+namespace cispp {
+
+
+namespace {
+
+
+// HDF5 is not thread-safe unless built with --enable-threadsafe, so every call into it, from any writer, is serialised
+std::mutex mtx_h5;
+
+
+void Check(herr_t status, const std::string& what)
+{
+    if (status < 0) {
+        throw std::runtime_error("HDF5: failed to " + what + ".");
+    }
+}
+
+
+hid_t CheckId(hid_t id, const std::string& what)
+{
+    if (id < 0) {
+        throw std::runtime_error("HDF5: failed to " + what + ".");
+    }
+    return id;
+}
+
+
+/**
+ * @brief Create (replacing) an attribute on an object and write its value
+ */
+void WriteAttribute(hid_t obj, const std::string& name, hid_t type, hid_t space, const void* value)
+{
+    if (H5Aexists(obj, name.c_str()) > 0) {
+        Check(H5Adelete(obj, name.c_str()), "delete attribute " + name);
+    }
+    hid_t attr = CheckId(H5Acreate2(obj, name.c_str(), type, space, H5P_DEFAULT, H5P_DEFAULT), "create attribute " + name);
+    herr_t status = H5Awrite(attr, type, value);
+    H5Aclose(attr);
+    Check(status, "write attribute " + name);
+}
+
+
+} // namespace
+
+
+H5FrameWriter::H5FrameWriter(const std::string& fpath, const std::string& dataset_name, size_t nx, size_t ny, 
+                             int bit_depth, const H5WriterOptions& opts)
+: fpath(fpath),
+  nx(nx),
+  ny(ny),
+  opts(opts)
+{
+    this->opts.chunk_frames = std::max<size_t>(opts.chunk_frames, 1);
+    chunk_rows = (opts.chunk_rows == 0) ? std::min<size_t>(ny, 128) : std::min(opts.chunk_rows, ny);
+    chunk_cols = (opts.chunk_cols == 0) ? std::min<size_t>(nx, 256) : std::min(opts.chunk_cols, nx);
+
+    {
+        std::lock_guard<std::mutex> lock(mtx_h5);
+        file = CheckId(H5Fcreate(fpath.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT), "create file " + fpath);
+
+        const hsize_t dims[3] = {0, ny, nx};
+        const hsize_t maxdims[3] = {H5S_UNLIMITED, ny, nx};
+        const hsize_t chunk[3] = {this->opts.chunk_frames, chunk_rows, chunk_cols};
+        hid_t space = H5Screate_simple(3, dims, maxdims);
+        hid_t dcpl = H5Pcreate(H5P_DATASET_CREATE);
+        H5Pset_chunk(dcpl, 3, chunk);
+        if (opts.shuffle) {
+            H5Pset_shuffle(dcpl);
+        }
+        if (opts.deflate_level > 0) {
+            H5Pset_deflate(dcpl, opts.deflate_level);
+        }
+        dataset = H5Dcreate2(file, dataset_name.c_str(), H5T_STD_U16LE, space, H5P_DEFAULT, dcpl, H5P_DEFAULT);
+        H5Pclose(dcpl);
+        H5Sclose(space);
+        if (dataset < 0) 
+        {
+            H5Fclose(file);
+            throw std::runtime_error("HDF5: failed to create dataset " + dataset_name + ".");
+        }
+    }
+    SetAttribute("bit_depth", static_cast<double>(bit_depth));
+
+    staging.resize(this->opts.chunk_frames * nx * ny);
+    if (opts.queue_depth > 0)
+    {
+        buffers.assign(opts.queue_depth, std::vector<unsigned short int>(nx * ny));
+        for (size_t ibuf = 0; ibuf < buffers.size(); ibuf++) {
+            free_buffers.push_back(ibuf);
+        }
+        writer = std::thread(&H5FrameWriter::WriterLoop, this);
+    }
+}
+
+
+H5FrameWriter::~H5FrameWriter()
+{
+    try {
+        Close();
+    }
+    catch (...) {
+    }
+}
+
+
+void H5FrameWriter::SetAttribute(const std::string& name, const std::string& value)
+{
+    std::lock_guard<std::mutex> lock(mtx_h5);
+    hid_t type = H5Tcopy(H5T_C_S1);
+    H5Tset_size(type, std::max<size_t>(value.size(), 1));
+    hid_t space = H5Screate(H5S_SCALAR);
+    std::string value_padded = value.empty() ? std::string(1, '\0') : value;
+    try {
+        WriteAttribute(dataset, name, type, space, value_padded.data());
+    }
+    catch (...) {
+        H5Sclose(space);
+        H5Tclose(type);
+        throw;
+    }
+    H5Sclose(space);
+    H5Tclose(type);
+}
+
+
+void H5FrameWriter::SetAttribute(const std::string& name, double value)
+{
+    std::lock_guard<std::mutex> lock(mtx_h5);
+    hid_t space = H5Screate(H5S_SCALAR);
+    try {
+        WriteAttribute(dataset, name, H5T_NATIVE_DOUBLE, space, &value);
+    }
+    catch (...) {
+        H5Sclose(space);
+        throw;
+    }
+    H5Sclose(space);
+}
+
+
+void H5FrameWriter::SetAttribute(const std::string& name, const std::vector<double>& value)
+{
+    std::lock_guard<std::mutex> lock(mtx_h5);
+    const hsize_t dims[1] = {value.size()};
+    hid_t space = H5Screate_simple(1, dims, nullptr);
+    try {
+        WriteAttribute(dataset, name, H5T_NATIVE_DOUBLE, space, value.data());
+    }
+    catch (...) {
+        H5Sclose(space);
+        throw;
+    }
+    H5Sclose(space);
+}
+
+
+void H5FrameWriter::SetInstrumentConfig(const std::string& fp_config)
+{
+    std::ifstream file_config(fp_config);
+    if (!file_config) {
+        throw std::runtime_error("Failed to read instrument config '" + fp_config + "'.");
+    }
+    std::stringstream ss;
+    ss << file_config.rdbuf();
+    SetAttribute("instrument_config", ss.str());
+}
+
+
+void H5FrameWriter::Write(const unsigned short int* frame)
+{
+    if (file < 0) {
+        throw std::logic_error("H5FrameWriter is closed.");
+    }
+    RethrowError();
+    if (!writer.joinable())
+    {
+        std::lock_guard<std::mutex> lock(mtx_h5);
+        Stage(frame);
+        nframes_in++;
+        return;
+    }
+
+    size_t ibuf;
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        cv_free.wait(lock, [this] { return error || !free_buffers.empty(); });
+        if (error) {
+            lock.unlock();
+            RethrowError();
+        }
+        ibuf = free_buffers.front();
+        free_buffers.pop_front();
+    }
+    std::memcpy(buffers[ibuf].data(), frame, nx * ny * sizeof(unsigned short int));
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        queue.push_back(ibuf);
+    }
+    cv_full.notify_one();
+    nframes_in++;
+}
+
+
+void H5FrameWriter::Flush()
+{
+    if (file < 0) {
+        return;
+    }
+    if (writer.joinable())
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        cv_idle.wait(lock, [this] { return error || (queue.empty() && !busy); });
+    }
+    RethrowError();
+    std::lock_guard<std::mutex> lock(mtx_h5);
+    WriteStaged();
+    Check(H5Fflush(file, H5F_SCOPE_LOCAL), "flush file " + fpath);
+}
+
+
+void H5FrameWriter::Close()
+{
+    if (file < 0) {
+        return;
+    }
+    std::exception_ptr flush_error = nullptr;
+    try {
+        Flush();
+    }
+    catch (...) {
+        flush_error = std::current_exception();
+    }
+    if (writer.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stop = true;
+        }
+        cv_full.notify_one();
+        writer.join();
+    }
+    {
+        std::lock_guard<std::mutex> lock(mtx_h5);
+        H5Dclose(dataset);
+        H5Fclose(file);
+    }
+    dataset = -1;
+    file = -1;
+    if (flush_error) {
+        std::rethrow_exception(flush_error);
+    }
+}
+
+
+void H5FrameWriter::WriterLoop()
+{
+    while (true)
+    {
+        size_t ibuf;
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            cv_full.wait(lock, [this] { return stop || !queue.empty(); });
+            if (queue.empty()) {
+                return;
+            }
+            ibuf = queue.front();
+            queue.pop_front();
+            busy = true;
+        }
+        try 
+        {
+            std::lock_guard<std::mutex> lock(mtx_h5);
+            Stage(buffers[ibuf].data());
+        }
+        catch (...) 
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (!error) {
+                error = std::current_exception();
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            free_buffers.push_back(ibuf);
+            busy = false;
+        }
+        cv_free.notify_one();
+        cv_idle.notify_all();
+    }
+}
+
+
+void H5FrameWriter::Stage(const unsigned short int* frame)
+{
+    std::memcpy(&staging[nstaged * nx * ny], frame, nx * ny * sizeof(unsigned short int));
+    nstaged++;
+    if (nstaged == opts.chunk_frames) {
+        WriteStaged();
+    }
+}
+
+
+void H5FrameWriter::WriteStaged()
+{
+    if (nstaged == 0) {
+        return;
+    }
+    const hsize_t dims[3] = {nframes_out + nstaged, ny, nx};
+    Check(H5Dset_extent(dataset, dims), "extend dataset");
+
+    const hsize_t start[3] = {nframes_out, 0, 0};
+    const hsize_t count[3] = {nstaged, ny, nx};
+    hid_t filespace = H5Dget_space(dataset);
+    hid_t memspace = H5Screate_simple(3, count, nullptr);
+    H5Sselect_hyperslab(filespace, H5S_SELECT_SET, start, nullptr, count, nullptr);
+    herr_t status = H5Dwrite(dataset, H5T_NATIVE_USHORT, memspace, filespace, H5P_DEFAULT, staging.data());
+    H5Sclose(memspace);
+    H5Sclose(filespace);
+    Check(status, "write frames to " + fpath);
+    nframes_out += nstaged;
+    nstaged = 0;
+}
+
+
+void H5FrameWriter::RethrowError()
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    if (error) {
+        std::exception_ptr e = error;
+        error = nullptr;
+        std::rethrow_exception(e);
+    }
+}
+
+
+} // namespace cispp
@@ -0,0 +1,532 @@
+#include "include/imageio.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+
+namespace cispp {
+
+
+namespace {
+
+
+constexpr bool host_little_endian = (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__);
+
+
+void ThrowErrno(const std::string& what, const std::string& fpath)
+{
+    throw std::runtime_error(what + " '" + fpath + "': " + std::strerror(errno));
+}
+
+
+inline unsigned short int ByteSwap(unsigned short int x) {
+    return static_cast<unsigned short int>((x >> 8) | (x << 8));
+}
+
+
+/**
+ * @brief Store an unsigned integer little-endian, byte by byte
+ */
+template <typename T>
+void StoreLittleEndian(T value, char* dst)
+{
+    for (size_t i = 0; i < sizeof(T); i++) {
+        dst[i] = static_cast<char>((value >> (8 * i)) & 0xff);
+    }
+}
+
+
+template <typename T>
+T LoadLittleEndian(const char* src)
+{
+    T value = 0;
+    for (size_t i = 0; i < sizeof(T); i++) {
+        value |= static_cast<T>(static_cast<unsigned char>(src[i])) << (8 * i);
+    }
+    return value;
+}
+
+
+std::string SerialiseHeader(const FrameStackHeader& header)
+{
+    std::string bytes(FrameStackHeader::size, '\0');
+    std::memcpy(&bytes[0], FrameStackHeader::magic, sizeof(FrameStackHeader::magic));
+    StoreLittleEndian<uint32_t>(FrameStackHeader::version, &bytes[8]);
+    StoreLittleEndian<uint32_t>(header.bit_depth, &bytes[12]);
+    StoreLittleEndian<uint64_t>(header.nx, &bytes[16]);
+    StoreLittleEndian<uint64_t>(header.ny, &bytes[24]);
+    StoreLittleEndian<uint64_t>(header.nframes, &bytes[32]);
+    return bytes;
+}
+
+
+/**
+ * @brief writev() until every byte is written
+ */
+void WriteAll(int fd, struct iovec* iov, int iovcnt, const std::string& fpath)
+{
+    while (iovcnt > 0)
+    {
+        ssize_t nwritten = writev(fd, iov, iovcnt);
+        if (nwritten < 0)
+        {
+            if (errno == EINTR) {
+                continue;
+            }
+            ThrowErrno("Failed to write", fpath);
+        }
+        // skip what was written
+        while (iovcnt > 0 && static_cast<size_t>(nwritten) >= iov->iov_len)
+        {
+            nwritten -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0)
+        {
+            iov->iov_base = static_cast<char*>(iov->iov_base) + nwritten;
+            iov->iov_len -= nwritten;
+        }
+    }
+}
+
+
+/**
+ * @brief Write header then pixel data to a new file, in one writev() call or through a memory mapping
+ * 
+ * @param fpath 
+ * @param header 
+ * @param data pixel data
+ * @param nbytes size of pixel data in bytes
+ * @param swap whether to byte-swap 16-bit pixels on the way out
+ * @param method 
+ */
+void WriteFile(const std::string& fpath, const std::string& header, const void* data, size_t nbytes, bool swap, 
+               WriteMethod method)
+{
+    const int fd = open(fpath.c_str(), (method == WriteMethod::MemoryMap ? O_RDWR : O_WRONLY) | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        ThrowErrno("Failed to open", fpath);
+    }
+    const unsigned short int* pixels = static_cast<const unsigned short int*>(data);
+    const size_t npix = nbytes / sizeof(unsigned short int);
+
+    try
+    {
+        if (method == WriteMethod::MemoryMap)
+        {
+            const size_t total = header.size() + nbytes;
+            if (ftruncate(fd, total) != 0) {
+                ThrowErrno("Failed to size", fpath);
+            }
+            if (total > 0)
+            {
+                void* map = mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+                if (map == MAP_FAILED) {
+                    ThrowErrno("Failed to map", fpath);
+                }
+                char* dst = static_cast<char*>(map);
+                std::memcpy(dst, header.data(), header.size());
+                if (swap)
+                {
+                    unsigned short int* dst_pix = reinterpret_cast<unsigned short int*>(dst + header.size());
+                    for (size_t i = 0; i < npix; i++) {
+                        dst_pix[i] = ByteSwap(pixels[i]);
+                    }
+                }
+                else {
+                    std::memcpy(dst + header.size(), data, nbytes);
+                }
+                munmap(map, total);
+            }
+        }
+        else
+        {
+            std::vector<unsigned short int> swapped;
+            if (swap)
+            {
+                swapped.resize(npix);
+                for (size_t i = 0; i < npix; i++) {
+                    swapped[i] = ByteSwap(pixels[i]);
+                }
+                data = swapped.data();
+            }
+            struct iovec iov[2];
+            iov[0].iov_base = const_cast<char*>(header.data());
+            iov[0].iov_len = header.size();
+            iov[1].iov_base = const_cast<void*>(data);
+            iov[1].iov_len = nbytes;
+            WriteAll(fd, iov, 2, fpath);
+        }
+    }
+    catch (...)
+    {
+        close(fd);
+        throw;
+    }
+    if (close(fd) != 0) {
+        ThrowErrno("Failed to close", fpath);
+    }
+}
+
+
+} // namespace
+
+
+void WritePGM(const std::string& fpath, const unsigned short int* image, size_t nx, size_t ny, int bit_depth, 
+              WriteMethod method)
+{
+    if (bit_depth < 1 || bit_depth > 16) {
+        throw std::invalid_argument("PGM bit depth must be 1-16.");
+    }
+    const int maxval = (1 << bit_depth) - 1;
+    const std::string header = "P5\n" + std::to_string(nx) + " " + std::to_string(ny) + "\n" + std::to_string(maxval) + "\n";
+    const size_t npix = nx * ny;
+
+    if (maxval < 256)
+    {
+        std::vector<unsigned char> image_8(npix);
+        for (size_t i = 0; i < npix; i++) {
+            image_8[i] = static_cast<unsigned char>(image[i]);
+        }
+        WriteFile(fpath, header, image_8.data(), npix, false, method);
+    }
+    else {
+        WriteFile(fpath, header, image, npix * sizeof(unsigned short int), host_little_endian, method);
+    }
+}
+
+
+void WriteRaw(const std::string& fpath, const unsigned short int* image, size_t npix, WriteMethod method)
+{
+    WriteFile(fpath, "", image, npix * sizeof(unsigned short int), !host_little_endian, method);
+}
+
+
+void WriteFrameStack(const std::string& fpath, const unsigned short int* frames, size_t nx, size_t ny, size_t nframes, 
+                     int bit_depth, WriteMethod method)
+{
+    FrameStackHeader header;
+    header.bit_depth = bit_depth;
+    header.nx = nx;
+    header.ny = ny;
+    header.nframes = nframes;
+    WriteFile(fpath, SerialiseHeader(header), frames, nframes * nx * ny * sizeof(unsigned short int), 
+              !host_little_endian, method);
+}
+
+
+std::vector<unsigned short int> ReadPGM(const std::string& fpath, size_t* nx, size_t* ny, int* maxval)
+{
+    std::ifstream file(fpath, std::ios::binary);
+    std::string magic;
+    file >> magic;
+    if (!file || magic != "P5") {
+        throw std::runtime_error("Not a binary PGM file '" + fpath + "'.");
+    }
+    auto skip_comments = [&]() {
+        file >> std::ws;
+        while (file.peek() == '#') {
+            file.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+            file >> std::ws;
+        }
+    };
+    skip_comments();
+    file >> *nx;
+    skip_comments();
+    file >> *ny;
+    skip_comments();
+    file >> *maxval;
+    file.get();  // single whitespace before the data
+
+    const size_t npix = (*nx) * (*ny);
+    std::vector<unsigned short int> image(npix);
+    if (*maxval < 256)
+    {
+        std::vector<unsigned char> image_8(npix);
+        file.read(reinterpret_cast<char*>(image_8.data()), npix);
+        for (size_t i = 0; i < npix; i++) {
+            image[i] = image_8[i];
+        }
+    }
+    else
+    {
+        std::vector<unsigned char> bytes(2 * npix);
+        file.read(reinterpret_cast<char*>(bytes.data()), bytes.size());
+        for (size_t i = 0; i < npix; i++) {
+            image[i] = static_cast<unsigned short int>((bytes[2 * i] << 8) | bytes[2 * i + 1]);
+        }
+    }
+    if (!file) {
+        throw std::runtime_error("PGM file '" + fpath + "' is truncated.");
+    }
+    return image;
+}
+
+
+FrameStackHeader ReadFrameStackHeader(const std::string& fpath)
+{
+    std::ifstream file(fpath, std::ios::binary);
+    std::string bytes(FrameStackHeader::size, '\0');
+    file.read(&bytes[0], bytes.size());
+    if (!file || std::memcmp(bytes.data(), FrameStackHeader::magic, sizeof(FrameStackHeader::magic)) != 0) {
+        throw std::runtime_error("Not a frame stack file '" + fpath + "'.");
+    }
+    if (LoadLittleEndian<uint32_t>(&bytes[8]) != FrameStackHeader::version) {
+        throw std::runtime_error("Unsupported frame stack version in '" + fpath + "'.");
+    }
+    FrameStackHeader header;
+    header.bit_depth = LoadLittleEndian<uint32_t>(&bytes[12]);
+    header.nx = LoadLittleEndian<uint64_t>(&bytes[16]);
+    header.ny = LoadLittleEndian<uint64_t>(&bytes[24]);
+    header.nframes = LoadLittleEndian<uint64_t>(&bytes[32]);
+    return header;
+}
+
+
+std::vector<unsigned short int> ReadFrameStack(const std::string& fpath, FrameStackHeader* header)
+{
+    *header = ReadFrameStackHeader(fpath);
+    std::ifstream file(fpath, std::ios::binary);
+    file.seekg(FrameStackHeader::size);
+    std::vector<unsigned short int> frames(header->nframes * header->nx * header->ny);
+    file.read(reinterpret_cast<char*>(frames.data()), frames.size() * sizeof(unsigned short int));
+    if (!file) {
+        throw std::runtime_error("Frame stack file '" + fpath + "' is truncated.");
+    }
+    if (!host_little_endian)
+    {
+        for (unsigned short int& x : frames) {
+            x = ByteSwap(x);
+        }
+    }
+    return frames;
+}
+
+
+FrameStackWriter::FrameStackWriter(const std::string& fpath, size_t nx, size_t ny, int bit_depth)
+: fpath(fpath)
+{
+    header.bit_depth = bit_depth;
+    header.nx = nx;
+    header.ny = ny;
+    fd = open(fpath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        ThrowErrno("Failed to open", fpath);
+    }
+    std::string bytes = SerialiseHeader(header);
+    struct iovec iov {&bytes[0], bytes.size()};
+    WriteAll(fd, &iov, 1, fpath);
+}
+
+
+FrameStackWriter::~FrameStackWriter()
+{
+    try {
+        Close();
+    }
+    catch (...) {
+    }
+}
+
+
+void FrameStackWriter::Write(const unsigned short int* frames, size_t nframes)
+{
+    if (fd < 0) {
+        throw std::logic_error("FrameStackWriter is closed.");
+    }
+    const size_t npix = nframes * header.nx * header.ny;
+    if (!host_little_endian)
+    {
+        swapped.resize(npix);
+        for (size_t i = 0; i < npix; i++) {
+            swapped[i] = ByteSwap(frames[i]);
+        }
+        frames = swapped.data();
+    }
+    struct iovec iov {const_cast<unsigned short int*>(frames), npix * sizeof(unsigned short int)};
+    WriteAll(fd, &iov, 1, fpath);
+    header.nframes += nframes;
+}
+
+
+void FrameStackWriter::Close()
+{
+    if (fd < 0) {
+        return;
+    }
+    const int fd_close = fd;
+    fd = -1;
+    std::string bytes = SerialiseHeader(header);
+    const bool ok = (pwrite(fd_close, bytes.data(), bytes.size(), 0) == static_cast<ssize_t>(bytes.size()));
+    if (close(fd_close) != 0 || !ok) {
+        ThrowErrno("Failed to finalise", fpath);
+    }
+}
+
+
+
+MappedFrameStack::~MappedFrameStack()
+{
+    try {
+        Close();
+    }
+    catch (...) {
+    }
+}
+
+
+MappedFrameStack::MappedFrameStack(MappedFrameStack&& other) noexcept
+: fpath(std::move(other.fpath)),
+  header(other.header),
+  writable(other.writable),
+  map(other.map),
+  map_size(other.map_size)
+{
+    other.map = nullptr;
+    other.map_size = 0;
+}
+
+
+MappedFrameStack& MappedFrameStack::operator=(MappedFrameStack&& other) noexcept
+{
+    if (this != &other)
+    {
+        try {
+            Close();
+        }
+        catch (...) {
+        }
+        fpath = std::move(other.fpath);
+        header = other.header;
+        writable = other.writable;
+        map = other.map;
+        map_size = other.map_size;
+        other.map = nullptr;
+        other.map_size = 0;
+    }
+    return *this;
+}
+
+
+MappedFrameStack MappedFrameStack::Create(const std::string& fpath, size_t nx, size_t ny, size_t nframes, int bit_depth)
+{
+    if (!host_little_endian) {
+        throw std::runtime_error("Memory-mapped frame stacks need a little-endian host.");
+    }
+    FrameStackHeader header;
+    header.bit_depth = bit_depth;
+    header.nx = nx;
+    header.ny = ny;
+    header.nframes = nframes;
+
+    const int fd = open(fpath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        ThrowErrno("Failed to open", fpath);
+    }
+    const size_t map_size = FrameStackHeader::size + nframes * nx * ny * sizeof(unsigned short int);
+    if (ftruncate(fd, map_size) != 0)
+    {
+        close(fd);
+        ThrowErrno("Failed to size", fpath);
+    }
+    MappedFrameStack stack = Map(fpath, fd, map_size, true);
+    std::string bytes = SerialiseHeader(header);
+    std::memcpy(stack.map, bytes.data(), bytes.size());
+    stack.header = header;
+    return stack;
+}
+
+
+MappedFrameStack MappedFrameStack::Open(const std::string& fpath, bool writable)
+{
+    if (!host_little_endian) {
+        throw std::runtime_error("Memory-mapped frame stacks need a little-endian host.");
+    }
+    FrameStackHeader header = ReadFrameStackHeader(fpath);
+    const int fd = open(fpath.c_str(), writable ? O_RDWR : O_RDONLY);
+    if (fd < 0) {
+        ThrowErrno("Failed to open", fpath);
+    }
+    const size_t map_size = FrameStackHeader::size + header.nframes * header.nx * header.ny * sizeof(unsigned short int);
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < map_size)
+    {
+        close(fd);
+        throw std::runtime_error("Frame stack file '" + fpath + "' is truncated.");
+    }
+    MappedFrameStack stack = Map(fpath, fd, map_size, writable);
+    stack.header = header;
+    return stack;
+}
+
+
+MappedFrameStack MappedFrameStack::Map(const std::string& fpath, int fd, size_t map_size, bool writable)
+{
+    void* map = mmap(nullptr, map_size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+    const int errno_map = errno;
+    close(fd);  // the mapping keeps the file open
+    if (map == MAP_FAILED)
+    {
+        errno = errno_map;
+        ThrowErrno("Failed to map", fpath);
+    }
+    MappedFrameStack stack;
+    stack.fpath = fpath;
+    stack.writable = writable;
+    stack.map = static_cast<char*>(map);
+    stack.map_size = map_size;
+    return stack;
+}
+
+
+const unsigned short int* MappedFrameStack::GetFrame(size_t iframe) const
+{
+    if (map == nullptr) {
+        throw std::logic_error("Frame stack is not mapped.");
+    }
+    if (iframe >= header.nframes) {
+        throw std::out_of_range("Frame index out of range for '" + fpath + "'.");
+    }
+    return reinterpret_cast<const unsigned short int*>(map + FrameStackHeader::size) + iframe * header.nx * header.ny;
+}
+
+
+unsigned short int* MappedFrameStack::GetWritableFrame(size_t iframe)
+{
+    if (!writable) {
+        throw std::logic_error("Frame stack '" + fpath + "' is mapped read-only.");
+    }
+    return const_cast<unsigned short int*>(GetFrame(iframe));
+}
+
+
+void MappedFrameStack::Flush(bool wait)
+{
+    if (map != nullptr && writable && msync(map, map_size, wait ? MS_SYNC : MS_ASYNC) != 0) {
+        ThrowErrno("Failed to flush", fpath);
+    }
+}
+
+
+void MappedFrameStack::Close()
+{
+    if (map == nullptr) {
+        return;
+    }
+    char* map_close = map;
+    map = nullptr;
+    if (munmap(map_close, map_size) != 0) {
+        ThrowErrno("Failed to unmap", fpath);
+    }
+}
+
+} // namespace cispp
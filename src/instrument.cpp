@@ -1,7 +1,15 @@
 #include "include/instrument.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <type_traits>
+
 #include "include/material.h"
 #include "include/camera.h"
+#include "include/coherence.h"
 #include "include/maths.h"
 
 #include "yaml-cpp/yaml.h"
@@ -15,18 +23,32 @@ namespace cispp {
 
 
 Instrument::Instrument(std::filesystem::path fp_config)
-: fp_config(fp_config)
+: Instrument(ParseConfig(fp_config))
+{}
+
+
+Instrument::Instrument(InstrumentConfig config)
+: lens_1_focal_length(config.lens_1_focal_length),
+  lens_2_focal_length(config.lens_2_focal_length),
+  lens_3_focal_length(config.lens_3_focal_length),
+  camera(std::move(config.camera)),
+  components(std::move(config.components)),
+  fp_config(std::move(config.fp_config))
+{}
+
+
+InstrumentConfig Instrument::ParseConfig(std::filesystem::path fp_config)
 {
     YAML::Node nd_config = YAML::LoadFile(fp_config);
-    YAML::Node nd_camera = nd_config["camera"];
-    YAML::Node nd_components = nd_config["interferometer"];
-
-    lens_1_focal_length = nd_config["lens_1_focal_length"].as<double>();
-    lens_2_focal_length = nd_config["lens_2_focal_length"].as<double>();
-    lens_3_focal_length = nd_config["lens_3_focal_length"].as<double>();
 
-    camera = ParseNodeCamera(nd_camera);
-    ParseNodeComponents(nd_components, components);
+    InstrumentConfig config;
+    config.fp_config = fp_config;
+    config.lens_1_focal_length = nd_config["lens_1_focal_length"].as<double>();
+    config.lens_2_focal_length = nd_config["lens_2_focal_length"].as<double>();
+    config.lens_3_focal_length = nd_config["lens_3_focal_length"].as<double>();
+    config.camera = ParseNodeCamera(nd_config["camera"]);
+    ParseNodeComponents(nd_config["interferometer"], config.components);
+    return config;
 }
 
 
@@ -73,9 +95,9 @@ void Instrument::ParseNodeComponents(YAML::Node nd_components, vector<unique_ptr
                 mp.name = material;
 
                 std::string alphabet = "ABCDEF";
-                for (int j=0; j<alphabet.size(); j++)
+                for (size_t j=0; j<alphabet.size(); j++)
                 {
-                    std::string key(1, alphabet[i]);
+                    std::string key(1, alphabet[j]);
                     if (node["sellmeier_coefs"][key + "e"])
                     {
                         double e = node["sellmeier_coefs"][key + "e"].as<double>();
@@ -84,6 +106,15 @@ void Instrument::ParseNodeComponents(YAML::Node nd_components, vector<unique_ptr
                         mp.sellmeier_o.push_back(o);
                     }
                 }   
+                auto ptr = std::make_unique<cispp::UniaxialCrystal>(
+                    orientation, 
+                    tilt_x,
+                    tilt_y,
+                    thickness, 
+                    cut_angle, 
+                    mp
+                );
+                components.push_back(std::move(ptr));   
             }  
             else {
                 auto ptr = std::make_unique<cispp::UniaxialCrystal>(
@@ -129,6 +160,140 @@ double Instrument::GetAzimuthalAngle(double x, double y, unique_ptr<cispp::Compo
 }
 
 
+void Instrument::GetRayAnglesRow(size_t iy, size_t ix0, size_t ix1, unique_ptr<cispp::Component>& component, 
+                                 double* incidence_angle, double* azimuthal_angle)
+{
+    const double x0 = lens_3_focal_length * tan(component->tilt_x);
+    const double y0 = lens_3_focal_length * tan(component->tilt_y);
+    const double y = camera.pixel_centres_y[iy];
+    for (size_t ix = ix0; ix < ix1; ix++)
+    {
+        const double x = camera.pixel_centres_x[ix];
+        incidence_angle[ix - ix0] = atan2(sqrt(pow(x - x0, 2) + pow(y - y0, 2)), lens_3_focal_length);
+        azimuthal_angle[ix - ix0] = atan2(y - y0, x - x0) + M_PI - (component->orientation);
+    }
+}
+
+
+void Instrument::EnableGeometryCache(bool enable)
+{
+    use_geometry_cache = enable;
+    if (!enable) {
+        geometry_cache.clear();
+    }
+}
+
+
+bool Instrument::IsGeometryCurrent(const ComponentGeometry& geom, size_t icomp)
+{
+    return (
+        !geom.incidence_angle.empty() &&
+        geom.sensor_format_x == camera.sensor_format_x &&
+        geom.sensor_format_y == camera.sensor_format_y &&
+        geom.pixel_size == camera.pixel_size &&
+        geom.lens_3_focal_length == lens_3_focal_length &&
+        geom.orientation == components[icomp]->orientation &&
+        geom.tilt_x == components[icomp]->tilt_x &&
+        geom.tilt_y == components[icomp]->tilt_y
+    );
+}
+
+
+void Instrument::UpdateGeometryCache(const CaptureOptions& opts)
+{
+    if (!use_geometry_cache) {
+        return;
+    }
+    geometry_cache.resize(components.size());
+    const size_t nx = camera.sensor_format_x;
+    const size_t npix = nx * camera.sensor_format_y;
+
+    for (size_t icomp = 0; icomp < components.size(); icomp++)
+    {
+        ComponentGeometry& geom = geometry_cache[icomp];
+        if (!components[icomp]->IsAngleDependent()) {
+            geom = ComponentGeometry();
+            continue;
+        }
+        if (IsGeometryCurrent(geom, icomp)) {
+            continue;
+        }
+        geom.sensor_format_x = camera.sensor_format_x;
+        geom.sensor_format_y = camera.sensor_format_y;
+        geom.pixel_size = camera.pixel_size;
+        geom.lens_3_focal_length = lens_3_focal_length;
+        geom.orientation = components[icomp]->orientation;
+        geom.tilt_x = components[icomp]->tilt_x;
+        geom.tilt_y = components[icomp]->tilt_y;
+        geom.incidence_angle.resize(npix);
+        geom.azimuthal_angle.resize(npix);
+        geom.sin_inc.resize(npix);
+        geom.sin_azim.resize(npix);
+        geom.cos_azim.resize(npix);
+
+        ForEachTile(opts, [&](const cispp::Tile& tile, size_t iworker)
+        {
+            for (size_t iy = tile.iy0; iy < tile.iy1; iy++)
+            {
+                const size_t i0 = tile.ix0 + iy * nx;
+                const size_t i1 = tile.ix1 + iy * nx;
+                GetRayAnglesRow(iy, tile.ix0, tile.ix1, components[icomp], &geom.incidence_angle[i0], &geom.azimuthal_angle[i0]);
+                for (size_t i = i0; i < i1; i++)
+                {
+                    geom.sin_inc[i] = sin(geom.incidence_angle[i]);
+                    geom.sin_azim[i] = sin(geom.azimuthal_angle[i]);
+                    geom.cos_azim[i] = cos(geom.azimuthal_angle[i]);
+                }
+            }
+        });
+    }
+}
+
+
+const ComponentGeometry* Instrument::GetCachedGeometry(size_t icomp)
+{
+    if (!use_geometry_cache || icomp >= geometry_cache.size() || !IsGeometryCurrent(geometry_cache[icomp], icomp)) {
+        return nullptr;
+    }
+    return &geometry_cache[icomp];
+}
+
+
+cispp::RayBatch Instrument::GetRayBatchRow(size_t icomp, size_t iy, size_t ix0, size_t ix1, RayScratch& scratch)
+{
+    const size_t n = ix1 - ix0;
+    const ComponentGeometry* geom = GetCachedGeometry(icomp);
+    if (geom)
+    {
+        const size_t i0 = ix0 + iy * camera.sensor_format_x;
+        return {
+            &geom->incidence_angle[i0], 
+            &geom->azimuthal_angle[i0], 
+            &geom->sin_inc[i0], 
+            &geom->sin_azim[i0], 
+            &geom->cos_azim[i0], 
+            n
+        };
+    }
+
+    GetRayAnglesRow(iy, ix0, ix1, components[icomp], scratch.incidence_angle.data(), scratch.azimuthal_angle.data());
+    for (size_t i = 0; i < n; i++)
+    {
+        scratch.sin_inc[i] = sin(scratch.incidence_angle[i]);
+        scratch.sin_azim[i] = sin(scratch.azimuthal_angle[i]);
+        scratch.cos_azim[i] = cos(scratch.azimuthal_angle[i]);
+    }
+    return {
+        scratch.incidence_angle.data(), 
+        scratch.azimuthal_angle.data(), 
+        scratch.sin_inc.data(), 
+        scratch.sin_azim.data(), 
+        scratch.cos_azim.data(), 
+        n
+    };
+}
+
+
 Eigen::Matrix4d Instrument::GetMuellerMatrix(double x, double y, double wavelength)
 {
     Eigen::Matrix4d mtot;
@@ -151,262 +316,1807 @@ Eigen::Matrix4d Instrument::GetMuellerMatrix(double x, double y, double waveleng
 }
 
 
-void Instrument::SaveImage(string fpath, vector<unsigned short int>* image)
+Eigen::Matrix4d Instrument::GetPixelMuellerMatrix(size_t ix, size_t iy, double wavelength)
 {
-    std::ofstream file;
-    file.open(fpath);
-    file << "P2\n" << camera.sensor_format_x << " " << camera.sensor_format_y << "\n255\n";
-    for (size_t j = 0; j < camera.sensor_format_y; j++)
-    {
-        size_t idx_col = j * camera.sensor_format_x;
-        for (size_t i = 0; i < camera.sensor_format_x - 1; i++)
-        {
-            unsigned short int counts = (*image)[i + idx_col];
-            file << counts << ' ';
+    const double x = camera.pixel_centres_x[ix];
+    const double y = camera.pixel_centres_y[iy];
+    const size_t ipix = ix + iy * camera.sensor_format_x;
+
+    Eigen::Matrix4d mtot;
+    for (size_t i = 0; i < components.size(); i++)
+    {  
+        double inc_angle, azim_angle;
+        const ComponentGeometry* geom = GetCachedGeometry(i);
+        if (geom) {
+            inc_angle = geom->incidence_angle[ipix];
+            azim_angle = geom->azimuthal_angle[ipix];
+        }
+        else {
+            inc_angle = GetIncidenceAngle(x, y, components[i]);
+            azim_angle = GetAzimuthalAngle(x, y, components[i]);
+        }
+        Eigen::Matrix4d m = components[i]->GetMuellerMatrix(wavelength, inc_angle, azim_angle);
+        if (i==0){
+            mtot = m;
         }
-        unsigned short int counts = (*image)[camera.sensor_format_x - 1 + idx_col];
-        file << counts << '\n';
+        else {
+            mtot *= m; 
+        }
+    }
+    if (camera.type == "monochrome_polarised"){
+        mtot *= camera.GetMuellerMatrix(x, y);
     }
-    file.close();
+    return mtot;
 }
 
 
-void Instrument::Capture(double wavelength, double flux, vector<unsigned short int>* image)
+void Instrument::Compile(bool enable)
 {
-    assert((*image).size() == camera.sensor_format_x * camera.sensor_format_y);
-    
-    Eigen::Vector4d stokes_in;
-    Eigen::Vector4d stokes_out;
-    stokes_in << flux, 0, 0, 0;
-
-    for (size_t iy = 0; iy < camera.sensor_format_y; iy++)
-    {
-        size_t icol = iy * camera.sensor_format_x;
-        double y = camera.pixel_centres_y[iy];
-        
-        for (size_t ix = 0; ix < camera.sensor_format_x; ix++)
-        {
-            double x = camera.pixel_centres_x[ix];
-            stokes_out = GetMuellerMatrix(x, y, wavelength) * stokes_in;
-            (*image)[ix + icol] = static_cast<unsigned short int>(stokes_out[0]);
-        }
+    if (enable) {
+        compiled = BuildCompiledMueller();
+    }
+    else {
+        compiled.reset();
     }
 }
 
 
-void Instrument::Capture(vector<double>& wavelength, vector<double>& spec_flux, vector<unsigned short int>* image)
+unique_ptr<CompiledMueller> Instrument::BuildCompiledMueller()
 {
-    assert((*image).size() == camera.sensor_format_x * camera.sensor_format_y);
-    assert(wavelength.size() == spec_flux.size());
+    auto cm = std::make_unique<CompiledMueller>();
+    cm->camera_type = camera.type;
+    cm->runs.push_back({});
 
-    Eigen::Vector4d stokes_in;
-    stokes_in(1) = 0;
-    stokes_in(2) = 0;
-    stokes_in(3) = 0;
-    Eigen::Vector4d stokes_out;
-    vector<double> stokes_out0(wavelength.size(), 0.);
+    for (size_t i = 0; i < components.size(); i++)
+    {
+        cm->orientation.push_back(components[i]->orientation);
+        if (components[i]->IsAngleDependent())
+        {
+            cm->stages.push_back({i, components[i]->IsIdealRetarder(), GetRotationMatrix(components[i]->orientation)});
+            cm->runs.push_back({});
+        }
+        else {
+            cm->runs.back().push_back(i);
+        }
+    }
 
-    for (size_t iy = 0; iy < camera.sensor_format_y; iy++)
+    for (const vector<size_t>& run : cm->runs)
     {
-        size_t icol = iy * camera.sensor_format_x;
-        double y = camera.pixel_centres_y[iy];
-        for (size_t ix = 0; ix < camera.sensor_format_x; ix++)
+        bool is_constant = true;
+        Eigen::Matrix4d m = Eigen::Matrix4d::Identity();
+        for (size_t i : run)
         {
-            double x = camera.pixel_centres_x[ix];
-            
-            for (size_t iwl=0; iwl < wavelength.size(); iwl++) 
-            {
-                double wl = wavelength[iwl];
-                stokes_in(0) = spec_flux[iwl];
-                stokes_out0[iwl] = (GetMuellerMatrix(x, y, wl) * stokes_in)(0);
+            if (components[i]->IsWavelengthDependent()) {
+                is_constant = false;
+                break;
             }
-
-            (*image)[ix + icol] = static_cast<unsigned short int>(cispp::trapz(wavelength, stokes_out0));
+            m *= components[i]->GetMuellerMatrix(0, 0, 0);
         }
+        cm->run_is_constant.push_back(is_constant);
+        cm->run_constant.push_back(m);
     }
+    return cm;
 }
 
 
-bool InstrumentSingleDelayLinear::TestType(const YAML::Node node)
+cispp::RayBatchF Instrument::GetRayBatchF(const cispp::RayBatch& rays, RayScratchF& scratch)
 {
-    vector<unique_ptr<cispp::Component>> components_test;
-    Instrument::ParseNodeComponents(node["interferometer"], components_test);
-    cispp::Camera cam = ParseNodeCamera(node["camera"]);
+    for (size_t i = 0; i < rays.n; i++)
+    {
+        scratch.incidence_angle[i] = static_cast<float>(rays.incidence_angle[i]);
+        scratch.azimuthal_angle[i] = static_cast<float>(rays.azimuthal_angle[i]);
+        scratch.sin_inc[i] = static_cast<float>(rays.sin_inc[i]);
+        scratch.sin_azim[i] = static_cast<float>(rays.sin_azim[i]);
+        scratch.cos_azim[i] = static_cast<float>(rays.cos_azim[i]);
+    }
+    return {
+        scratch.incidence_angle.data(), 
+        scratch.azimuthal_angle.data(), 
+        scratch.sin_inc.data(), 
+        scratch.sin_azim.data(), 
+        scratch.cos_azim.data(), 
+        rays.n
+    };
+}
 
-    size_t n = components_test.size();
-    if (n > 2 &&
-        cam.type == "monochrome" &&
-        components_test[0]->IsIdealPolariser() && 
-        components_test[n-1]->IsIdealPolariser() &&
-        TestAlign90(components_test[0], components_test[n-1]))
+
+template <typename Real>
+void Instrument::CaptureCompiled(const vector<double>& wavelength, const vector<double>& spec_flux, bool integrate, 
+                                 unsigned short int* image, const CaptureOptions& opts)
+{
+    using Matrix4 = Eigen::Matrix<Real, 4, 4>;
+    using RowVector4 = Eigen::Matrix<Real, 1, 4>;
+    using Vector4 = Eigen::Matrix<Real, 4, 1>;
+    constexpr bool single = std::is_same<Real, float>::value;
+
+    // recompile if the instrument has changed. A single-precision capture of an uncompiled instrument uses a 
+    // temporary compiled model.
+    unique_ptr<CompiledMueller> compiled_tmp;
+    if (compiled)
     {
-        size_t rcount = 0;
-        for (size_t i=1; i<n-1; i++)
+        bool current = (compiled->camera_type == camera.type && compiled->orientation.size() == components.size());
+        for (size_t i = 0; current && i < components.size(); i++) {
+            current = (compiled->orientation[i] == components[i]->orientation);
+        }
+        if (!current) {
+            Compile();
+        }
+    }
+    else {
+        compiled_tmp = BuildCompiledMueller();
+    }
+    const CompiledMueller& cm = compiled ? *compiled : *compiled_tmp;
+    const vector<CompiledMueller::PixelStage>& stages = cm.stages;
+
+    UpdateGeometryCache(opts);
+
+    const size_t nwl = integrate ? wavelength.size() : 1;
+    const size_t nstages = stages.size();
+    const size_t nruns = nstages + 1;
+    const bool polarised = (camera.type == "monochrome_polarised");
+    const size_t ncam = polarised ? 4 : 1;
+
+    // wavelength-dependent factors: each run multiplied out, with the rotations of neighbouring retarder stages folded 
+    // in. The first run is reduced to its S0 row and the last (with the camera) to its S0 column.
+    vector<Matrix4> run_wl(nwl * nruns);
+    vector<RowVector4> row_first(nwl);
+    vector<Vector4> col_last(nwl * ncam);
+    for (size_t iwl = 0; iwl < nwl; iwl++)
+    {
+        vector<Eigen::Matrix4d> run_wl_d(nruns);
+        for (size_t k = 0; k < nruns; k++)
         {
-            if (components_test[i]->IsIdealRetarder() && 
-                TestAlign45(components_test[i], components_test[0])) 
+            Eigen::Matrix4d m = Eigen::Matrix4d::Identity();
+            if (k > 0 && stages[k - 1].is_retarder) {
+                m = stages[k - 1].rot;
+            }
+            if (cm.run_is_constant[k]) {
+                m *= cm.run_constant[k];
+            }
+            else {
+                for (size_t i : cm.runs[k]) {
+                    m *= components[i]->GetMuellerMatrix(wavelength[iwl], 0, 0);
+                }
+            }
+            if (k < nstages && stages[k].is_retarder) {
+                m *= stages[k].rot.transpose();
+            }
+            run_wl_d[k] = m;
+            run_wl[iwl * nruns + k] = m.cast<Real>();
+        }
+        row_first[iwl] = (nstages > 0) ? RowVector4(run_wl[iwl * nruns].row(0)) : RowVector4(1, 0, 0, 0);
+        for (size_t q = 0; q < ncam; q++)
+        {
+            Eigen::Matrix4d m = run_wl_d[nstages];
+            if (polarised) {
+                m *= camera.GetMuellerMatrix(camera.pixel_centres_x[q % 2], camera.pixel_centres_y[q / 2]);
+            }
+            col_last[iwl * ncam + q] = m.col(0).cast<Real>();
+        }
+    }
+
+    // retarder delays. In single precision, the on-axis delay is reduced modulo 2 pi in double precision and only 
+    // the deviation from it is evaluated per pixel.
+    vector<unique_ptr<cispp::DelayTable>> delay_tables(nstages);
+    vector<float> delay_0(nstages * nwl, 0.f);
+    for (size_t k = 0; k < nstages; k++)
+    {
+        if (stages[k].is_retarder) 
+        {
+            delay_tables[k] = components[stages[k].icomp]->GetDelayTable(vector<double>(wavelength.begin(), wavelength.begin() + nwl));
+            if (single) 
             {
-                rcount++;
+                for (size_t iwl = 0; iwl < nwl; iwl++) {
+                    delay_0[k * nwl + iwl] = delay_tables[k]->GetDelayOnAxisReduced(iwl);
+                }
             }
         }
-        if (rcount == n-2) {
-            return true;
+    }
+    vector<Real> flux(nwl);
+    vector<Real> dwl(nwl, 0.);
+    for (size_t iwl = 0; iwl < nwl; iwl++)
+    {
+        flux[iwl] = spec_flux[iwl];
+        if (iwl > 0) {
+            dwl[iwl] = wavelength[iwl] - wavelength[iwl - 1];
         }
     }
-    return false;
-}
 
+    // per-worker scratch, one pixel row long
+    const size_t nx = camera.sensor_format_x;
+    const size_t nworkers = GetWorkerCount(opts);
+    vector<vector<RayScratch>> rays(nworkers, vector<RayScratch>(nstages, RayScratch(nx)));
+    vector<vector<RayScratchF>> rays_f(nworkers, vector<RayScratchF>(nstages, RayScratchF(single ? nx : 0)));
+    vector<vector<double>> delay(nworkers, vector<double>(single ? 0 : nstages * nx));
+    vector<vector<float>> ddelay(nworkers, vector<float>(single ? nstages * nx : 0));
+    vector<vector<Real>> stokes_out0(nworkers, vector<Real>(nx));  // at the previous wavelength
+    vector<vector<Real>> integral(nworkers, vector<Real>(nx)); 
 
-void InstrumentSingleDelayLinear::Capture(double wavelength, double flux, vector<unsigned short int>* image)
-{
-    for (size_t iy = 0; iy < camera.sensor_format_y; iy++) 
+    ForEachTile(opts, [&](const cispp::Tile& tile, size_t iworker)
     {
-        size_t icol = iy * camera.sensor_format_x;
-        double y = camera.pixel_centres_y[iy];
-        for (size_t ix = 0; ix < camera.sensor_format_x; ix++) 
+        const size_t n = tile.ix1 - tile.ix0;
+        vector<cispp::RayBatch> rays_row(nstages);
+        vector<cispp::RayBatchF> rays_row_f(nstages);
+        double* delay_w = delay[iworker].data();
+        float* ddelay_w = ddelay[iworker].data();
+        Real* s0_w = stokes_out0[iworker].data();
+        Real* integral_w = integral[iworker].data();
+
+        for (size_t iy = tile.iy0; iy < tile.iy1; iy++)
         {
-            double x = camera.pixel_centres_x[ix];
-            double inc_angle = GetIncidenceAngle(x, y, components[1]);
-            double azim_angle = GetAzimuthalAngle(x, y, components[1]);
-            double delay = components[1]->GetDelay(wavelength, inc_angle, azim_angle);
-            (*image)[ix + icol] = static_cast<unsigned short int>((flux / 4) * (1 + cos(delay)));
+            unsigned short int* image_row = &image[tile.ix0 + iy * nx];
+            for (size_t k = 0; k < nstages; k++) 
+            {
+                rays_row[k] = GetRayBatchRow(stages[k].icomp, iy, tile.ix0, tile.ix1, rays[iworker][k]);
+                if (single && stages[k].is_retarder) {
+                    rays_row_f[k] = GetRayBatchF(rays_row[k], rays_f[iworker][k]);
+                }
+            }
+            std::fill(integral_w, integral_w + n, Real(0));
+
+            for (size_t iwl = 0; iwl < nwl; iwl++)
+            {
+                for (size_t k = 0; k < nstages; k++) 
+                {
+                    if (stages[k].is_retarder) 
+                    {
+                        if (single) {
+                            delay_tables[k]->GetDelayDeviationBatch(iwl, rays_row_f[k], ddelay_w + k * nx);
+                        }
+                        else {
+                            delay_tables[k]->GetDelayBatch(iwl, rays_row[k], delay_w + k * nx);
+                        }
+                    }
+                }
+                for (size_t i = 0; i < n; i++)
+                {
+                    RowVector4 r = row_first[iwl];
+                    for (size_t k = 0; k < nstages; k++)
+                    {
+                        if (stages[k].is_retarder) 
+                        {
+                            if constexpr (single) 
+                            {
+                                const float phase = delay_0[k * nwl + iwl] + ddelay_w[k * nx + i];
+                                const float c = std::cos(phase);
+                                const float s = std::sin(phase);
+                                const float r2 = r(2);
+                                r(2) = r2 * c - r(3) * s;
+                                r(3) = r2 * s + r(3) * c;
+                            }
+                            else {
+                                cispp::MuellerRetarder::FromDelay(delay_w[k * nx + i]).ApplyRow(r);
+                            }
+                        }
+                        else 
+                        {
+                            Eigen::RowVector4d r_d = r.template cast<double>();
+                            components[stages[k].icomp]->ApplyMuellerRow(
+                                wavelength[iwl], rays_row[k].incidence_angle[i], rays_row[k].azimuthal_angle[i], r_d
+                            );
+                            r = r_d.cast<Real>();
+                        }
+                        if (k < nstages - 1) {
+                            r *= run_wl[iwl * nruns + k + 1];
+                        }
+                    }
+                    const size_t ix = tile.ix0 + i;
+                    const size_t q = polarised ? (ix % 2) + 2 * (iy % 2) : 0;
+                    const Real s0 = flux[iwl] * r.dot(col_last[iwl * ncam + q]);
+                    if (iwl > 0) {
+                        integral_w[i] += Real(0.5) * (s0_w[i] + s0) * dwl[iwl];
+                    }
+                    s0_w[i] = s0;
+                }
+            }
+            camera.Digitise(integrate ? integral_w : s0_w, n, tile.ix0 + iy * nx, opts.sensor, image_row);
         }
+    });
+}
+
+
+void Instrument::SaveImage(string fpath, vector<unsigned short int>* image)
+{
+    assert((*image).size() == camera.sensor_format_x * camera.sensor_format_y);
+    cispp::WritePGM(fpath, (*image).data(), camera.sensor_format_x, camera.sensor_format_y, camera.bit_depth);
+}
+
+
+cispp::MappedFrameStack Instrument::CreateFrameStack(const string& fpath, size_t nframes)
+{
+    return cispp::MappedFrameStack::Create(fpath, camera.sensor_format_x, camera.sensor_format_y, nframes, 
+                                           camera.bit_depth);
+}
+
+
+void Instrument::ForEachTile(const CaptureOptions& opts, const std::function<void(const cispp::Tile&, size_t)>& fn)
+{
+    vector<cispp::Tile> tiles = cispp::GetTiles(camera.sensor_format_x, camera.sensor_format_y, opts.tile_cols, opts.tile_rows);
+    GetPool(opts).ParallelFor(tiles.size(), [&](size_t itile, size_t iworker) { fn(tiles[itile], iworker); });
+}
+
+
+cispp::ThreadPool& Instrument::GetPool(const CaptureOptions& opts)
+{
+    const size_t nthreads = GetWorkerCount(opts);
+    if (!pool || pool->GetThreadCount() != nthreads) {
+        pool = std::make_unique<cispp::ThreadPool>(nthreads);
     }
+    return *pool;
+}
+
+
+size_t Instrument::GetWorkerCount(const CaptureOptions& opts)
+{
+    return (opts.nthreads == 0) ? cispp::GetHardwareThreadCount() : opts.nthreads;
 }
 
 
-void InstrumentSingleDelayLinear::Capture(vector<double>& wavelength, vector<double>& spec_flux, vector<unsigned short int>* image)
+void Instrument::Capture(double wavelength, double flux, vector<unsigned short int>* image, const CaptureOptions& opts)
 {
     assert((*image).size() == camera.sensor_format_x * camera.sensor_format_y);
-    assert(wavelength.size() == spec_flux.size());
+    Capture(wavelength, flux, (*image).data(), opts);
+}
+
+
+void Instrument::Capture(vector<double>& wavelength, vector<double>& spec_flux, vector<unsigned short int>* image, 
+                         const CaptureOptions& opts)
+{
+    assert((*image).size() == camera.sensor_format_x * camera.sensor_format_y);
+    Capture(wavelength, spec_flux, (*image).data(), opts);
+}
 
-    Eigen::Vector4d stokes_in;
-    stokes_in(1) = 0;
-    stokes_in(2) = 0;
-    stokes_in(3) = 0;
-    Eigen::Vector4d stokes_out;
-    vector<double> stokes_out0(wavelength.size(), 0.);
 
-    for (size_t iy = 0; iy < camera.sensor_format_y; iy++)
+void Instrument::Capture(double wavelength, double flux, unsigned short int* image, const CaptureOptions& opts)
+{
+    if (opts.single_precision) {
+        CaptureCompiled<float>({wavelength}, {flux}, false, image, opts);
+        return;
+    }
+    if (compiled) {
+        CaptureCompiled<double>({wavelength}, {flux}, false, image, opts);
+        return;
+    }
+
+    UpdateGeometryCache(opts);
+    
+    ForEachTile(opts, [&](const cispp::Tile& tile, size_t iworker)
     {
-        size_t icol = iy * camera.sensor_format_x;
-        double y = camera.pixel_centres_y[iy];
-        for (size_t ix = 0; ix < camera.sensor_format_x; ix++)
+        Eigen::Vector4d stokes_in;
+        Eigen::Vector4d stokes_out;
+        stokes_in << flux, 0, 0, 0;
+        vector<double> s0_row(tile.ix1 - tile.ix0);
+
+        for (size_t iy = tile.iy0; iy < tile.iy1; iy++)
         {
-            double x = camera.pixel_centres_x[ix];
-            double inc_angle = GetIncidenceAngle(x, y, components[1]);
-            double azim_angle = GetAzimuthalAngle(x, y, components[1]);
+            size_t icol = iy * camera.sensor_format_x;
             
-            for (size_t iwl=0; iwl < wavelength.size(); iwl++) 
+            for (size_t ix = tile.ix0; ix < tile.ix1; ix++)
             {
-                double wl = wavelength[iwl];
-                double delay = components[1]->GetDelay(wl, inc_angle, azim_angle); 
-                stokes_out0[iwl] = (spec_flux[iwl] / 4) * (1 + cos(delay));
+                stokes_out = GetPixelMuellerMatrix(ix, iy, wavelength) * stokes_in;
+                s0_row[ix - tile.ix0] = stokes_out[0];
             }
-            (*image)[ix + icol] = static_cast<unsigned short int>(cispp::trapz(wavelength, stokes_out0));
+            camera.Digitise(s0_row.data(), s0_row.size(), tile.ix0 + icol, opts.sensor, &image[tile.ix0 + icol]);
         }
-    }
+    });
 }
 
 
-bool InstrumentSingleDelayPixelated::TestType(const YAML::Node node)
+void Instrument::Capture(vector<double>& wavelength, vector<double>& spec_flux, unsigned short int* image, 
+                         const CaptureOptions& opts)
 {
-    vector<unique_ptr<cispp::Component>> components_test;
-    Instrument::ParseNodeComponents(node["interferometer"], components_test);
-    cispp::Camera cam = ParseNodeCamera(node["camera"]);
+    assert(wavelength.size() == spec_flux.size());
 
-    size_t n = components_test.size();
-    if (n > 2 &&
-        cam.type == "monochrome_polarised" &&
-        components_test[0]->IsIdealPolariser() && 
-        components_test[n-1]->IsIdealQuarterWaveplate() &&
-        TestAlign90(components_test[0], components_test[n-1]))
+    if (opts.single_precision) {
+        CaptureCompiled<float>(wavelength, spec_flux, true, image, opts);
+        return;
+    }
+    if (compiled) {
+        CaptureCompiled<double>(wavelength, spec_flux, true, image, opts);
+        return;
+    }
+
+    UpdateGeometryCache(opts);
+
+    // per-worker scratch
+    vector<vector<double>> stokes_out0(GetWorkerCount(opts), vector<double>(wavelength.size(), 0.));
+
+    ForEachTile(opts, [&](const cispp::Tile& tile, size_t iworker)
     {
-        size_t rcount = 0;
-        for (size_t i=1; i<n-1; i++)
+        Eigen::Vector4d stokes_in;
+        stokes_in(1) = 0;
+        stokes_in(2) = 0;
+        stokes_in(3) = 0;
+        vector<double>& s0 = stokes_out0[iworker];
+        vector<double> s0_row(tile.ix1 - tile.ix0);
+
+        for (size_t iy = tile.iy0; iy < tile.iy1; iy++)
         {
-            if (components_test[i]->IsIdealRetarder() && 
-                TestAlign45(components_test[i], components_test[0])) {
-                rcount++;
+            size_t icol = iy * camera.sensor_format_x;
+            for (size_t ix = tile.ix0; ix < tile.ix1; ix++)
+            {
+                for (size_t iwl=0; iwl < wavelength.size(); iwl++) 
+                {
+                    double wl = wavelength[iwl];
+                    stokes_in(0) = spec_flux[iwl];
+                    s0[iwl] = (GetPixelMuellerMatrix(ix, iy, wl) * stokes_in)(0);
+                }
+
+                s0_row[ix - tile.ix0] = cispp::trapz(wavelength, s0);
             }
+            camera.Digitise(s0_row.data(), s0_row.size(), tile.ix0 + icol, opts.sensor, &image[tile.ix0 + icol]);
         }
-        if (rcount == n-2) {
-            return true;
-        }
-    }
-    return false;
+    });
+}
+
+
+void Instrument::CaptureBatch(const vector<double>& wavelength, const vector<vector<double>>& spec_flux, 
+                              vector<unsigned short int>* frames, const CaptureOptions& opts)
+{
+    assert((*frames).size() >= camera.sensor_format_x * camera.sensor_format_y * spec_flux.size());
+    CaptureBatch(wavelength, spec_flux, (*frames).data(), opts);
+}
+
+
+void Instrument::CaptureBatch(const vector<vector<double>>& wavelength, const vector<vector<double>>& spec_flux, 
+                              vector<unsigned short int>* frames, const CaptureOptions& opts)
+{
+    assert((*frames).size() >= camera.sensor_format_x * camera.sensor_format_y * spec_flux.size());
+    CaptureBatch(wavelength, spec_flux, (*frames).data(), opts);
 }
 
 
-void InstrumentSingleDelayPixelated::Capture(double wavelength, double flux, vector<unsigned short int>* image)
+void Instrument::CaptureBatch(const vector<double>& wavelength, const vector<vector<double>>& spec_flux, 
+                              unsigned short int* frames, const CaptureOptions& opts)
 {
-    for (size_t j = 0; j < camera.sensor_format_y; j++)
+    vector<const vector<double>*> spec_flux_ptr;
+    vector<size_t> iframes;
+    for (size_t iframe = 0; iframe < spec_flux.size(); iframe++)
     {
-        size_t idx_col = j * camera.sensor_format_x;
-        double y = camera.pixel_centres_y[j];
-        for (size_t i = 0; i < camera.sensor_format_x; i++)
-        {
-            double x = camera.pixel_centres_x[i];
-            double inc_angle = GetIncidenceAngle(x, y, components[1]);
-            double azim_angle = GetAzimuthalAngle(x, y, components[1]);
-            double delay = components[1]->GetDelay(wavelength, inc_angle, azim_angle);
-            double mask = camera.GetPixelatedPhaseMask(x, y);
-            (*image)[i + idx_col] = static_cast<unsigned short int>((flux / 4) * (1 + cos(delay + mask)));
-        }
+        spec_flux_ptr.push_back(&spec_flux[iframe]);
+        iframes.push_back(iframe);
     }
+    CaptureBatch(wavelength, spec_flux_ptr, iframes, frames, opts);
 }
 
 
-void InstrumentSingleDelayPixelated::Capture(vector<double>& wavelength, vector<double>& spec_flux, vector<unsigned short int>* image)
+void Instrument::CaptureBatch(const vector<vector<double>>& wavelength, const vector<vector<double>>& spec_flux, 
+                              unsigned short int* frames, const CaptureOptions& opts)
 {
-    assert((*image).size() == camera.sensor_format_x * camera.sensor_format_y);
     assert(wavelength.size() == spec_flux.size());
 
-    Eigen::Vector4d stokes_in;
-    stokes_in(1) = 0;
-    stokes_in(2) = 0;
-    stokes_in(3) = 0;
-    Eigen::Vector4d stokes_out;
-    vector<double> stokes_out0(wavelength.size(), 0.);
-
-    for (size_t iy = 0; iy < camera.sensor_format_y; iy++)
+    // group frames by wavelength grid
+    vector<bool> done(wavelength.size(), false);
+    for (size_t iframe = 0; iframe < wavelength.size(); iframe++)
     {
-        size_t icol = iy * camera.sensor_format_x;
-        double y = camera.pixel_centres_y[iy];
-        for (size_t ix = 0; ix < camera.sensor_format_x; ix++)
+        if (done[iframe]) {
+            continue;
+        }
+        vector<const vector<double>*> spec_flux_ptr;
+        vector<size_t> iframes;
+        for (size_t jframe = iframe; jframe < wavelength.size(); jframe++)
         {
-            double x = camera.pixel_centres_x[ix];
-            double inc_angle = GetIncidenceAngle(x, y, components[1]);
-            double azim_angle = GetAzimuthalAngle(x, y, components[1]);
-            double mask = camera.GetPixelatedPhaseMask(x, y);
-
-            for (size_t iwl=0; iwl < wavelength.size(); iwl++) 
+            if (!done[jframe] && wavelength[jframe] == wavelength[iframe])
             {
-                double wl = wavelength[iwl];
-                double delay = components[1]->GetDelay(wl, inc_angle, azim_angle); 
-                stokes_out0[iwl] = (spec_flux[iwl] / 4) * (1 + cos(delay + mask));
+                spec_flux_ptr.push_back(&spec_flux[jframe]);
+                iframes.push_back(jframe);
+                done[jframe] = true;
             }
-            (*image)[ix + icol] = static_cast<unsigned short int>(cispp::trapz(wavelength, stokes_out0));
         }
+        CaptureBatch(wavelength[iframe], spec_flux_ptr, iframes, frames, opts);
     }
 }
 
 
-unique_ptr<cispp::Instrument> LoadInstrument(std::filesystem::path fp_config, bool force_mueller)
+void Instrument::CaptureBatch(const vector<double>& wavelength, const vector<const vector<double>*>& spec_flux, 
+                              const vector<size_t>& iframes, unsigned short int* frames, 
+                              const CaptureOptions& opts)
 {
-    const YAML::Node node = YAML::LoadFile(fp_config);
+    const size_t nwl = wavelength.size();
+    const size_t nframes = iframes.size();
 
-    if (!force_mueller && InstrumentSingleDelayLinear::TestType(node)) {
-        return std::make_unique<cispp::InstrumentSingleDelayLinear>(fp_config);
+    // frame weights: trapezoidal rule weights x spectral flux
+    WeightMatrix weights(nframes, nwl);
+    for (size_t iframe = 0; iframe < nframes; iframe++)
+    {
+        assert((*spec_flux[iframe]).size() == nwl);
+        for (size_t iwl = 0; iwl < nwl; iwl++)
+        {
+            const double dwl_lo = (iwl > 0) ? wavelength[iwl] - wavelength[iwl - 1] : 0.;
+            const double dwl_hi = (iwl + 1 < nwl) ? wavelength[iwl + 1] - wavelength[iwl] : 0.;
+            weights(iframe, iwl) = 0.5 * (dwl_lo + dwl_hi) * (*spec_flux[iframe])[iwl];
+        }
     }
+    CaptureWeighted(wavelength, weights, iframes, frames, opts);
+}
+
+
+void Instrument::CaptureQuadrature(const cispp::QuadratureGrid& grid, vector<unsigned short int>* image, 
+                                   const CaptureOptions& opts)
+{
+    assert((*image).size() == static_cast<size_t>(camera.sensor_format_x * camera.sensor_format_y));
+    CaptureQuadrature(grid, (*image).data(), opts);
+}
+
+
+void Instrument::CaptureQuadrature(const cispp::QuadratureGrid& grid, unsigned short int* image, 
+                                   const CaptureOptions& opts)
+{
+    assert(grid.wavelength.size() == grid.weight.size());
+    WeightMatrix weights = Eigen::Map<const Eigen::RowVectorXd>(grid.weight.data(), grid.weight.size());
+    CaptureWeighted(grid.wavelength, weights, {0}, image, opts);
+}
+
 
-    else if (!force_mueller && InstrumentSingleDelayPixelated::TestType(node)) {
-        return std::make_unique<cispp::InstrumentSingleDelayPixelated>(fp_config);
+void Instrument::CaptureWeighted(const vector<double>& wavelength, const WeightMatrix& weights, 
+                                 const vector<size_t>& iframes, unsigned short int* frames, const CaptureOptions& opts)
+{
+    const size_t nx = camera.sensor_format_x;
+    const size_t npix = nx * camera.sensor_format_y;
+    const size_t nwl = wavelength.size();
+    const size_t nframes = iframes.size();
+    assert(static_cast<size_t>(weights.rows()) == nframes && static_cast<size_t>(weights.cols()) == nwl);
+    if (nframes == 0) {
+        return;
     }
 
-    else {
-        return std::make_unique<cispp::Instrument>(fp_config);
+    UpdateGeometryCache(opts);
+    TransmissionRowFn get_transmission_row = GetTransmissionRowFn(wavelength, opts);
+
+    // split frames into blocks, if there are too few tiles to go round the workers
+    const size_t nworkers = GetWorkerCount(opts);
+    vector<cispp::Tile> tiles = cispp::GetTiles(nx, camera.sensor_format_y, opts.tile_cols, opts.tile_rows);
+    const size_t nblocks = std::min(nframes, std::max<size_t>(1, (4 * nworkers + tiles.size() - 1) / tiles.size()));
+    const size_t block_size = (nframes + nblocks - 1) / nblocks;
+
+    // per-worker scratch
+    vector<vector<double>> transmission(nworkers, vector<double>(nwl * nx));
+    vector<WeightMatrix> counts(nworkers);
+
+    GetPool(opts).ParallelFor(tiles.size() * nblocks, [&](size_t itask, size_t iworker)
+    {
+        const cispp::Tile& tile = tiles[itask / nblocks];
+        const size_t iframe0 = (itask % nblocks) * block_size;
+        const size_t iframe1 = std::min(iframe0 + block_size, nframes);
+        if (iframe0 >= iframe1) {
+            return;
+        }
+        const size_t n = tile.ix1 - tile.ix0;
+        double* t = transmission[iworker].data();
+
+        for (size_t iy = tile.iy0; iy < tile.iy1; iy++)
+        {
+            get_transmission_row(iy, tile.ix0, tile.ix1, iworker, t);
+            Eigen::Map<const WeightMatrix> t_row(t, nwl, n);
+            counts[iworker].noalias() = weights.middleRows(iframe0, iframe1 - iframe0) * t_row;
+
+            for (size_t iframe = iframe0; iframe < iframe1; iframe++)
+            {
+                unsigned short int* frame_row = &frames[iframes[iframe] * npix + tile.ix0 + iy * nx];
+                cispp::SensorOptions sensor = opts.sensor;
+                sensor.frame += iframes[iframe];
+                camera.Digitise(counts[iworker].row(iframe - iframe0).data(), n, tile.ix0 + iy * nx, sensor, frame_row);
+            }
+        }
+    });
+}
+
+
+Instrument::TransmissionRowFn Instrument::GetTransmissionRowFn(const vector<double>& wavelength, const CaptureOptions& opts)
+{
+    return [this, wavelength](size_t iy, size_t ix0, size_t ix1, size_t iworker, double* t) 
+    {
+        const size_t n = ix1 - ix0;
+        for (size_t iwl = 0; iwl < wavelength.size(); iwl++)
+        {
+            for (size_t ix = ix0; ix < ix1; ix++) {
+                t[iwl * n + ix - ix0] = GetPixelMuellerMatrix(ix, iy, wavelength[iwl])(0, 0);
+            }
+        }
+    };
+}
+
+
+PrecisionReport Instrument::ComparePrecision(double wavelength, double flux, const CaptureOptions& opts)
+{
+    auto capture = [&](vector<unsigned short int>* image, const CaptureOptions& opts_i) {
+        Capture(wavelength, flux, image, opts_i);
+    };
+    return ComparePrecision(capture, {wavelength}, opts);
+}
+
+
+PrecisionReport Instrument::ComparePrecision(vector<double>& wavelength, vector<double>& spec_flux, 
+                                             const CaptureOptions& opts)
+{
+    auto capture = [&](vector<unsigned short int>* image, const CaptureOptions& opts_i) {
+        Capture(wavelength, spec_flux, image, opts_i);
+    };
+    return ComparePrecision(capture, {wavelength.front(), wavelength[wavelength.size() / 2], wavelength.back()}, opts);
+}
+
+
+PrecisionReport Instrument::ComparePrecision(const std::function<void(vector<unsigned short int>*, const CaptureOptions&)>& capture, 
+                                             const vector<double>& wavelength, const CaptureOptions& opts)
+{
+    PrecisionReport report {};
+    const size_t nx = camera.sensor_format_x;
+    const size_t npix = nx * camera.sensor_format_y;
+
+    // image error
+    CaptureOptions opts_d = opts;
+    CaptureOptions opts_s = opts;
+    opts_d.single_precision = false;
+    opts_s.single_precision = true;
+    vector<unsigned short int> image_d(npix);
+    vector<unsigned short int> image_s(npix);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    capture(&image_d, opts_d);
+    auto stop = std::chrono::high_resolution_clock::now();
+    report.duration_double = std::chrono::duration<double>(stop - start).count();
+
+    start = std::chrono::high_resolution_clock::now();
+    capture(&image_s, opts_s);
+    stop = std::chrono::high_resolution_clock::now();
+    report.duration_single = std::chrono::duration<double>(stop - start).count();
+
+    for (size_t i = 0; i < npix; i++) {
+        report.max_count_error = std::max(report.max_count_error, std::abs(int(image_d[i]) - int(image_s[i])));
+    }
+
+    // phase error, as the single-precision engines evaluate it
+    const size_t nworkers = GetWorkerCount(opts);
+    vector<RayScratch> rays(nworkers, RayScratch(nx));
+    vector<RayScratchF> rays_f(nworkers, RayScratchF(nx));
+    vector<vector<double>> delay(nworkers, vector<double>(nx));
+    vector<vector<float>> ddelay(nworkers, vector<float>(nx));
+    vector<double> phase_error(nworkers, 0.);
+
+    for (size_t icomp = 0; icomp < components.size(); icomp++)
+    {
+        if (!components[icomp]->IsAngleDependent() || !components[icomp]->IsIdealRetarder()) {
+            continue;
+        }
+        unique_ptr<cispp::DelayTable> delay_table = components[icomp]->GetDelayTable(wavelength);
+        for (size_t iwl = 0; iwl < wavelength.size(); iwl++)
+        {
+            const float delay_0 = delay_table->GetDelayOnAxisReduced(iwl);
+            ForEachTile(opts, [&](const cispp::Tile& tile, size_t iworker)
+            {
+                for (size_t iy = tile.iy0; iy < tile.iy1; iy++)
+                {
+                    cispp::RayBatch rays_row = GetRayBatchRow(icomp, iy, tile.ix0, tile.ix1, rays[iworker]);
+                    delay_table->GetDelayBatch(iwl, rays_row, delay[iworker].data());
+                    delay_table->GetDelayDeviationBatch(iwl, GetRayBatchF(rays_row, rays_f[iworker]), ddelay[iworker].data());
+                    for (size_t i = 0; i < rays_row.n; i++)
+                    {
+                        const float phase = delay_0 + ddelay[iworker][i];
+                        const double err = std::abs(std::remainder(delay[iworker][i] - phase, 2 * M_PI));
+                        phase_error[iworker] = std::max(phase_error[iworker], err);
+                    }
+                }
+            });
+        }
+    }
+    report.max_phase_error = *std::max_element(phase_error.begin(), phase_error.end());
+    return report;
+}
+
+
+void InstrumentSingleDelay::Capture(double wavelength, double flux, unsigned short int* image, 
+                                    const CaptureOptions& opts)
+{
+    if (opts.single_precision) {
+        CaptureSingle({wavelength}, {flux}, false, image, opts);
+        return;
+    }
+
+    UpdateGeometryCache(opts);
+    unique_ptr<cispp::DelayTable> delay_table = components[1]->GetDelayTable({wavelength});
+
+    // per-worker scratch, one pixel row long
+    const size_t nx = camera.sensor_format_x;
+    const size_t nworkers = GetWorkerCount(opts);
+    vector<RayScratch> rays(nworkers, RayScratch(nx));
+    vector<vector<double>> delay(nworkers, vector<double>(nx)); 
+    vector<vector<double>> mask(nworkers, vector<double>(nx, 0.));  // stays zero for a linear carrier
+
+    ForEachTile(opts, [&](const cispp::Tile& tile, size_t iworker)
+    {
+        const size_t n = tile.ix1 - tile.ix0;
+        double* delay_w = delay[iworker].data();
+        double* mask_w = mask[iworker].data();
+
+        for (size_t iy = tile.iy0; iy < tile.iy1; iy++) 
+        {
+            unsigned short int* image_row = &image[tile.ix0 + iy * nx];
+            cispp::RayBatch rays_row = GetRayBatchRow(1, iy, tile.ix0, tile.ix1, rays[iworker]);
+            delay_table->GetDelayBatch(0, rays_row, delay_w);
+
+            if (pixelated) {
+                camera.GetPixelatedPhaseMaskRow(iy, tile.ix0, tile.ix1, mask_w);
+            }
+            for (size_t i = 0; i < n; i++) {
+                delay_w[i] = (flux / 4) * (1 + cos(delay_w[i] + mask_w[i]));  // delay -> signal, in place
+            }
+            camera.Digitise(delay_w, n, tile.ix0 + iy * nx, opts.sensor, image_row);
+        }
+    });
+}
+
+
+void InstrumentSingleDelay::Capture(vector<double>& wavelength, vector<double>& spec_flux, unsigned short int* image, 
+                                    const CaptureOptions& opts)
+{
+    assert(wavelength.size() == spec_flux.size());
+
+    if (opts.single_precision) {
+        CaptureSingle(wavelength, spec_flux, true, image, opts);
+        return;
+    }
+
+    const size_t nwl = wavelength.size();
+    UpdateGeometryCache(opts);
+
+    // wavelength-dependent terms, independent of pixel: refractive indices and derived delay coefficients, source 
+    // flux and integration step
+    unique_ptr<cispp::DelayTable> delay_table = components[1]->GetDelayTable(wavelength);
+    vector<double> flux_4(nwl);
+    vector<double> dwl(nwl, 0.);
+    for (size_t iwl = 0; iwl < nwl; iwl++)
+    {
+        flux_4[iwl] = spec_flux[iwl] / 4;
+        if (iwl > 0) {
+            dwl[iwl] = wavelength[iwl] - wavelength[iwl - 1];
+        }
+    }
+
+    // per-worker scratch, one pixel row long
+    const size_t nx = camera.sensor_format_x;
+    const size_t nworkers = GetWorkerCount(opts);
+    vector<RayScratch> rays(nworkers, RayScratch(nx));
+    vector<vector<double>> delay(nworkers, vector<double>(nx)); 
+    vector<vector<double>> mask(nworkers, vector<double>(nx, 0.));  // stays zero for a linear carrier
+    vector<vector<double>> stokes_out0(nworkers, vector<double>(nx));  // at the previous wavelength
+    vector<vector<double>> integral(nworkers, vector<double>(nx)); 
+
+    ForEachTile(opts, [&](const cispp::Tile& tile, size_t iworker)
+    {
+        const size_t n = tile.ix1 - tile.ix0;
+        double* delay_w = delay[iworker].data();
+        double* mask_w = mask[iworker].data();
+        double* s0_w = stokes_out0[iworker].data();
+        double* integral_w = integral[iworker].data();
+
+        for (size_t iy = tile.iy0; iy < tile.iy1; iy++)
+        {
+            // pixel-dependent terms, independent of wavelength
+            unsigned short int* image_row = &image[tile.ix0 + iy * nx];
+            cispp::RayBatch rays_row = GetRayBatchRow(1, iy, tile.ix0, tile.ix1, rays[iworker]);
+            if (pixelated) {
+                camera.GetPixelatedPhaseMaskRow(iy, tile.ix0, tile.ix1, mask_w);
+            }
+            std::fill(integral_w, integral_w + n, 0.);
+
+            // trapezoidal rule, accumulated a wavelength at a time in the same order as cispp::trapz
+            for (size_t iwl = 0; iwl < nwl; iwl++)
+            {
+                delay_table->GetDelayBatch(iwl, rays_row, delay_w);
+                for (size_t i = 0; i < n; i++)
+                {
+                    const double s0 = flux_4[iwl] * (1 + cos(delay_w[i] + mask_w[i]));
+                    if (iwl > 0) {
+                        integral_w[i] += 0.5 * (s0_w[i] + s0) * dwl[iwl];
+                    }
+                    s0_w[i] = s0;
+                }
+            }
+            camera.Digitise(integral_w, n, tile.ix0 + iy * nx, opts.sensor, image_row);
+        }
+    });
+}
+
+
+Instrument::TransmissionRowFn InstrumentSingleDelay::GetTransmissionRowFn(const vector<double>& wavelength, 
+                                                                         const CaptureOptions& opts)
+{
+    // shared between copies of the returned function
+    struct State
+    {
+        unique_ptr<cispp::DelayTable> delay_table;
+        vector<RayScratch> rays;
+        vector<vector<double>> delay;
+        vector<vector<double>> mask;
+    };
+    const size_t nx = camera.sensor_format_x;
+    const size_t nworkers = GetWorkerCount(opts);
+    auto state = std::make_shared<State>();
+    state->delay_table = components[1]->GetDelayTable(wavelength);
+    state->rays.assign(nworkers, RayScratch(nx));
+    state->delay.assign(nworkers, vector<double>(nx));
+    state->mask.assign(nworkers, vector<double>(nx, 0.));  // stays zero for a linear carrier
+
+    return [this, state](size_t iy, size_t ix0, size_t ix1, size_t iworker, double* t) 
+    {
+        const size_t n = ix1 - ix0;
+        double* delay_w = state->delay[iworker].data();
+        double* mask_w = state->mask[iworker].data();
+        cispp::RayBatch rays_row = GetRayBatchRow(1, iy, ix0, ix1, state->rays[iworker]);
+        if (pixelated) {
+            camera.GetPixelatedPhaseMaskRow(iy, ix0, ix1, mask_w);
+        }
+        for (size_t iwl = 0; iwl < state->delay_table->wavelength.size(); iwl++)
+        {
+            state->delay_table->GetDelayBatch(iwl, rays_row, delay_w);
+            for (size_t i = 0; i < n; i++) {
+                t[iwl * n + i] = 0.25 * (1 + cos(delay_w[i] + mask_w[i]));
+            }
+        }
+    };
+}
+
+
+void InstrumentSingleDelay::CaptureSingle(const vector<double>& wavelength, const vector<double>& spec_flux, bool integrate, 
+                                          unsigned short int* image, const CaptureOptions& opts)
+{
+    const size_t nwl = integrate ? wavelength.size() : 1;
+    UpdateGeometryCache(opts);
+
+    // wavelength-dependent terms, independent of pixel: the on-axis delay reduced modulo 2 pi in double precision, 
+    // source flux and integration step
+    unique_ptr<cispp::DelayTable> delay_table = components[1]->GetDelayTable(
+        vector<double>(wavelength.begin(), wavelength.begin() + nwl)
+    );
+    vector<float> delay_0(nwl);
+    vector<float> flux_4(nwl);
+    vector<float> dwl(nwl, 0.f);
+    for (size_t iwl = 0; iwl < nwl; iwl++)
+    {
+        delay_0[iwl] = delay_table->GetDelayOnAxisReduced(iwl);
+        flux_4[iwl] = spec_flux[iwl] / 4;
+        if (iwl > 0) {
+            dwl[iwl] = wavelength[iwl] - wavelength[iwl - 1];
+        }
+    }
+
+    // per-worker scratch, one pixel row long
+    const size_t nx = camera.sensor_format_x;
+    const size_t nworkers = GetWorkerCount(opts);
+    vector<RayScratch> rays(nworkers, RayScratch(nx));
+    vector<RayScratchF> rays_f(nworkers, RayScratchF(nx));
+    vector<vector<float>> ddelay(nworkers, vector<float>(nx)); 
+    vector<vector<double>> mask(nworkers, vector<double>(nx, 0.));  // stays zero for a linear carrier
+    vector<vector<float>> mask_f(nworkers, vector<float>(nx, 0.f));
+    vector<vector<float>> stokes_out0(nworkers, vector<float>(nx));  // at the previous wavelength
+    vector<vector<float>> integral(nworkers, vector<float>(nx)); 
+
+    ForEachTile(opts, [&](const cispp::Tile& tile, size_t iworker)
+    {
+        const size_t n = tile.ix1 - tile.ix0;
+        float* ddelay_w = ddelay[iworker].data();
+        float* mask_w = mask_f[iworker].data();
+        float* s0_w = stokes_out0[iworker].data();
+        float* integral_w = integral[iworker].data();
+
+        for (size_t iy = tile.iy0; iy < tile.iy1; iy++)
+        {
+            unsigned short int* image_row = &image[tile.ix0 + iy * nx];
+            cispp::RayBatchF rays_row = GetRayBatchF(GetRayBatchRow(1, iy, tile.ix0, tile.ix1, rays[iworker]), rays_f[iworker]);
+            if (pixelated) 
+            {
+                camera.GetPixelatedPhaseMaskRow(iy, tile.ix0, tile.ix1, mask[iworker].data());
+                for (size_t i = 0; i < n; i++) {
+                    mask_w[i] = static_cast<float>(mask[iworker][i]);
+                }
+            }
+            std::fill(integral_w, integral_w + n, 0.f);
+
+            for (size_t iwl = 0; iwl < nwl; iwl++)
+            {
+                delay_table->GetDelayDeviationBatch(iwl, rays_row, ddelay_w);
+                for (size_t i = 0; i < n; i++)
+                {
+                    const float s0 = flux_4[iwl] * (1 + std::cos(delay_0[iwl] + ddelay_w[i] + mask_w[i]));
+                    if (iwl > 0) {
+                        integral_w[i] += 0.5f * (s0_w[i] + s0) * dwl[iwl];
+                    }
+                    s0_w[i] = s0;
+                }
+            }
+            camera.Digitise(integrate ? integral_w : s0_w, n, tile.ix0 + iy * nx, opts.sensor, image_row);
+        }
+    });
+}
+
+
+void InstrumentSingleDelay::GetDelayMap(double wavelength, vector<double>* delay, const CaptureOptions& opts)
+{
+    assert((*delay).size() == static_cast<size_t>(camera.sensor_format_x * camera.sensor_format_y));
+
+    UpdateGeometryCache(opts);
+    unique_ptr<cispp::DelayTable> delay_table = components[1]->GetDelayTable({wavelength});
+
+    const size_t nx = camera.sensor_format_x;
+    vector<RayScratch> rays(GetWorkerCount(opts), RayScratch(nx));
+
+    ForEachTile(opts, [&](const cispp::Tile& tile, size_t iworker)
+    {
+        for (size_t iy = tile.iy0; iy < tile.iy1; iy++) 
+        {
+            cispp::RayBatch rays_row = GetRayBatchRow(1, iy, tile.ix0, tile.ix1, rays[iworker]);
+            delay_table->GetDelayBatch(0, rays_row, &(*delay)[tile.ix0 + iy * nx]);
+        }
+    });
+}
+
+
+double InstrumentSingleDelay::GetCoherenceReference(const vector<double>& wavelength, const vector<double>& spec_flux, 
+                                                   CoherenceCaptureReport* report)
+{
+    const size_t nwl = wavelength.size();
+    vector<double> wl_spec_flux(nwl);
+    for (size_t iwl = 0; iwl < nwl; iwl++) {
+        wl_spec_flux[iwl] = wavelength[iwl] * spec_flux[iwl];
+    }
+    const double flux = cispp::trapz(wavelength, spec_flux);
+    if (flux == 0) {
+        // no mean wavelength to expand about
+        report->wavelength_ref = 0;
+        report->kappa = 0;
+        return flux;
+    }
+    const double wl0 = cispp::trapz(wavelength, wl_spec_flux) / flux;
+    const double dwl = 1.e-10;
+    const double b = wl0 * components[1]->GetDelay(wl0, 0, 0);
+    const double b_p = (wl0 + dwl) * components[1]->GetDelay(wl0 + dwl, 0, 0);
+    const double b_m = (wl0 - dwl) * components[1]->GetDelay(wl0 - dwl, 0, 0);
+    report->wavelength_ref = wl0;
+    report->kappa = (b == 0) ? 0. : 1 - (wl0 / b) * (b_p - b_m) / (2 * dwl);
+    return flux;
+}
+
+
+void InstrumentSingleDelay::CaptureDark(unsigned short int* image, const CaptureOptions& opts)
+{
+    const size_t nx = camera.sensor_format_x;
+    vector<double> signal(nx, 0.);
+    ForEachTile(opts, [&](const cispp::Tile& tile, size_t iworker)
+    {
+        for (size_t iy = tile.iy0; iy < tile.iy1; iy++) {
+            camera.Digitise(signal.data(), tile.ix1 - tile.ix0, tile.ix0 + iy * nx, opts.sensor, &image[tile.ix0 + iy * nx]);
+        }
+    });
+}
+
+
+void InstrumentSingleDelay::SampleCoherenceError(vector<double>& wavelength, vector<double>& spec_flux, 
+                                                 const vector<double>& delay, 
+                                                 const std::function<double(double, double)>& get_intensity, 
+                                                 size_t nsamples_x, CoherenceCaptureReport* report)
+{
+    if (nsamples_x == 0) {
+        return;
+    }
+    const size_t nwl = wavelength.size();
+    const size_t nx = camera.sensor_format_x;
+    const size_t ny = camera.sensor_format_y;
+    unique_ptr<cispp::DelayTable> delay_table = components[1]->GetDelayTable(wavelength);
+    RayScratch rays(1);
+    vector<double> s0(nwl);
+    double err2_sum = 0;
+    for (size_t jy = 0; jy < nsamples_x; jy++)
+    {
+        const size_t iy = (ny - 1) * jy / std::max<size_t>(nsamples_x - 1, 1);
+        for (size_t jx = 0; jx < nsamples_x; jx++)
+        {
+            const size_t ix = (nx - 1) * jx / std::max<size_t>(nsamples_x - 1, 1);
+            double mask_i = 0, delay_i;
+            if (pixelated) {
+                camera.GetPixelatedPhaseMaskRow(iy, ix, ix + 1, &mask_i);
+            }
+            cispp::RayBatch ray = GetRayBatchRow(1, iy, ix, ix + 1, rays);
+            for (size_t iwl = 0; iwl < nwl; iwl++) 
+            {
+                delay_table->GetDelayBatch(iwl, ray, &delay_i);
+                s0[iwl] = (spec_flux[iwl] / 4) * (1 + cos(delay_i + mask_i));
+            }
+            const double err = std::abs(get_intensity(delay[ix + iy * nx], mask_i) - cispp::trapz(wavelength, s0));
+            report->error_max = std::max(report->error_max, err);
+            err2_sum += err * err;
+            report->nsamples++;
+        }
+    }
+    report->error_rms = sqrt(err2_sum / report->nsamples);
+}
+
+
+CoherenceCaptureReport InstrumentSingleDelay::CaptureCoherence(vector<double>& wavelength, vector<double>& spec_flux, 
+                                                               vector<unsigned short int>* image, 
+                                                               const CaptureOptions& opts, size_t nsamples_x)
+{
+    assert((*image).size() == static_cast<size_t>(camera.sensor_format_x * camera.sensor_format_y));
+    assert(wavelength.size() == spec_flux.size());
+
+    const size_t nwl = wavelength.size();
+    const size_t nx = camera.sensor_format_x;
+    const size_t ny = camera.sensor_format_y;
+    CoherenceCaptureReport report {};
+
+    // reference wavelength and group delay / phase delay ratio, from the delay along the optical axis
+    const double flux = GetCoherenceReference(wavelength, spec_flux, &report);
+    if (flux == 0) {
+        CaptureDark(image->data(), opts);
+        return report;
+    }
+    const double wl0 = report.wavelength_ref;
+    const double kappa = report.kappa;
+
+    // delay at wl0 at every pixel, and its range
+    vector<double> delay(nx * ny);
+    GetDelayMap(wl0, &delay, opts);
+    auto minmax = std::minmax_element(delay.begin(), delay.end());
+    const double delay_ref = 0.5 * (*minmax.first + *minmax.second);
+    const double ddelay_max = 0.5 * (*minmax.second - *minmax.first);
+    report.delay_ref = delay_ref;
+
+    // coherence envelope g(tau) = int spec_flux * exp(i * tau * xi) dwl, with xi = (wl0 - wl) / wl, and its 
+    // derivative, at the reference delay
+    vector<double> xi_spec_flux(nwl);
+    vector<double> xi2_spec_flux(nwl);
+    for (size_t iwl = 0; iwl < nwl; iwl++)
+    {
+        const double xi = (wl0 - wavelength[iwl]) / wavelength[iwl];
+        xi_spec_flux[iwl] = xi * spec_flux[iwl];
+        xi2_spec_flux[iwl] = xi * xi * spec_flux[iwl];
+    }
+    const double tau_ref = kappa * delay_ref;
+    const std::complex<double> phase_ref = std::exp(std::complex<double>(0, -tau_ref));
+    const std::complex<double> g_ref = phase_ref * cispp::calculate_coherence(wavelength, spec_flux, tau_ref, wl0);
+    const std::complex<double> dg_ref = std::complex<double>(0, 1) * phase_ref * 
+                                        cispp::calculate_coherence(wavelength, xi_spec_flux, tau_ref, wl0);
+    report.error_bound = cispp::trapz(wavelength, xi2_spec_flux) * pow(kappa * ddelay_max, 2) / 8;
+
+    auto get_intensity = [&](double delay_i, double mask_i) {
+        const std::complex<double> g = g_ref + (kappa * delay_i - tau_ref) * dg_ref;
+        return (flux + std::real(std::exp(std::complex<double>(0, delay_i + mask_i)) * g)) / 4;
+    };
+
+    vector<vector<double>> mask(GetWorkerCount(opts), vector<double>(nx, 0.));  // stays zero for a linear carrier
+    vector<vector<double>> signal(GetWorkerCount(opts), vector<double>(nx));
+    ForEachTile(opts, [&](const cispp::Tile& tile, size_t iworker)
+    {
+        double* mask_w = mask[iworker].data();
+        double* signal_w = signal[iworker].data();
+        for (size_t iy = tile.iy0; iy < tile.iy1; iy++) 
+        {
+            if (pixelated) {
+                camera.GetPixelatedPhaseMaskRow(iy, tile.ix0, tile.ix1, mask_w);
+            }
+            for (size_t ix = tile.ix0; ix < tile.ix1; ix++) 
+            {
+                const size_t i = ix + iy * nx;
+                signal_w[ix - tile.ix0] = get_intensity(delay[i], mask_w[ix - tile.ix0]);
+            }
+            camera.Digitise(signal_w, tile.ix1 - tile.ix0, tile.ix0 + iy * nx, opts.sensor, &(*image)[tile.ix0 + iy * nx]);
+        }
+    });
+
+    // error with respect to the full spectral integral, on a grid of sampled pixels
+    SampleCoherenceError(wavelength, spec_flux, delay, get_intensity, nsamples_x, &report);
+    return report;
+}
+
+
+CoherenceCaptureReport InstrumentSingleDelay::CaptureCoherenceTable(vector<double>& wavelength, 
+                                                                    vector<double>& spec_flux, 
+                                                                    vector<unsigned short int>* image, 
+                                                                    double max_error, const CaptureOptions& opts, 
+                                                                    size_t nsamples_x)
+{
+    assert((*image).size() == static_cast<size_t>(camera.sensor_format_x * camera.sensor_format_y));
+    assert(wavelength.size() == spec_flux.size());
+    if (!(max_error > 0)) {
+        throw std::invalid_argument("max_error must be positive");
+    }
+
+    const size_t nwl = wavelength.size();
+    const size_t nx = camera.sensor_format_x;
+    const size_t ny = camera.sensor_format_y;
+    CoherenceCaptureReport report {};
+
+    // stage 1: delay at wl0 at every pixel, from the geometry only
+    const double flux = GetCoherenceReference(wavelength, spec_flux, &report);
+    if (flux == 0) {
+        CaptureDark(image->data(), opts);
+        return report;
+    }
+    const double wl0 = report.wavelength_ref;
+    const double kappa = report.kappa;
+    vector<double> delay(nx * ny);
+    GetDelayMap(wl0, &delay, opts);
+    auto minmax = std::minmax_element(delay.begin(), delay.end());
+    report.delay_ref = 0.5 * (*minmax.first + *minmax.second);
+
+    // stage 2: tabulate the coherence envelope g(tau) = int spec_flux * exp(i * tau * xi) dwl, xi = (wl0 - wl) / wl, 
+    // over the range of tau = kappa * delay. |g''| <= m2 = int spec_flux * xi^2 dwl, so linear interpolation with step 
+    // h is within m2 * h^2 / 8 of g, and the intensity (1/4 of the real part) within m2 * h^2 / 32.
+    vector<double> xi2_spec_flux(nwl);
+    for (size_t iwl = 0; iwl < nwl; iwl++)
+    {
+        const double xi = (wl0 - wavelength[iwl]) / wavelength[iwl];
+        xi2_spec_flux[iwl] = xi * xi * spec_flux[iwl];
+    }
+    const double m2 = cispp::trapz(wavelength, xi2_spec_flux);
+    const double tau_min = std::min(kappa * *minmax.first, kappa * *minmax.second);
+    const double tau_max = std::max(kappa * *minmax.first, kappa * *minmax.second);
+    size_t ntable = 2;
+    if (m2 > 0) {
+        ntable = std::max<size_t>(static_cast<size_t>(std::ceil((tau_max - tau_min) / sqrt(32 * max_error / m2))) + 1, 2);
+    }
+    const double h = (tau_max > tau_min) ? (tau_max - tau_min) / (ntable - 1) : 1.;
+    report.error_bound = m2 * h * h / 32;
+
+    vector<std::complex<double>> table(ntable);
+    cispp::CoherenceEvaluator evaluator(wavelength, spec_flux, wl0);
+    evaluator.EvaluateUniform(tau_min, h, ntable, table.data());
+    vector<double> g_re(ntable), g_im(ntable);
+    for (size_t j = 0; j < ntable; j++) 
+    {
+        // remove the carrier, exp(i tau), leaving the slowly-varying envelope
+        const std::complex<double> g = std::exp(std::complex<double>(0, -(tau_min + j * h))) * table[j];
+        g_re[j] = std::real(g);
+        g_im[j] = std::imag(g);
+    }
+
+    auto get_intensity = [&](double delay_i, double mask_i) 
+    {
+        const double t = std::min(std::max((kappa * delay_i - tau_min) / h, 0.), ntable - 1.);
+        const size_t j = std::min(static_cast<size_t>(t), ntable - 2);
+        const double w = t - j;
+        const double gr = g_re[j] + w * (g_re[j + 1] - g_re[j]);
+        const double gi = g_im[j] + w * (g_im[j + 1] - g_im[j]);
+        const double phase = delay_i + mask_i;
+        return (flux + cos(phase) * gr - sin(phase) * gi) / 4;
+    };
+
+    vector<vector<double>> mask(GetWorkerCount(opts), vector<double>(nx, 0.));  // stays zero for a linear carrier
+    vector<vector<double>> signal(GetWorkerCount(opts), vector<double>(nx));
+    ForEachTile(opts, [&](const cispp::Tile& tile, size_t iworker)
+    {
+        double* mask_w = mask[iworker].data();
+        double* signal_w = signal[iworker].data();
+        for (size_t iy = tile.iy0; iy < tile.iy1; iy++) 
+        {
+            if (pixelated) {
+                camera.GetPixelatedPhaseMaskRow(iy, tile.ix0, tile.ix1, mask_w);
+            }
+            const double* delay_row = &delay[tile.ix0 + iy * nx];
+            for (size_t i = 0; i < tile.ix1 - tile.ix0; i++) {
+                signal_w[i] = get_intensity(delay_row[i], mask_w[i]);
+            }
+            camera.Digitise(signal_w, tile.ix1 - tile.ix0, tile.ix0 + iy * nx, opts.sensor, &(*image)[tile.ix0 + iy * nx]);
+        }
+    });
+
+    SampleCoherenceError(wavelength, spec_flux, delay, get_intensity, nsamples_x, &report);
+    return report;
+}
+
+
+bool InstrumentSingleDelayLinear::TestType(const YAML::Node node)
+{
+    vector<unique_ptr<cispp::Component>> components_test;
+    Instrument::ParseNodeComponents(node["interferometer"], components_test);
+    return TestType(ParseNodeCamera(node["camera"]), components_test);
+}
+
+
+bool InstrumentSingleDelayLinear::TestType(const cispp::Camera& cam, 
+                                          const vector<unique_ptr<cispp::Component>>& components_test)
+{
+    size_t n = components_test.size();
+    if (n > 2 &&
+        cam.type == "monochrome" &&
+        components_test[0]->IsIdealPolariser() && 
+        components_test[n-1]->IsIdealPolariser() &&
+        TestAlign90(components_test[0], components_test[n-1]))
+    {
+        size_t rcount = 0;
+        for (size_t i=1; i<n-1; i++)
+        {
+            if (components_test[i]->IsIdealRetarder() && 
+                TestAlign45(components_test[i], components_test[0])) 
+            {
+                rcount++;
+            }
+        }
+        if (rcount == n-2) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+bool InstrumentSingleDelayPixelated::TestType(const YAML::Node node)
+{
+    vector<unique_ptr<cispp::Component>> components_test;
+    Instrument::ParseNodeComponents(node["interferometer"], components_test);
+    return TestType(ParseNodeCamera(node["camera"]), components_test);
+}
+
+
+bool InstrumentSingleDelayPixelated::TestType(const cispp::Camera& cam, 
+                                             const vector<unique_ptr<cispp::Component>>& components_test)
+{
+    size_t n = components_test.size();
+    if (n > 2 &&
+        cam.type == "monochrome_polarised" &&
+        components_test[0]->IsIdealPolariser() && 
+        components_test[n-1]->IsIdealQuarterWaveplate() &&
+        TestAlign90(components_test[0], components_test[n-1]))
+    {
+        size_t rcount = 0;
+        for (size_t i=1; i<n-1; i++)
+        {
+            if (components_test[i]->IsIdealRetarder() && 
+                TestAlign45(components_test[i], components_test[0])) {
+                rcount++;
+            }
+        }
+        if (rcount == n-2) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+vector<Eigen::Matrix4d> InstrumentReduced::GetCameraMueller(cispp::Camera& camera)
+{
+    vector<Eigen::Matrix4d> camera_mueller;
+    if (camera.type == "monochrome_polarised")
+    {
+        for (size_t q = 0; q < 4; q++) {
+            camera_mueller.push_back(camera.GetMuellerMatrix(camera.pixel_centres_x[q % 2], camera.pixel_centres_y[q / 2]));
+        }
+    }
+    return camera_mueller;
+}
+
+
+bool InstrumentReduced::TestType(const cispp::Camera& camera, const vector<unique_ptr<cispp::Component>>& components)
+{
+    cispp::Camera cam = camera;
+    cispp::TransferFunction transfer_test;
+    return cispp::ReduceInterferometer(components, GetCameraMueller(cam), &transfer_test);
+}
+
+
+bool InstrumentReduced::UpdateTransferFunction()
+{
+    bool current = (camera_type == camera.type && orientation.size() == components.size());
+    for (size_t i = 0; current && i < components.size(); i++) {
+        current = (orientation[i] == components[i]->orientation);
+    }
+    if (!current)
+    {
+        reduced = cispp::ReduceInterferometer(components, GetCameraMueller(camera), &transfer);
+        camera_type = camera.type;
+        orientation.clear();
+        for (const unique_ptr<cispp::Component>& component : components) {
+            orientation.push_back(component->orientation);
+        }
+    }
+    return reduced;
+}
+
+
+const cispp::TransferFunction* InstrumentReduced::GetTransferFunction()
+{
+    return UpdateTransferFunction() ? &transfer : nullptr;
+}
+
+
+void InstrumentReduced::GetTransmissionRow(const vector<unique_ptr<cispp::DelayTable>>& delay_tables, size_t nwl, 
+                                           size_t iy, size_t ix0, size_t ix1, RowScratch& scratch, double* t)
+{
+    const size_t n = ix1 - ix0;
+    const size_t ndelays = transfer.icomp.size();
+    for (size_t k = 0; k < ndelays; k++)
+    {
+        scratch.rays_row[k] = GetRayBatchRow(transfer.icomp[k], iy, ix0, ix1, scratch.rays[k]);
+        scratch.delay_row[k] = &scratch.delay[k * n];
+    }
+    if (transfer.GetVariantCount() > 1)
+    {
+        for (size_t i = 0; i < n; i++) {
+            scratch.variant[i] = static_cast<uint8_t>(((ix0 + i) % 2) + 2 * (iy % 2));
+        }
+    }
+    for (size_t iwl = 0; iwl < nwl; iwl++)
+    {
+        for (size_t k = 0; k < ndelays; k++) {
+            delay_tables[k]->GetDelayBatch(iwl, scratch.rays_row[k], &scratch.delay[k * n]);
+        }
+        transfer.EvaluateBatch(scratch.delay_row.data(), scratch.variant.data(), n, scratch.kernel.data(), &t[iwl * n]);
+    }
+}
+
+
+void InstrumentReduced::Capture(double wavelength, double flux, unsigned short int* image, const CaptureOptions& opts)
+{
+    if (opts.single_precision || !UpdateTransferFunction()) {
+        Instrument::Capture(wavelength, flux, image, opts);
+        return;
+    }
+
+    UpdateGeometryCache(opts);
+    vector<unique_ptr<cispp::DelayTable>> delay_tables;
+    for (size_t icomp : transfer.icomp) {
+        delay_tables.push_back(components[icomp]->GetDelayTable({wavelength}));
+    }
+
+    // per-worker scratch, one pixel row long
+    const size_t nx = camera.sensor_format_x;
+    const size_t nworkers = GetWorkerCount(opts);
+    vector<RowScratch> scratch(nworkers, RowScratch(transfer.icomp.size(), nx));
+    vector<vector<double>> signal(nworkers, vector<double>(nx));
+
+    ForEachTile(opts, [&](const cispp::Tile& tile, size_t iworker)
+    {
+        const size_t n = tile.ix1 - tile.ix0;
+        double* signal_w = signal[iworker].data();
+        for (size_t iy = tile.iy0; iy < tile.iy1; iy++)
+        {
+            GetTransmissionRow(delay_tables, 1, iy, tile.ix0, tile.ix1, scratch[iworker], signal_w);
+            for (size_t i = 0; i < n; i++) {
+                signal_w[i] *= flux;
+            }
+            camera.Digitise(signal_w, n, tile.ix0 + iy * nx, opts.sensor, &image[tile.ix0 + iy * nx]);
+        }
+    });
+}
+
+
+void InstrumentReduced::Capture(vector<double>& wavelength, vector<double>& spec_flux, unsigned short int* image, 
+                                const CaptureOptions& opts)
+{
+    assert(wavelength.size() == spec_flux.size());
+
+    if (opts.single_precision || !UpdateTransferFunction()) {
+        Instrument::Capture(wavelength, spec_flux, image, opts);
+        return;
+    }
+
+    const size_t nwl = wavelength.size();
+    UpdateGeometryCache(opts);
+    vector<unique_ptr<cispp::DelayTable>> delay_tables;
+    for (size_t icomp : transfer.icomp) {
+        delay_tables.push_back(components[icomp]->GetDelayTable(wavelength));
+    }
+    vector<double> dwl(nwl, 0.);
+    for (size_t iwl = 1; iwl < nwl; iwl++) {
+        dwl[iwl] = wavelength[iwl] - wavelength[iwl - 1];
+    }
+
+    // per-worker scratch, one pixel row long
+    const size_t nx = camera.sensor_format_x;
+    const size_t nworkers = GetWorkerCount(opts);
+    vector<RowScratch> scratch(nworkers, RowScratch(transfer.icomp.size(), nx));
+    vector<vector<double>> transmission(nworkers, vector<double>(nwl * nx));
+    vector<vector<double>> integral(nworkers, vector<double>(nx));
+
+    ForEachTile(opts, [&](const cispp::Tile& tile, size_t iworker)
+    {
+        const size_t n = tile.ix1 - tile.ix0;
+        double* t = transmission[iworker].data();
+        double* integral_w = integral[iworker].data();
+        for (size_t iy = tile.iy0; iy < tile.iy1; iy++)
+        {
+            GetTransmissionRow(delay_tables, nwl, iy, tile.ix0, tile.ix1, scratch[iworker], t);
+
+            // trapezoidal rule, accumulated a wavelength at a time in the same order as cispp::trapz
+            std::fill(integral_w, integral_w + n, 0.);
+            for (size_t iwl = 1; iwl < nwl; iwl++)
+            {
+                for (size_t i = 0; i < n; i++)
+                {
+                    const double s0_lo = spec_flux[iwl - 1] * t[(iwl - 1) * n + i];
+                    const double s0_hi = spec_flux[iwl] * t[iwl * n + i];
+                    integral_w[i] += 0.5 * (s0_lo + s0_hi) * dwl[iwl];
+                }
+            }
+            camera.Digitise(integral_w, n, tile.ix0 + iy * nx, opts.sensor, &image[tile.ix0 + iy * nx]);
+        }
+    });
+}
+
+
+Instrument::TransmissionRowFn InstrumentReduced::GetTransmissionRowFn(const vector<double>& wavelength, 
+                                                                     const CaptureOptions& opts)
+{
+    if (!UpdateTransferFunction()) {
+        return Instrument::GetTransmissionRowFn(wavelength, opts);
+    }
+
+    // shared between copies of the returned function
+    struct State
+    {
+        vector<unique_ptr<cispp::DelayTable>> delay_tables;
+        vector<RowScratch> scratch;
+    };
+    auto state = std::make_shared<State>();
+    for (size_t icomp : transfer.icomp) {
+        state->delay_tables.push_back(components[icomp]->GetDelayTable(wavelength));
+    }
+    state->scratch.assign(GetWorkerCount(opts), RowScratch(transfer.icomp.size(), camera.sensor_format_x));
+    const size_t nwl = wavelength.size();
+
+    return [this, state, nwl](size_t iy, size_t ix0, size_t ix1, size_t iworker, double* t) {
+        GetTransmissionRow(state->delay_tables, nwl, iy, ix0, ix1, state->scratch[iworker], t);
+    };
+}
+
+
+unique_ptr<cispp::Instrument> LoadInstrument(std::filesystem::path fp_config, bool force_mueller)
+{
+    InstrumentConfig config = Instrument::ParseConfig(fp_config);
+    const string type = force_mueller ? "mueller" : ClassifyInstrument(config);
+    return MakeInstrument(std::move(config), type);
+}
+
+
+string ClassifyInstrument(const InstrumentConfig& config)
+{
+    if (InstrumentSingleDelayLinear::TestType(config.camera, config.components)) {
+        return "single_delay_linear";
+    }
+    else if (InstrumentSingleDelayPixelated::TestType(config.camera, config.components)) {
+        return "single_delay_pixelated";
+    }
+    else if (InstrumentReduced::TestType(config.camera, config.components)) {
+        return "reduced";
+    }
+    else {
+        return "mueller";
+    }
+}
+
+
+unique_ptr<cispp::Instrument> MakeInstrument(InstrumentConfig config, const string& type)
+{
+    if (type == "single_delay_linear") {
+        return std::make_unique<cispp::InstrumentSingleDelayLinear>(std::move(config));
+    }
+    else if (type == "single_delay_pixelated") {
+        return std::make_unique<cispp::InstrumentSingleDelayPixelated>(std::move(config));
+    }
+    else if (type == "reduced") {
+        return std::make_unique<cispp::InstrumentReduced>(std::move(config));
+    }
+    else if (type == "mueller") {
+        return std::make_unique<cispp::Instrument>(std::move(config));
+    }
+    else {
+        throw std::logic_error("invalid instrument type: " + type);
+    }
+}
+
+
+namespace {
+
+
+constexpr char snapshot_magic[8] = {'C', 'I', 'S', 'P', 'P', 'I', 'S', '\0'};
+constexpr uint32_t snapshot_version = 1;
+constexpr bool host_little_endian = (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__);
+
+
+/**
+ * @brief Component kinds in a snapshot
+ */
+enum class SnapshotComponent : uint32_t
+{
+    Polariser = 0,
+    QuarterWaveplate = 1,
+    HalfWaveplate = 2,
+    UniaxialCrystal = 3,
+};
+
+
+/**
+ * @brief Appends snapshot fields to a byte buffer
+ */
+class SnapshotWriter
+{
+    public:
+
+    std::string bytes;
+
+    template <typename T>
+    void Put(T value)
+    {
+        static_assert(std::is_arithmetic_v<T>, "snapshot fields are numbers, strings or arrays");
+        bytes.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    void Put(const string& value)
+    {
+        Put<uint64_t>(value.size());
+        bytes.append(value);
+    }
+
+    void Put(const vector<double>& value)
+    {
+        Put<uint64_t>(value.size());
+        bytes.append(reinterpret_cast<const char*>(value.data()), value.size() * sizeof(double));
+    }
+};
+
+
+/**
+ * @brief Reads snapshot fields from a byte buffer, throwing if the buffer ends early
+ */
+class SnapshotReader
+{
+    public:
+
+    SnapshotReader(const std::string& bytes, const string& fpath)
+    : pos(bytes.data()),
+      end(bytes.data() + bytes.size()),
+      fpath(fpath)
+    {}
+
+    template <typename T>
+    T Get()
+    {
+        T value;
+        std::memcpy(&value, Take(sizeof(T)), sizeof(T));
+        return value;
+    }
+
+    string GetString()
+    {
+        const uint64_t n = Get<uint64_t>();
+        return string(Take(n), n);
+    }
+
+    vector<double> GetArray()
+    {
+        const uint64_t n = Get<uint64_t>();
+        const char* p = Take((n <= static_cast<uint64_t>(end - pos) / sizeof(double)) ? n * sizeof(double) : UINT64_MAX);
+        vector<double> value(n);
+        std::memcpy(value.data(), p, n * sizeof(double));
+        return value;
+    }
+
+    void Skip(uint64_t n)
+    {
+        Take(n);
+    }
+
+    private:
+
+    const char* pos;
+    const char* end;
+    const string& fpath;
+
+    const char* Take(uint64_t n)
+    {
+        if (n > static_cast<uint64_t>(end - pos)) {
+            throw std::runtime_error("Truncated instrument snapshot '" + fpath + "'");
+        }
+        const char* p = pos;
+        pos += n;
+        return p;
+    }
+};
+
+
+} // namespace
+
+
+void Instrument::SaveSnapshot(const string& fpath, bool include_geometry)
+{
+    if (!host_little_endian) {
+        throw std::runtime_error("Instrument snapshots need a little-endian host.");
+    }
+    SnapshotWriter w;
+    w.bytes.append(snapshot_magic, sizeof(snapshot_magic));
+    w.Put<uint32_t>(snapshot_version);
+    w.Put(type);
+    w.Put(fp_config);
+    w.Put(lens_1_focal_length);
+    w.Put(lens_2_focal_length);
+    w.Put(lens_3_focal_length);
+
+    w.Put<int32_t>(camera.sensor_format_x);
+    w.Put<int32_t>(camera.sensor_format_y);
+    w.Put(camera.pixel_size);
+    w.Put<int32_t>(camera.bit_depth);
+    w.Put(camera.quantum_efficiency);
+    w.Put(camera.epercount);
+    w.Put(camera.cam_noise);
+    w.Put(camera.type);
+
+    w.Put<uint64_t>(components.size());
+    for (const unique_ptr<cispp::Component>& component : components)
+    {
+        const cispp::Component* c = component.get();
+        if (auto crystal = dynamic_cast<const cispp::UniaxialCrystal*>(c))
+        {
+            w.Put<uint32_t>(static_cast<uint32_t>(SnapshotComponent::UniaxialCrystal));
+            w.Put(c->orientation);
+            w.Put(c->tilt_x);
+            w.Put(c->tilt_y);
+            w.Put(crystal->thickness);
+            w.Put(crystal->cut_angle);
+            w.Put(crystal->material.name);
+            w.Put(crystal->material.source);
+            w.Put(crystal->material.sellmeier_e);
+            w.Put(crystal->material.sellmeier_o);
+            continue;
+        }
+        SnapshotComponent kind;
+        if (dynamic_cast<const cispp::QuarterWaveplate*>(c)) {
+            kind = SnapshotComponent::QuarterWaveplate;
+        }
+        else if (dynamic_cast<const cispp::HalfWaveplate*>(c)) {
+            kind = SnapshotComponent::HalfWaveplate;
+        }
+        else if (dynamic_cast<const cispp::Polariser*>(c)) {
+            kind = SnapshotComponent::Polariser;
+        }
+        else {
+            throw std::logic_error("Interferometer component cannot be saved to a snapshot.");
+        }
+        w.Put<uint32_t>(static_cast<uint32_t>(kind));
+        w.Put(c->orientation);
+        w.Put(c->tilt_x);
+        w.Put(c->tilt_y);
+    }
+
+    if (include_geometry)
+    {
+        const bool use_geometry_cache_prev = use_geometry_cache;
+        use_geometry_cache = true;
+        UpdateGeometryCache(CaptureOptions());
+        use_geometry_cache = use_geometry_cache_prev;
+    }
+    w.Put<uint8_t>(include_geometry);
+    if (include_geometry)
+    {
+        for (const ComponentGeometry& geom : geometry_cache)
+        {
+            w.Put<int32_t>(geom.sensor_format_x);
+            w.Put<int32_t>(geom.sensor_format_y);
+            w.Put(geom.pixel_size);
+            w.Put(geom.lens_3_focal_length);
+            w.Put(geom.orientation);
+            w.Put(geom.tilt_x);
+            w.Put(geom.tilt_y);
+            w.Put(geom.incidence_angle);
+            w.Put(geom.azimuthal_angle);
+            w.Put(geom.sin_inc);
+            w.Put(geom.sin_azim);
+            w.Put(geom.cos_azim);
+        }
+        if (!use_geometry_cache) {
+            geometry_cache.clear();
+        }
+    }
+
+    std::ofstream file(fpath, std::ios::binary | std::ios::trunc);
+    file.write(w.bytes.data(), w.bytes.size());
+    if (!file) {
+        throw std::runtime_error("Could not write instrument snapshot '" + fpath + "'");
+    }
+}
+
+
+unique_ptr<cispp::Instrument> LoadInstrumentSnapshot(const string& fpath)
+{
+    if (!host_little_endian) {
+        throw std::runtime_error("Instrument snapshots need a little-endian host.");
+    }
+    std::ifstream file(fpath, std::ios::binary | std::ios::ate);
+    if (!file) {
+        throw std::runtime_error("Could not open instrument snapshot '" + fpath + "'");
+    }
+    std::string bytes(static_cast<size_t>(file.tellg()), '\0');
+    file.seekg(0);
+    if (!file.read(bytes.data(), bytes.size())) {
+        throw std::runtime_error("Could not read instrument snapshot '" + fpath + "'");
+    }
+
+    if (bytes.compare(0, sizeof(snapshot_magic), snapshot_magic, sizeof(snapshot_magic)) != 0) {
+        throw std::runtime_error("Not an instrument snapshot: '" + fpath + "'");
+    }
+    SnapshotReader r(bytes, fpath);
+    r.Skip(sizeof(snapshot_magic));
+    const uint32_t version = r.Get<uint32_t>();
+    if (version != snapshot_version) {
+        throw std::runtime_error("Unsupported instrument snapshot version " + std::to_string(version) + " in '" + 
+                                 fpath + "'");
+    }
+    const string type = r.GetString();
+
+    InstrumentConfig config;
+    config.fp_config = r.GetString();
+    config.lens_1_focal_length = r.Get<double>();
+    config.lens_2_focal_length = r.Get<double>();
+    config.lens_3_focal_length = r.Get<double>();
+
+    const int sensor_format_x = r.Get<int32_t>();
+    const int sensor_format_y = r.Get<int32_t>();
+    const double pixel_size = r.Get<double>();
+    const int bit_depth = r.Get<int32_t>();
+    const double quantum_efficiency = r.Get<double>();
+    const double epercount = r.Get<double>();
+    const double cam_noise = r.Get<double>();
+    const string camera_type = r.GetString();
+    config.camera = cispp::Camera(sensor_format_x, sensor_format_y, pixel_size, bit_depth, quantum_efficiency, 
+                                  epercount, cam_noise, camera_type);
+
+    const uint64_t ncomponents = r.Get<uint64_t>();
+    for (uint64_t icomp = 0; icomp < ncomponents; icomp++)
+    {
+        const SnapshotComponent kind = static_cast<SnapshotComponent>(r.Get<uint32_t>());
+        const double orientation = r.Get<double>();
+        const double tilt_x = r.Get<double>();
+        const double tilt_y = r.Get<double>();
+        switch (kind)
+        {
+            case SnapshotComponent::Polariser:
+                config.components.push_back(std::make_unique<cispp::Polariser>(orientation, tilt_x, tilt_y));
+                break;
+            case SnapshotComponent::QuarterWaveplate:
+                config.components.push_back(std::make_unique<cispp::QuarterWaveplate>(orientation, tilt_x, tilt_y));
+                break;
+            case SnapshotComponent::HalfWaveplate:
+                config.components.push_back(std::make_unique<cispp::HalfWaveplate>(orientation, tilt_x, tilt_y));
+                break;
+            case SnapshotComponent::UniaxialCrystal:
+            {
+                const double thickness = r.Get<double>();
+                const double cut_angle = r.Get<double>();
+                MaterialProperties mp = {};
+                mp.name = r.GetString();
+                mp.source = r.GetString();
+                mp.sellmeier_e = r.GetArray();
+                mp.sellmeier_o = r.GetArray();
+                config.components.push_back(std::make_unique<cispp::UniaxialCrystal>(
+                    orientation, tilt_x, tilt_y, thickness, cut_angle, mp));
+                break;
+            }
+            default:
+                throw std::runtime_error("Unknown component in instrument snapshot '" + fpath + "'");
+        }
+    }
+
+    unique_ptr<cispp::Instrument> inst = MakeInstrument(std::move(config), type);
+    if (r.Get<uint8_t>())
+    {
+        inst->use_geometry_cache = true;
+        inst->geometry_cache.resize(ncomponents);
+        for (ComponentGeometry& geom : inst->geometry_cache)
+        {
+            geom.sensor_format_x = r.Get<int32_t>();
+            geom.sensor_format_y = r.Get<int32_t>();
+            geom.pixel_size = r.Get<double>();
+            geom.lens_3_focal_length = r.Get<double>();
+            geom.orientation = r.Get<double>();
+            geom.tilt_x = r.Get<double>();
+            geom.tilt_y = r.Get<double>();
+            geom.incidence_angle = r.GetArray();
+            geom.azimuthal_angle = r.GetArray();
+            geom.sin_inc = r.GetArray();
+            geom.sin_azim = r.GetArray();
+            geom.cos_azim = r.GetArray();
+        }
     }
+    return inst;
 }
 
 
@@ -1,132 +1,557 @@
 #include "include/material.h"
 
+#include <algorithm>
 #include <cmath>
+#include <complex>
 #include <cstdlib>
 #include <filesystem>
 #include <stdexcept>
 #include <string>
+#include <type_traits>
 
 #include "yaml-cpp/yaml.h"
 
+#ifdef CISPP_EMBED_MATERIALS
+#include "material_data.h"
+#endif
+
 namespace cispp {
 
-MaterialProperties GetMaterialProperties(std::string material_name)
+MaterialRegistry::MaterialRegistry()
+#ifdef CISPP_EMBED_MATERIALS
+: embedded(true)
+#endif
+{}
+
+
+MaterialRegistry::MaterialRegistry(std::filesystem::path fpath)
+: fpath(fpath)
+{}
+
+
+MaterialRegistry::~MaterialRegistry() = default;
+
+
+MaterialRegistry& MaterialRegistry::Instance()
+{
+    static MaterialRegistry registry;
+    return registry;
+}
+
+
+void MaterialRegistry::Parse()
+{
+    if (data) {
+        return;
+    }
+#ifdef CISPP_EMBED_MATERIALS
+    if (embedded) 
+    {
+        data = std::make_unique<YAML::Node>(YAML::Load(cispp::embedded_material_yaml));
+        return;
+    }
+#endif
+    if (fpath.empty())
+    {
+        const char* root = std::getenv("CISPP_ROOT");
+        if (!root) {
+            throw std::runtime_error("CISPP_ROOT is not set, so the material database cannot be found");
+        }
+        fpath = std::filesystem::path(root) / "data" / "material.yaml";
+    }
+    data = std::make_unique<YAML::Node>(YAML::LoadFile(fpath));
+}
+
+
+const std::vector<MaterialProperties>& MaterialRegistry::Load(const std::string& material_name)
 {
-    MaterialProperties mp = {};
-    mp.name = material_name;
-    
-    std::filesystem::path filePath = std::getenv("CISPP_ROOT");
-    filePath /= "data";
-    filePath /= "material.yaml";
-    YAML::Node data = YAML::LoadFile(filePath);
-    //std::filesystem::path implicitly convertable to std::basic_string
+    auto it = cache.find(material_name);
+    if (it != cache.end()) {
+        return it->second;
+    }
+    Parse();
 
-    if (!data[material_name]["sellmeier_coefficients"]){
-        throw std::logic_error("invalid material_name");
+    const YAML::Node& root = *data;  // const, so that lookups of missing names do not add them
+    const YAML::Node material = root[material_name];
+    const YAML::Node coefs = material ? material["sellmeier_coefficients"] : YAML::Node();
+    if (!coefs || !coefs.IsSequence() || coefs.size() == 0) {
+        throw std::logic_error("invalid material_name: " + material_name);
     }
 
-    std::string alphabet = "ABCDEF";
-    for (int i=0; i<alphabet.size(); i++)
+    // each entry is a map holding the source name (with no value) and the coefficients Ae, Ao, Be, Bo, ...
+    std::vector<MaterialProperties> entries;
+    const std::string alphabet = "ABCDEF";
+    for (const YAML::Node& entry : coefs)
     {
-        std::string key(1, alphabet[i]);
-        if (data[material_name]["sellmeier_coefficients"][0][key + "e"])
+        MaterialProperties mp = {};
+        mp.name = material_name;
+        for (auto kv = entry.begin(); kv != entry.end(); ++kv)
         {
-            mp.sellmeier_e.push_back(data[material_name]["sellmeier_coefficients"][0][key + "e"].as<double>());
-            mp.sellmeier_o.push_back(data[material_name]["sellmeier_coefficients"][0][key + "o"].as<double>());
+            if (kv->second.IsNull()) {
+                mp.source = kv->first.as<std::string>();
+            }
         }
-    }   
-    return mp;
+        for (size_t i = 0; i < alphabet.size(); i++)
+        {
+            std::string key(1, alphabet[i]);
+            if (entry[key + "e"])
+            {
+                mp.sellmeier_e.push_back(entry[key + "e"].as<double>());
+                mp.sellmeier_o.push_back(entry[key + "o"].as<double>());
+            }
+        }
+        entries.push_back(mp);
+    }
+    return cache.emplace(material_name, std::move(entries)).first->second;
 }
 
 
-std::pair<double, double> GetRefractiveIndices(double wavelength, MaterialProperties &mp)
+MaterialProperties MaterialRegistry::Get(const std::string& material_name)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return Load(material_name)[0];
+}
+
+
+MaterialProperties MaterialRegistry::Get(const std::string& material_name, const std::string& source)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const MaterialProperties& mp : Load(material_name))
+    {
+        if (mp.source == source) {
+            return mp;
+        }
+    }
+    throw std::logic_error("invalid Sellmeier source '" + source + "' for material " + material_name);
+}
+
+
+std::vector<std::string> MaterialRegistry::GetSources(const std::string& material_name)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<std::string> sources;
+    for (const MaterialProperties& mp : Load(material_name)) {
+        sources.push_back(mp.source);
+    }
+    return sources;
+}
+
+
+std::vector<std::string> MaterialRegistry::GetMaterialNames()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Parse();
+    std::vector<std::string> names;
+    for (auto kv = data->begin(); kv != data->end(); ++kv) {
+        names.push_back(kv->first.as<std::string>());
+    }
+    return names;
+}
+
+
+MaterialProperties GetMaterialProperties(std::string material_name)
+{
+    return MaterialRegistry::Instance().Get(material_name);
+}
+
+
+MaterialProperties GetMaterialProperties(const std::string& material_name, const std::string& source)
+{
+    return MaterialRegistry::Instance().Get(material_name, source);
+}
+
+
+/**
+ * @brief SellmeierEvaluator<N> from a material's coefficients
+ */
+template <size_t N>
+static SellmeierEvaluator<N> MakeSellmeierEvaluator(const MaterialProperties& mp)
+{
+    SellmeierEvaluator<N> evaluator;
+    for (size_t i = 0; i < N; i++)
+    {
+        evaluator.e[i] = mp.sellmeier_e[i];
+        evaluator.o[i] = mp.sellmeier_o[i];
+    }
+    return evaluator;
+}
+
+
+DispersionModel MakeDispersionModel(const MaterialProperties& mp)
 {
-    const size_t nce = mp.sellmeier_e.size();
-    const size_t nco = mp.sellmeier_o.size();
-    const double wl_um2 = pow(wavelength * 1e6, 2); 
-    assert (nce == nco);
-    double ne, no;
-    
-    switch(nce)
+    if (mp.sellmeier_e.size() != mp.sellmeier_o.size()) {
+        throw std::logic_error("extraordinary and ordinary Sellmeier coefficients differ in number");
+    }
+    switch(mp.sellmeier_e.size())
     {
         case 4:
-            ne = SellmeierEqn(
-                wl_um2, 
-                mp.sellmeier_e[0], 
-                mp.sellmeier_e[1], 
-                mp.sellmeier_e[2], 
-                mp.sellmeier_e[3]
-            );
-            no = SellmeierEqn(
-                wl_um2, 
-                mp.sellmeier_o[0], 
-                mp.sellmeier_o[1], 
-                mp.sellmeier_o[2], 
-                mp.sellmeier_o[3]
-            );
-            break;
-        
+            return MakeSellmeierEvaluator<4>(mp);
         case 5:
-            ne = SellmeierEqn(
-                wl_um2, 
-                mp.sellmeier_e[0], 
-                mp.sellmeier_e[1], 
-                mp.sellmeier_e[2], 
-                mp.sellmeier_e[3],
-                mp.sellmeier_e[4]
-            );
-            no = SellmeierEqn(
-                wl_um2, 
-                mp.sellmeier_o[0], 
-                mp.sellmeier_o[1], 
-                mp.sellmeier_o[2], 
-                mp.sellmeier_o[3],
-                mp.sellmeier_o[4]
-            );
-            break;
-        
+            return MakeSellmeierEvaluator<5>(mp);
         case 6:
-            ne = SellmeierEqn(
-                wl_um2, 
-                mp.sellmeier_e[0], 
-                mp.sellmeier_e[1], 
-                mp.sellmeier_e[2], 
-                mp.sellmeier_e[3],
-                mp.sellmeier_e[4],
-                mp.sellmeier_e[5]
-            );
-            no = SellmeierEqn(
-                wl_um2, 
-                mp.sellmeier_o[0], 
-                mp.sellmeier_o[1], 
-                mp.sellmeier_o[2], 
-                mp.sellmeier_o[3],
-                mp.sellmeier_o[4],
-                mp.sellmeier_o[5]
-            );
-            break;
-
+            return MakeSellmeierEvaluator<6>(mp);
         default:
             throw std::logic_error("input not understood");
     }
-    return std::pair<double, double>(ne, no);
+}
+
+
+std::pair<double, double> GetRefractiveIndices(double wavelength, MaterialProperties &mp)
+{
+    return std::visit([wavelength](const auto& model) { return model(wavelength); }, MakeDispersionModel(mp));
 }
 
 
 double GetKappa(double wavelength, cispp::MaterialProperties &mp)
 {
-    const double dwl = 1.e-10;
+    return GetKappa(wavelength, MakeDispersionModel(mp));
+}
+
+
+double GetKappa(double wavelength, const DispersionModel& model)
+{
+    return std::visit([wavelength](const auto& m) 
+    {
+        if constexpr (std::is_base_of_v<ChebyshevBand, std::decay_t<decltype(m)>>) {
+            return m.Kappa(wavelength);
+        }
+        else 
+        {
+            const double dwl = 1.e-10;
+            std::pair<double, double> neno = m(wavelength);
+            std::pair<double, double> neno_p = m(wavelength + dwl);
+            std::pair<double, double> neno_m = m(wavelength - dwl);
+
+            double biref = neno.first - neno.second;
+            double biref_p = neno_p.first - neno_p.second;
+            double biref_m = neno_m.first - neno_m.second;
+            double biref_deriv = (biref_p - biref_m) / (2 * dwl);
+
+            return 1 - (wavelength / biref) * biref_deriv;
+        }
+    }, model);
+}
+
+
+const ChebyshevBand* GetChebyshevBand(const DispersionModel& model)
+{
+    return std::visit([](const auto& m) -> const ChebyshevBand* 
+    {
+        if constexpr (std::is_base_of_v<ChebyshevBand, std::decay_t<decltype(m)>>) {
+            return &m;
+        }
+        else {
+            return nullptr;
+        }
+    }, model);
+}
+
+
+/**
+ * @brief Chebyshev coefficients of the degree-m interpolant through values at the extreme points x_j = cos(pi j / m)
+ */
+static std::vector<double> GetChebyshevCoefficients(const std::vector<double>& f)
+{
+    const size_t m = f.size() - 1;
+    std::vector<double> c(m + 1);
+    for (size_t k = 0; k <= m; k++)
+    {
+        double sum = 0.5 * (f[0] + ((k % 2 == 0) ? f[m] : -f[m]));
+        for (size_t j = 1; j < m; j++) {
+            sum += f[j] * cos(M_PI * ((j * k) % (2 * m)) / m);
+        }
+        c[k] = 2 * sum / m;
+    }
+    c[0] *= 0.5;
+    c[m] *= 0.5;
+    return c;
+}
 
-    std::pair<double, double> neno = GetRefractiveIndices(wavelength, mp);
-    std::pair<double, double> neno_p = GetRefractiveIndices(wavelength + dwl, mp);
-    std::pair<double, double> neno_m = GetRefractiveIndices(wavelength - dwl, mp);
-    
-    double biref = neno.first - neno.second;
-    double biref_p = neno_p.first - neno_p.second;
-    double biref_m = neno_m.first - neno_m.second;
-    double biref_deriv = (biref_p - biref_m) / (2 * dwl);
 
-    return 1 - (wavelength / biref) * biref_deriv;
+/**
+ * @brief Chebyshev coefficients of the derivative (with respect to x) of an expansion
+ */
+static std::vector<double> GetChebyshevDerivative(const std::vector<double>& c)
+{
+    const size_t n = c.size() - 1;
+    std::vector<double> d(n + 1, 0.);
+    for (size_t k = n; k > 0; k--) {
+        d[k - 1] = ((k + 1 <= n) ? d[k + 1] : 0.) + 2 * k * c[k];
+    }
+    d[0] *= 0.5;
+    if (n > 0) {
+        d.pop_back();
+    }
+    return d;
+}
+
+
+/**
+ * @brief A Sellmeier equation as partial fractions, n^2 = a + b w + sum_i r_i / (w - p_i), with w the wavelength in 
+ * microns, squared
+ */
+struct SellmeierFractions
+{
+    double a;
+    double b;
+    std::vector<std::pair<double, double>> terms;  // (r_i, p_i)
+};
+
+
+template <size_t N>
+static SellmeierFractions GetSellmeierFractions(const std::array<double, N>& c)
+{
+    if constexpr (N == 4) {
+        return {c[0], c[3], {{c[1], -c[2]}}};
+    }
+    else if constexpr (N == 5) {
+        return {c[0], 0, {{c[1], -c[2]}, {c[3], -c[4]}}};
+    }
+    else {
+        // B w / (w - C) = B + B C / (w - C)
+        return {1 + c[0] + c[2] + c[4], 0, {{c[0] * c[1], c[1]}, {c[2] * c[3], c[3]}, {c[4] * c[5], c[5]}}};
+    }
+}
+
+
+/**
+ * @brief n^2 from a Sellmeier equation, continued to complex x, where wavelength = wl_c + hw x maps the band to 
+ * x in [-1, 1]
+ */
+struct BandSellmeier
+{
+    SellmeierFractions fractions;
+    double wl_c;  // band centre (metres)
+    double hw;    // band half width (metres)
+    std::vector<std::pair<std::complex<double>, std::complex<double>>> poles;  // per term, the two x with w = p_i
+
+    BandSellmeier(const SellmeierFractions& fractions, double wl_c, double hw)
+    : fractions(fractions), wl_c(wl_c), hw(hw)
+    {
+        for (const std::pair<double, double>& term : fractions.terms)
+        {
+            const std::complex<double> s = 1e-6 * sqrt(std::complex<double>(term.second));
+            poles.push_back({(s - wl_c) / hw, (-s - wl_c) / hw});
+        }
+    }
+
+    std::complex<double> IndexSquared(std::complex<double> x) const
+    {
+        const std::complex<double> w = pow(1e6 * (wl_c + hw * x), 2);
+        std::complex<double> f = fractions.a + fractions.b * w;
+        for (const std::pair<double, double>& term : fractions.terms) {
+            f += term.first / (w - term.second);
+        }
+        return f;
+    }
+
+    /**
+     * @brief Bound on |d(n^2)/dx| over the disc of radius r about x, or infinity if the disc reaches a pole. With 
+     * w - p_i = 1e12 hw^2 (x - x1)(x - x2), each term's derivative is bounded by the distances to its poles.
+     */
+    double DerivativeBound(std::complex<double> x, double r) const
+    {
+        double bound = std::abs(fractions.b) * 2e12 * hw * (std::abs(wl_c + hw * x) + hw * r);
+        for (size_t i = 0; i < poles.size(); i++)
+        {
+            const double d1 = std::abs(x - poles[i].first) - r;
+            const double d2 = std::abs(x - poles[i].second) - r;
+            if (!(d1 > 0 && d2 > 0)) {
+                return INFINITY;
+            }
+            bound += std::abs(fractions.terms[i].first) / (1e12 * hw * hw) * (1 / (d1 * d1 * d2) + 1 / (d1 * d2 * d2));
+        }
+        return bound;
+    }
+};
+
+
+template <size_t N>
+static std::vector<BandSellmeier> GetBandSellmeier(const SellmeierEvaluator<N>& model, double wl_c, double hw)
+{
+    return {BandSellmeier(GetSellmeierFractions<N>(model.e), wl_c, hw), 
+            BandSellmeier(GetSellmeierFractions<N>(model.o), wl_c, hw)};
+}
+
+
+template <size_t N>
+static std::vector<BandSellmeier> GetBandSellmeier(const ChebyshevDispersion<N>&, double, double)
+{
+    throw std::invalid_argument("MakeChebyshevDispersion: the error bound needs a Sellmeier model");
+}
+
+
+/**
+ * @brief Parameter rho of the Bernstein ellipse, with foci -1 and 1, through x
+ */
+static double GetEllipseParameter(std::complex<double> x)
+{
+    const double rho = std::abs(x + sqrt(x - 1.) * sqrt(x + 1.));
+    return std::max(rho, 1 / rho);
+}
+
+
+/**
+ * @brief Bound M on |ne| and |no| on the Bernstein ellipse of parameter rho, or infinity if none is found
+ * 
+ * The ellipse is sampled at equal steps in its angle parameter, so that every point on it lies within r of a sample, 
+ * and n^2 on each disc of radius r is bounded with DerivativeBound. The samples are doubled until the discs are 
+ * resolved. If Re(n^2) > 0 on the ellipse, it is positive inside it too (Re(n^2) is harmonic), so n = sqrt(n^2) is 
+ * analytic inside and |n| <= M on it.
+ */
+static double GetEllipseBound(const std::vector<BandSellmeier>& models, double rho)
+{
+    const double a = 0.5 * (rho + 1 / rho);  // semi-major axis, which bounds |dx/dangle|
+    for (size_t nsample = 64; nsample <= (1 << 16); nsample *= 2)
+    {
+        const double r = a * M_PI / nsample;
+        double f_max = 0;
+        bool resolved = true;
+        for (size_t j = 0; j < nsample && resolved; j++)
+        {
+            const std::complex<double> u = std::polar(rho, 2 * M_PI * j / nsample);
+            const std::complex<double> x = 0.5 * (u + 1. / u);
+            for (const BandSellmeier& m : models)
+            {
+                const std::complex<double> f = m.IndexSquared(x);
+                if (!(f.real() > 0)) {
+                    return INFINITY;  // no finer sampling helps
+                }
+                const double df = r * m.DerivativeBound(x, r);
+                if (!(f.real() > df))
+                {
+                    resolved = false;
+                    break;
+                }
+                f_max = std::max(f_max, std::abs(f) + df);
+            }
+        }
+        if (resolved) {
+            return sqrt(f_max);
+        }
+    }
+    return INFINITY;
+}
+
+
+/**
+ * @brief ChebyshevDispersion<N> from the model's indices at the degree-2N Chebyshev extreme points, truncated to 
+ * degree N
+ */
+template <size_t N>
+static ChebyshevDispersion<N> MakeChebyshevDispersion(const ChebyshevBand& band, const std::vector<double>& fe, 
+                                                      const std::vector<double>& fo)
+{
+    const std::vector<double> ce = GetChebyshevCoefficients(fe);
+    const std::vector<double> co = GetChebyshevCoefficients(fo);
+    std::vector<double> cb(N + 1);
+    for (size_t k = 0; k <= N; k++) {
+        cb[k] = ce[k] - co[k];
+    }
+    const std::vector<double> dcb = GetChebyshevDerivative(cb);
+    const double dx_dwl = 2 / (band.wl_max - band.wl_min);
+
+    ChebyshevDispersion<N> cheb;
+    static_cast<ChebyshevBand&>(cheb) = band;
+    for (size_t k = 0; k <= N; k++)
+    {
+        cheb.ce[k] = ce[k];
+        cheb.co[k] = co[k];
+        cheb.cb[k] = cb[k];
+    }
+    for (size_t k = 0; k < N; k++) {
+        cheb.dcb[k] = dcb[k] * dx_dwl;
+    }
+    return cheb;
+}
+
+
+DispersionModel MakeChebyshevDispersion(const DispersionModel& model, double wl_min, double wl_max, double tol)
+{
+    if (!(wl_max > wl_min)) {
+        throw std::invalid_argument("MakeChebyshevDispersion: need wl_max > wl_min");
+    }
+    const double wl_c = 0.5 * (wl_max + wl_min);
+    const double hw = 0.5 * (wl_max - wl_min);
+    const double dx_dwl = 1 / hw;
+    const std::vector<BandSellmeier> models = std::visit(
+        [wl_c, hw](const auto& m) { return GetBandSellmeier(m, wl_c, hw); }, model);
+
+    // candidate ellipses, spaced geometrically up to the nearest pole: a larger ellipse gives faster decay of the 
+    // bound with degree, a smaller one a smaller M
+    double rho_max = 1e8;
+    for (const BandSellmeier& m : models)
+    {
+        for (const std::pair<std::complex<double>, std::complex<double>>& pole : m.poles) {
+            rho_max = std::min({rho_max, GetEllipseParameter(pole.first), GetEllipseParameter(pole.second)});
+        }
+    }
+    if (!(rho_max > 1)) {
+        throw std::invalid_argument("MakeChebyshevDispersion: the band contains a pole of the Sellmeier equation");
+    }
+    std::vector<std::pair<double, double>> ellipses;  // (rho, M)
+    for (size_t i = 1; i < 16; i++)
+    {
+        const double rho = pow(rho_max, i / 16.);
+        const double M = GetEllipseBound(models, rho);
+        if (std::isfinite(M)) {
+            ellipses.push_back({rho, M});
+        }
+    }
+    if (ellipses.empty()) {
+        throw std::runtime_error("MakeChebyshevDispersion: could not bound the Sellmeier equation around the band");
+    }
+
+    // the coefficients of n are bounded by |a_k| <= 2 M rho^-k. Truncating the degree-2n interpolant to degree n drops 
+    // the terms k > n, and the interpolant's aliasing adds the terms k >= 3n onto k <= n.
+    size_t n = 4;
+    double error = INFINITY, error_deriv = INFINITY;
+    for (; ; n *= 2)
+    {
+        error = INFINITY;
+        error_deriv = INFINITY;
+        for (const std::pair<double, double>& ellipse : ellipses)
+        {
+            const double rho = ellipse.first;
+            const double M = ellipse.second;
+            const double alias = 4 * M * pow(rho, 1 - 3. * n) / (rho - 1);
+            error = std::min(error, 2 * M * pow(rho, -1. * n) / (rho - 1) + alias);
+            // d(ne - no)/dwl takes the terms of both indices, with |T_k'| <= k^2 and sum_{k > n} k^2 q^k in closed form
+            const double q = 1 / rho;
+            const double tail = pow(q, n + 1) * ((n + 1.) * (n + 1.) / (1 - q) + 2 * (n + 1.) * q / pow(1 - q, 2) + 
+                                                 q * (1 + q) / pow(1 - q, 3));
+            error_deriv = std::min(error_deriv, 2 * (2 * M * tail + 1. * n * n * alias) * dx_dwl);
+        }
+        if (error <= tol || n == 64) {
+            break;
+        }
+    }
+
+    // interpolate at degree 2n and truncate to degree n
+    const size_t m = 2 * n;
+    std::vector<double> fe(m + 1), fo(m + 1);
+    for (size_t j = 0; j <= m; j++)
+    {
+        const double x = cos(M_PI * j / m);
+        const double wl = (j == 0) ? wl_max : (j == m) ? wl_min : wl_c + hw * x;
+        std::pair<double, double> neno = std::visit([wl](const auto& mod) { return mod(wl); }, model);
+        fe[j] = neno.first;
+        fo[j] = neno.second;
+    }
+    ChebyshevBand band {wl_min, wl_max, n, error, error_deriv};
+    switch (n)
+    {
+        case 4:
+            return MakeChebyshevDispersion<4>(band, fe, fo);
+        case 8:
+            return MakeChebyshevDispersion<8>(band, fe, fo);
+        case 16:
+            return MakeChebyshevDispersion<16>(band, fe, fo);
+        case 32:
+            return MakeChebyshevDispersion<32>(band, fe, fo);
+        default:
+            return MakeChebyshevDispersion<64>(band, fe, fo);
+    }
 }
 
 
@@ -142,7 +567,7 @@ double GetKappa(double wavelength, cispp::MaterialProperties &mp)
  */
 double SellmeierEqn(double wl_um2, double A, double B, double C, double D)
 {
-    return sqrt(A + (B / (wl_um2 + C)) + (D * wl_um2));
+    return SellmeierEvaluator<4>::Index(wl_um2, {A, B, C, D});
 }
 
 
@@ -159,7 +584,7 @@ double SellmeierEqn(double wl_um2, double A, double B, double C, double D)
  */
 double SellmeierEqn(double wl_um2, double A, double B, double C, double D, double E)
 {
-    return sqrt(A + (B / (wl_um2 + C)) + (D / (wl_um2 + E)));
+    return SellmeierEvaluator<5>::Index(wl_um2, {A, B, C, D, E});
 }
 
 
@@ -177,7 +602,7 @@ double SellmeierEqn(double wl_um2, double A, double B, double C, double D, doubl
  */
 double SellmeierEqn(double wl_um2, double A, double B, double C, double D, double E, double F)
 {
-    return sqrt((A * wl_um2 / (wl_um2 - B)) + (C * wl_um2 / (wl_um2 - D)) + (E * wl_um2 / (wl_um2 - F)) + 1);
+    return SellmeierEvaluator<6>::Index(wl_um2, {A, B, C, D, E, F});
 }
 
 
@@ -0,0 +1,132 @@
+#include "include/parallel.h"
+
+#include <algorithm>
+
+
+namespace cispp {
+
+
+std::vector<Tile> GetTiles(size_t nx, size_t ny, size_t tile_cols, size_t tile_rows)
+{
+    if (tile_cols == 0 || tile_cols > nx) {
+        tile_cols = nx;
+    }
+    if (tile_rows == 0 || tile_rows > ny) {
+        tile_rows = ny;
+    }
+    std::vector<Tile> tiles;
+    for (size_t iy0 = 0; iy0 < ny; iy0 += tile_rows)
+    {
+        for (size_t ix0 = 0; ix0 < nx; ix0 += tile_cols)
+        {
+            tiles.push_back({ix0, std::min(ix0 + tile_cols, nx), iy0, std::min(iy0 + tile_rows, ny)});
+        }
+    }
+    return tiles;
+}
+
+
+size_t GetHardwareThreadCount()
+{
+    return std::max<size_t>(1, std::thread::hardware_concurrency());
+}
+
+
+ThreadPool::ThreadPool(size_t nthreads)
+{
+    if (nthreads == 0) {
+        nthreads = GetHardwareThreadCount();
+    }
+    for (size_t i = 1; i < nthreads; i++) {
+        workers.emplace_back(&ThreadPool::WorkerLoop, this, i);
+    }
+}
+
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stop = true;
+    }
+    cv_start.notify_all();
+    for (std::thread& t : workers) {
+        t.join();
+    }
+}
+
+
+void ThreadPool::ParallelFor(size_t ntasks, const std::function<void(size_t, size_t)>& fn)
+{
+    if (ntasks == 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock_call(mtx_call);
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        job = &fn;
+        job_ntasks = ntasks;
+        next_task = 0;
+        error = nullptr;
+        nbusy = workers.size();
+        generation++;
+    }
+    cv_start.notify_all();
+
+    RunTasks(0);
+
+    std::unique_lock<std::mutex> lock(mtx);
+    cv_done.wait(lock, [this] { return nbusy == 0; });
+    job = nullptr;
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+
+void ThreadPool::WorkerLoop(size_t iworker)
+{
+    size_t generation_seen = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            cv_start.wait(lock, [&] { return stop || generation != generation_seen; });
+            if (stop) {
+                return;
+            }
+            generation_seen = generation;
+        }
+        RunTasks(iworker);
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            nbusy--;
+        }
+        cv_done.notify_one();
+    }
+}
+
+
+void ThreadPool::RunTasks(size_t iworker)
+{
+    while (true)
+    {
+        size_t itask = next_task.fetch_add(1);
+        if (itask >= job_ntasks) {
+            return;
+        }
+        try {
+            (*job)(itask, iworker);
+        }
+        catch (...) {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (!error) {
+                error = std::current_exception();
+            }
+            next_task = job_ntasks;  // abandon remaining tasks
+        }
+    }
+}
+
+
+} // namespace cispp
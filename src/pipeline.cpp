@@ -0,0 +1,137 @@
+#include "include/pipeline.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+
+namespace cispp {
+
+
+FramePipeline::FramePipeline(size_t frame_size, size_t queue_depth)
+: queue_depth(std::max<size_t>(queue_depth, 1)),
+  buffers(std::max<size_t>(queue_depth, 1) + 1, std::vector<unsigned short int>(frame_size))
+{}
+
+
+PipelineStats FramePipeline::Run(size_t nframes, const CaptureFn& capture, const WriteFn& write)
+{
+    using clock = std::chrono::steady_clock;
+    auto seconds = [](clock::duration d) { 
+        return std::chrono::duration<double>(d).count(); 
+    };
+
+    PipelineStats stats;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        free_buffers.clear();
+        for (size_t ibuf = 0; ibuf < buffers.size(); ibuf++) {
+            free_buffers.push_back(ibuf);
+        }
+        queue.clear();
+        capture_done = false;
+        stop = false;
+        error = nullptr;
+    }
+
+    const clock::time_point start = clock::now();
+    std::thread writer(&FramePipeline::WriterLoop, this, std::cref(write), std::ref(stats));
+
+    for (size_t iframe = 0; iframe < nframes; iframe++)
+    {
+        // wait for room in the queue and a free buffer. Only this thread queues frames, so the queue stays within 
+        // queue_depth once this frame is added.
+        size_t ibuf;
+        {
+            const clock::time_point wait_start = clock::now();
+            std::unique_lock<std::mutex> lock(mtx);
+            cv_free.wait(lock, [this] { return stop || (queue.size() < queue_depth && !free_buffers.empty()); });
+            stats.capture_wait += seconds(clock::now() - wait_start);
+            if (stop) {
+                break;
+            }
+            ibuf = free_buffers.front();
+            free_buffers.pop_front();
+        }
+
+        const clock::time_point capture_start = clock::now();
+        try {
+            capture(iframe, &buffers[ibuf]);
+        }
+        catch (...) {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (!error) {
+                error = std::current_exception();
+            }
+            stop = true;
+            cv_full.notify_one();
+            break;
+        }
+        stats.capture_time += seconds(clock::now() - capture_start);
+
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            queue.emplace_back(iframe, ibuf);
+        }
+        cv_full.notify_one();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        capture_done = true;
+    }
+    cv_full.notify_one();
+    writer.join();
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    stats.duration = seconds(clock::now() - start);
+    stats.fps = (stats.duration > 0) ? stats.nframes / stats.duration : 0.;
+    return stats;
+}
+
+
+void FramePipeline::WriterLoop(const WriteFn& write, PipelineStats& stats)
+{
+    using clock = std::chrono::steady_clock;
+    while (true)
+    {
+        std::pair<size_t, size_t> item;
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            cv_full.wait(lock, [this] { return stop || capture_done || !queue.empty(); });
+            if (stop || queue.empty()) {
+                return;
+            }
+            item = queue.front();
+            queue.pop_front();
+        }
+        cv_free.notify_one();
+
+        const clock::time_point write_start = clock::now();
+        try {
+            write(item.first, &buffers[item.second]);
+        }
+        catch (...) {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (!error) {
+                error = std::current_exception();
+            }
+            stop = true;
+            cv_free.notify_one();
+            return;
+        }
+        stats.write_time += std::chrono::duration<double>(clock::now() - write_start).count();
+        stats.nframes++;
+
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            free_buffers.push_back(item.second);
+        }
+        cv_free.notify_one();
+    }
+}
+
+
+} // namespace cispp
@@ -0,0 +1,227 @@
+#include "include/quadrature.h"
+
+#include <cmath>
+#include <stdexcept>
+#include <Eigen/Dense>
+
+
+namespace cispp {
+
+
+std::vector<double> trapz_weights(const std::vector<double>& x)
+{
+    const size_t n = x.size();
+    std::vector<double> w(n, 0.);
+    for (size_t i = 1; i < n; i++)
+    {
+        w[i - 1] += 0.5 * (x[i] - x[i - 1]);
+        w[i] += 0.5 * (x[i] - x[i - 1]);
+    }
+    return w;
+}
+
+
+/**
+ * @brief Add the weights of the quadratic through (x0, x1, x2), integrated over [x0, x2], to w0, w1 and w2
+ */
+static void add_simpson_pair(double x0, double x1, double x2, double& w0, double& w1, double& w2)
+{
+    const double h0 = x1 - x0;
+    const double h1 = x2 - x1;
+    const double h = h0 + h1;
+    w0 += h * (2 * h0 - h1) / (6 * h0);
+    w1 += h * h * h / (6 * h0 * h1);
+    w2 += h * (2 * h1 - h0) / (6 * h1);
+}
+
+
+/**
+ * @brief Add the weights of the quadratic through (x0, x1, x2), integrated over [x1, x2] only, to w0, w1 and w2
+ */
+static void add_simpson_last(double x0, double x1, double x2, double& w0, double& w1, double& w2)
+{
+    const double h0 = x1 - x0;
+    const double h1 = x2 - x1;
+    w0 += -h1 * h1 * h1 / (6 * h0 * (h0 + h1));
+    w1 += h1 * (h1 + 3 * h0) / (6 * h0);
+    w2 += h1 * (2 * h1 + 3 * h0) / (6 * (h0 + h1));
+}
+
+
+std::vector<double> simpson_weights(const std::vector<double>& x)
+{
+    const size_t n = x.size();
+    if (n < 3) {
+        return trapz_weights(x);
+    }
+    std::vector<double> w(n, 0.);
+    size_t i = 0;
+    for (; i + 2 < n; i += 2) {
+        add_simpson_pair(x[i], x[i + 1], x[i + 2], w[i], w[i + 1], w[i + 2]);
+    }
+    if (i + 1 < n) {
+        add_simpson_last(x[n - 3], x[n - 2], x[n - 1], w[n - 3], w[n - 2], w[n - 1]);
+    }
+    return w;
+}
+
+
+QuadratureGrid sampled_quadrature(const std::vector<double>& wavelength, const std::vector<double>& spec_flux,
+                                  QuadratureRule rule)
+{
+    if (wavelength.size() != spec_flux.size()) {
+        throw std::invalid_argument("sampled_quadrature: wavelength and spec_flux sizes differ");
+    }
+    QuadratureGrid grid;
+    grid.wavelength = wavelength;
+    grid.weight = (rule == QuadratureRule::Simpson) ? simpson_weights(wavelength) : trapz_weights(wavelength);
+    for (size_t i = 0; i < wavelength.size(); i++) {
+        grid.weight[i] *= spec_flux[i];
+    }
+    return grid;
+}
+
+
+QuadratureGrid clenshaw_curtis(const std::function<double(double)>& spec_flux, double wl_min, double wl_max, size_t n)
+{
+    if (n < 1 || !(wl_max > wl_min)) {
+        throw std::invalid_argument("clenshaw_curtis: need n >= 1 and wl_max > wl_min");
+    }
+
+    // weights on [-1, 1] for nodes cos(k pi / n), as in Trefethen, Spectral Methods in MATLAB (clencurt)
+    std::vector<double> w(n + 1, 0.);
+    const double wend = (n % 2 == 0) ? 1. / (n * n - 1.) : 1. / (n * n);
+    w[0] = w[n] = wend;
+    for (size_t k = 1; k < n; k++)
+    {
+        const double theta = M_PI * k / n;
+        double v = 1;
+        for (size_t j = 1; 2 * j < n; j++) {
+            v -= 2 * cos(2 * j * theta) / (4. * j * j - 1);
+        }
+        if (n % 2 == 0) {
+            v -= cos(n * theta) / (n * n - 1.);
+        }
+        w[k] = 2 * v / n;
+    }
+
+    // ascending wavelength: node k at -cos(k pi / n)
+    QuadratureGrid grid;
+    grid.wavelength.resize(n + 1);
+    grid.weight.resize(n + 1);
+    const double half_width = 0.5 * (wl_max - wl_min);
+    const double centre = 0.5 * (wl_max + wl_min);
+    for (size_t k = 0; k <= n; k++)
+    {
+        const double wl = (k == 0) ? wl_min : (k == n) ? wl_max : centre - half_width * cos(M_PI * k / n);
+        grid.wavelength[k] = wl;
+        grid.weight[k] = half_width * w[k] * spec_flux(wl);
+    }
+    return grid;
+}
+
+
+QuadratureGrid gauss_hermite(const std::vector<SpectralLine>& lines, size_t n)
+{
+    if (n < 1) {
+        throw std::invalid_argument("gauss_hermite: need at least one node per line");
+    }
+
+    // Golub-Welsch: nodes are the eigenvalues of the Jacobi matrix of the Hermite polynomials, weights (normalised
+    // to a unit Gaussian) the squared first components of its eigenvectors
+    Eigen::MatrixXd jacobi = Eigen::MatrixXd::Zero(n, n);
+    for (size_t k = 1; k < n; k++) {
+        jacobi(k, k - 1) = jacobi(k - 1, k) = sqrt(0.5 * k);
+    }
+    Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> solver(jacobi);
+    const Eigen::VectorXd& x = solver.eigenvalues();
+    const Eigen::MatrixXd& v = solver.eigenvectors();
+
+    QuadratureGrid grid;
+    for (const SpectralLine& line : lines)
+    {
+        const double u_sigma = line.sigma / (line.sigma + line.wavelength);
+        for (size_t k = 0; k < n; k++)
+        {
+            const double u = sqrt(2.) * u_sigma * x(k);
+            grid.wavelength.push_back(line.wavelength / (1 + u));
+            grid.weight.push_back(line.flux * v(0, k) * v(0, k));
+        }
+    }
+    return grid;
+}
+
+
+QuadratureGrid adaptive_simpson(const std::function<double(double)>& spec_flux, double wl_min, double wl_max,
+                                double tol, size_t max_depth)
+{
+    if (!(wl_max > wl_min)) {
+        throw std::invalid_argument("adaptive_simpson: need wl_max > wl_min");
+    }
+
+    // initial estimate of the total flux, for the absolute tolerance, from a coarse Simpson rule
+    const size_t ninit = 16;
+    std::vector<double> wl_init(ninit + 1), f_init(ninit + 1);
+    for (size_t i = 0; i <= ninit; i++)
+    {
+        wl_init[i] = wl_min + (wl_max - wl_min) * i / ninit;
+        f_init[i] = spec_flux(wl_init[i]);
+    }
+    std::vector<double> w_init = simpson_weights(wl_init);
+    double flux = 0;
+    for (size_t i = 0; i <= ninit; i++) {
+        flux += std::abs(w_init[i] * f_init[i]);
+    }
+    const double err_density = 15 * tol * flux / (wl_max - wl_min);
+
+    // depth-first bisection, so that accepted intervals come out in ascending wavelength
+    struct Interval
+    {
+        double a, b, fa, fm, fb, s;
+        size_t depth;
+    };
+    auto simpson = [](double a, double b, double fa, double fm, double fb) {
+        return (b - a) * (fa + 4 * fm + fb) / 6;
+    };
+    QuadratureGrid grid;
+    grid.wavelength.push_back(wl_min);
+    grid.weight.push_back(0.);
+    std::vector<Interval> stack;
+    for (size_t i = 0; i < ninit; i += 2)
+    {
+        const double a = wl_init[i], b = wl_init[i + 2];
+        stack.push_back({a, b, f_init[i], f_init[i + 1], f_init[i + 2],
+                         simpson(a, b, f_init[i], f_init[i + 1], f_init[i + 2]), 0});
+        while (!stack.empty())
+        {
+            Interval iv = stack.back();
+            stack.pop_back();
+            const double m = 0.5 * (iv.a + iv.b);
+            const double wl_l = 0.5 * (iv.a + m);
+            const double wl_r = 0.5 * (m + iv.b);
+            const double f_l = spec_flux(wl_l);
+            const double f_r = spec_flux(wl_r);
+            const double s_l = simpson(iv.a, m, iv.fa, f_l, iv.fm);
+            const double s_r = simpson(m, iv.b, iv.fm, f_r, iv.fb);
+            const double err = std::abs(s_l + s_r - iv.s);
+            if (err <= err_density * (iv.b - iv.a) || iv.depth >= max_depth)
+            {
+                // accept the two half-interval rules: nodes a (already in the grid), wl_l, m, wl_r, b
+                const double h = (iv.b - iv.a) / 12;
+                grid.weight.back() += h * iv.fa;
+                grid.wavelength.insert(grid.wavelength.end(), {wl_l, m, wl_r, iv.b});
+                grid.weight.insert(grid.weight.end(), {4 * h * f_l, 2 * h * iv.fm, 4 * h * f_r, h * iv.fb});
+                grid.error += err / 15;
+            }
+            else
+            {
+                stack.push_back({m, iv.b, iv.fm, f_r, iv.fb, s_r, iv.depth + 1});
+                stack.push_back({iv.a, m, iv.fa, f_l, iv.fm, s_l, iv.depth + 1});
+            }
+        }
+    }
+    return grid;
+}
+
+
+} // namespace cispp
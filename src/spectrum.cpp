@@ -1,10 +1,21 @@
+#include <algorithm>
 #include <cmath>
+#include <stdexcept>
 #include "include/spectrum.h"
 
 
 namespace cispp {
 
 
+/**
+ * @brief Gaussian line shape, with parameters c = (sigma + wl0) / sigma and norm = flux * c * wl0 / sqrt(2 pi)
+ */
+static double gaussian_profile(double wl, double wl0, double c, double norm)
+{
+    return std::pow(wl, -2) * norm * std::exp(-0.5 * std::pow(((wl0 - wl) / wl) * c, 2));
+}
+
+
 cispp::Spectrum gaussian(double wl0, double sigma, double flux, size_t nbins, size_t nsigma)
 {
     std::vector<double> wl(nbins, 0.);
@@ -19,7 +30,93 @@ cispp::Spectrum gaussian(double wl0, double sigma, double flux, size_t nbins, si
     {
         double wl_i = wlmin + i * dwl;
         wl[i] = wl_i;
-        s0[i] = std::pow(wl_i, -2) * norm * std::exp(-0.5 * std::pow(((wl0 - wl_i) / wl_i) * c, 2));
+        s0[i] = gaussian_profile(wl_i, wl0, c, norm);
+    }
+    return cispp::Spectrum(wl, s0);
+}
+
+
+cispp::Spectrum get_gaussian_multiplet(const std::vector<SpectralLine>& lines, double tol, double max_delay)
+{
+    if (lines.empty()) {
+        throw std::invalid_argument("get_gaussian_multiplet: empty line list");
+    }
+    if (!(tol > 0 && tol < 1)) {
+        throw std::invalid_argument("get_gaussian_multiplet: tol must be in (0, 1)");
+    }
+    const size_t nlines = lines.size();
+    std::vector<double> c(nlines);
+    std::vector<double> norm(nlines);
+    double flux = 0;
+    double wl_min = lines[0].wavelength;
+    double wl_max = lines[0].wavelength;
+    for (size_t i = 0; i < nlines; i++)
+    {
+        if (!(lines[i].sigma > 0 && lines[i].wavelength > 0)) {
+            throw std::invalid_argument("get_gaussian_multiplet: line wavelengths and widths must be positive");
+        }
+        c[i] = (lines[i].sigma + lines[i].wavelength) / lines[i].sigma;
+        norm[i] = lines[i].flux * c[i] * lines[i].wavelength / std::sqrt(2 * M_PI);
+        flux += std::abs(lines[i].flux);
+        wl_min = std::min(wl_min, lines[i].wavelength);
+        wl_max = std::max(wl_max, lines[i].wavelength);
+    }
+
+    // each line's cut-off, in standard deviations: its peak x exp(-nsigma^2 / 2) x the wavelength range <= tol x flux.
+    // The range depends on the cut-offs, so iterate from the line spread alone.
+    const double nsigma_tol = std::sqrt(2 * std::log(1 / tol));
+    std::vector<double> nsigma(nlines, nsigma_tol);
+    for (int iter = 0; iter < 3; iter++)
+    {
+        double lo = wl_max, hi = wl_min;
+        for (size_t i = 0; i < nlines; i++)
+        {
+            lo = std::min(lo, lines[i].wavelength - nsigma[i] * lines[i].sigma);
+            hi = std::max(hi, lines[i].wavelength + nsigma[i] * lines[i].sigma);
+        }
+        for (size_t i = 0; i < nlines; i++)
+        {
+            const double peak = std::abs(lines[i].flux) / (std::sqrt(2 * M_PI) * lines[i].sigma);
+            nsigma[i] = std::max(nsigma_tol, std::sqrt(2 * std::log(std::max(peak * (hi - lo) / (tol * flux), 1.))));
+        }
+    }
+
+    // clusters of lines with overlapping ranges
+    std::vector<size_t> order(nlines);
+    for (size_t i = 0; i < nlines; i++) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&](size_t i, size_t j) {
+        return lines[i].wavelength - nsigma[i] * lines[i].sigma < lines[j].wavelength - nsigma[j] * lines[j].sigma;
+    });
+    std::vector<double> wl;
+    std::vector<double> s0;
+    size_t k = 0;
+    while (k < nlines)
+    {
+        double lo = lines[order[k]].wavelength - nsigma[order[k]] * lines[order[k]].sigma;
+        double hi = lines[order[k]].wavelength + nsigma[order[k]] * lines[order[k]].sigma;
+        double sigma = lines[order[k]].sigma;
+        for (k++; k < nlines && lines[order[k]].wavelength - nsigma[order[k]] * lines[order[k]].sigma <= hi; k++)
+        {
+            hi = std::max(hi, lines[order[k]].wavelength + nsigma[order[k]] * lines[order[k]].sigma);
+            sigma = std::min(sigma, lines[order[k]].sigma);
+        }
+
+        // aliasing bound on the spacing
+        const double omega = std::abs(max_delay) / lo + nsigma_tol / sigma;
+        const size_t nbins = static_cast<size_t>(std::ceil((hi - lo) * omega / (2 * M_PI))) + 1;
+        const double dwl = (hi - lo) / nbins;
+        for (size_t j = 0; j <= nbins; j++)
+        {
+            const double wl_j = lo + j * dwl;
+            double s0_j = 0;
+            for (size_t i = 0; i < nlines; i++) {
+                s0_j += gaussian_profile(wl_j, lines[i].wavelength, c[i], norm[i]);
+            }
+            wl.push_back(wl_j);
+            s0.push_back(s0_j);
+        }
     }
     return cispp::Spectrum(wl, s0);
 }
@@ -0,0 +1,255 @@
+#include "include/transfer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+
+#include "include/mueller.h"
+
+
+namespace cispp {
+
+
+double TransferFunction::Evaluate(const double* delay, size_t variant) const
+{
+    double t = constant[variant];
+    for (const FourierTerm& term : terms)
+    {
+        double phase = 0;
+        for (size_t k = 0; k < term.m.size(); k++) {
+            phase += term.m[k] * delay[k];
+        }
+        t += term.a[variant] * cos(phase) + term.b[variant] * sin(phase);
+    }
+    return t;
+}
+
+
+void TransferFunction::EvaluateBatch(const double* const* delay, const uint8_t* variant, size_t n, double* scratch,
+                                     double* t) const
+{
+    const size_t ndelays = icomp.size();
+    double* c = scratch;
+    double* s = scratch + ndelays * n;
+    double* zr = scratch + 2 * ndelays * n;
+    double* zi = zr + n;
+    const bool single_variant = (GetVariantCount() == 1);
+
+    // phasors of the delays, once per pixel
+    for (size_t k = 0; k < ndelays; k++)
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            c[k * n + i] = cos(delay[k][i]);
+            s[k * n + i] = sin(delay[k][i]);
+        }
+    }
+
+    if (single_variant) {
+        std::fill(t, t + n, constant[0]);
+    }
+    else
+    {
+        for (size_t i = 0; i < n; i++) {
+            t[i] = constant[variant[i]];
+        }
+    }
+
+    for (const FourierTerm& term : terms)
+    {
+        // phasor of the term's phase, as the product of the delay phasors (conjugated for m = -1)
+        bool first = true;
+        for (size_t k = 0; k < ndelays; k++)
+        {
+            if (term.m[k] == 0) {
+                continue;
+            }
+            const double* ck = c + k * n;
+            const double* sk = s + k * n;
+            const double sign = term.m[k];
+            if (first)
+            {
+                for (size_t i = 0; i < n; i++)
+                {
+                    zr[i] = ck[i];
+                    zi[i] = sign * sk[i];
+                }
+                first = false;
+            }
+            else
+            {
+                for (size_t i = 0; i < n; i++)
+                {
+                    const double zr_i = zr[i];
+                    zr[i] = zr_i * ck[i] - zi[i] * sign * sk[i];
+                    zi[i] = zr_i * sign * sk[i] + zi[i] * ck[i];
+                }
+            }
+        }
+
+        if (single_variant)
+        {
+            const double a = term.a[0];
+            const double b = term.b[0];
+            for (size_t i = 0; i < n; i++) {
+                t[i] += a * zr[i] + b * zi[i];
+            }
+        }
+        else
+        {
+            for (size_t i = 0; i < n; i++) {
+                t[i] += term.a[variant[i]] * zr[i] + term.b[variant[i]] * zi[i];
+            }
+        }
+    }
+}
+
+
+bool ReduceInterferometer(const std::vector<std::unique_ptr<Component>>& components,
+                          const std::vector<Eigen::Matrix4d>& camera_mueller, TransferFunction* transfer,
+                          size_t max_delays)
+{
+    using Poly = std::vector<std::complex<double>>;  // coefficient of exp(i sum_k m_k delay_k), at index sum_k (m_k + 1) 3^k
+
+    // classify the components
+    std::vector<size_t> icomp;
+    for (size_t i = 0; i < components.size(); i++)
+    {
+        Component& component = *components[i];
+        if (component.IsAngleDependent() || component.IsWavelengthDependent())
+        {
+            if (!component.IsIdealRetarder()) {
+                return false;
+            }
+            icomp.push_back(i);
+        }
+    }
+    const size_t ndelays = icomp.size();
+    if (ndelays > max_delays) {
+        return false;
+    }
+    size_t npoly = 1;
+    for (size_t k = 0; k < ndelays; k++) {
+        npoly *= 3;
+    }
+    const size_t izero = (npoly - 1) / 2;  // all m_k = 0
+
+    // row vector (1, 0, 0, 0), multiplied through the chain
+    std::vector<Poly> row(4, Poly(npoly, 0.));
+    row[0][izero] = 1;
+    auto multiply = [&](const std::vector<Poly>& r, const Eigen::Matrix4d& m)
+    {
+        std::vector<Poly> out(4, Poly(npoly, 0.));
+        for (size_t j = 0; j < 4; j++)
+        {
+            for (size_t i = 0; i < 4; i++)
+            {
+                if (m(i, j) == 0) {
+                    continue;
+                }
+                for (size_t p = 0; p < npoly; p++) {
+                    out[j][p] += r[i][p] * m(i, j);
+                }
+            }
+        }
+        return out;
+    };
+
+    size_t k = 0;
+    size_t stride = 1;  // 3^k
+    for (size_t i = 0; i < components.size(); i++)
+    {
+        if (k < ndelays && icomp[k] == i)
+        {
+            // M = A + B cos(delay) + C sin(delay), with cos = (E + 1 / E) / 2 and sin = -i (E - 1 / E) / 2 for
+            // E = exp(i delay). Earlier terms all have m_k = 0, so each term splits into m_k = 0, +1 and -1.
+            const double orientation = components[i]->orientation;
+            const Eigen::Matrix4d ma = Rotate(MuellerRetarder(0, 0), orientation).Matrix();
+            const Eigen::Matrix4d mb = Rotate(MuellerRetarder(1, 0), orientation).Matrix() - ma;
+            const Eigen::Matrix4d mc = Rotate(MuellerRetarder(0, 1), orientation).Matrix() - ma;
+            std::vector<Poly> u = multiply(row, ma);
+            std::vector<Poly> v = multiply(row, mb);
+            std::vector<Poly> w = multiply(row, mc);
+            const std::complex<double> i_2(0, 0.5);
+            for (size_t j = 0; j < 4; j++)
+            {
+                for (size_t p = 0; p < npoly; p++)
+                {
+                    if (v[j][p] == 0. && w[j][p] == 0.) {
+                        continue;
+                    }
+                    u[j][p + stride] += 0.5 * v[j][p] - i_2 * w[j][p];
+                    u[j][p - stride] += 0.5 * v[j][p] + i_2 * w[j][p];
+                }
+            }
+            row = u;
+            k++;
+            stride *= 3;
+        }
+        else {
+            row = multiply(row, components[i]->GetMuellerMatrix(0, 0, 0));
+        }
+    }
+
+    // S0 of each variant
+    std::vector<Poly> s0;
+    if (camera_mueller.empty()) {
+        s0.push_back(row[0]);
+    }
+    for (const Eigen::Matrix4d& m : camera_mueller) {
+        s0.push_back(multiply(row, m)[0]);
+    }
+    const size_t nvariants = s0.size();
+
+    double norm = 0;
+    for (const Poly& f : s0)
+    {
+        double sum = 0;
+        for (const std::complex<double>& coef : f) {
+            sum += std::abs(coef);
+        }
+        norm = std::max(norm, sum);
+    }
+
+    transfer->icomp = icomp;
+    transfer->constant.resize(nvariants);
+    transfer->terms.clear();
+    for (size_t v = 0; v < nvariants; v++) {
+        transfer->constant[v] = s0[v][izero].real();
+    }
+    for (size_t p = 0; p < npoly; p++)
+    {
+        // one term per conjugate pair: the multipliers m and -m, with the first non-zero multiplier +1
+        std::vector<int> m(ndelays);
+        int first = 0;
+        for (size_t kk = 0, q = p; kk < ndelays; kk++, q /= 3)
+        {
+            m[kk] = static_cast<int>(q % 3) - 1;
+            if (first == 0) {
+                first = m[kk];
+            }
+        }
+        if (first != 1) {
+            continue;
+        }
+        double max_coef = 0;
+        for (size_t v = 0; v < nvariants; v++) {
+            max_coef = std::max(max_coef, std::abs(s0[v][p]));
+        }
+        if (max_coef <= 1e-12 * norm) {
+            continue;
+        }
+        FourierTerm term {m, std::vector<double>(nvariants), std::vector<double>(nvariants)};
+        for (size_t v = 0; v < nvariants; v++)
+        {
+            // c exp(i phase) + conj(c) exp(-i phase) = 2 Re(c) cos(phase) - 2 Im(c) sin(phase)
+            term.a[v] = 2 * s0[v][p].real();
+            term.b[v] = -2 * s0[v][p].imag();
+        }
+        transfer->terms.push_back(term);
+    }
+    return true;
+}
+
+
+} // namespace cispp
@@ -1,5 +1,95 @@
 #include <iostream>
+#include <vector>
 #include "include/camera.h"
+#include "include/random.h"
+
+
+/**
+ * @brief test Philox4x32-10 against the Random123 known-answer vectors
+ */
+bool test_philox()
+{
+    std::array<uint32_t, 4> r0 = cispp::Philox4x32({0, 0, 0, 0}, {0, 0});
+    std::array<uint32_t, 4> r1 = cispp::Philox4x32({0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff}, 
+                                                   {0xffffffff, 0xffffffff});
+    std::array<uint32_t, 4> r2 = cispp::Philox4x32({0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344}, 
+                                                   {0xa4093822, 0x299f31d0});
+    return r0 == std::array<uint32_t, 4>{0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8} &&
+           r1 == std::array<uint32_t, 4>{0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd} &&
+           r2 == std::array<uint32_t, 4>{0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1};
+}
+
+
+/**
+ * @brief test that the sensor model does not depend on how pixels are split between calls, and that it depends on 
+ * the frame and the seed
+ */
+bool test_digitise_reproducible(cispp::Camera& camera)
+{
+    const size_t n = 1000;
+    std::vector<double> photons(n);
+    for (size_t i = 0; i < n; i++) {
+        photons[i] = 0.1 * i;
+    }
+    cispp::SensorOptions sensor;
+    sensor.enable = true;
+    sensor.frame = 7;
+
+    std::vector<unsigned short int> counts(n), counts_split(n), counts_frame(n);
+    camera.Digitise(photons.data(), n, 5000, sensor, counts.data());
+    for (size_t i0 = 0; i0 < n; i0 += 13) {
+        camera.Digitise(&photons[i0], std::min<size_t>(13, n - i0), 5000 + i0, sensor, &counts_split[i0]);
+    }
+    sensor.frame = 8;
+    camera.Digitise(photons.data(), n, 5000, sensor, counts_frame.data());
+    return counts == counts_split && counts != counts_frame;
+}
+
+
+/**
+ * @brief test the mean and variance of the digitised signal, in the Poisson and Gaussian regimes, and clipping
+ */
+bool test_digitise_statistics(cispp::Camera& camera)
+{
+    const size_t n = 200000;
+    cispp::SensorOptions sensor;
+    sensor.enable = true;
+    std::vector<unsigned short int> counts(n);
+
+    for (double photons_i : {60., 1000.})  // Poisson and Gaussian shot noise, well clear of clipping at 0
+    {
+        std::vector<double> photons(n, photons_i);
+        camera.Digitise(photons.data(), n, 0, sensor, counts.data());
+        double mean = 0;
+        double var = 0;
+        for (unsigned short int c : counts) {
+            mean += c;
+        }
+        mean /= n;
+        for (unsigned short int c : counts) {
+            var += (c - mean) * (c - mean);
+        }
+        var /= n - 1;
+
+        // electrons: Poisson(qe * photons) + read noise, then gain and rounding (variance 1/12)
+        const double electrons = camera.quantum_efficiency * photons_i;
+        const double mean_expected = electrons / camera.epercount;
+        const double var_expected = (electrons + pow(camera.cam_noise, 2)) / pow(camera.epercount, 2) + 1. / 12;
+        std::cout << "mean = " << mean << " (" << mean_expected << "), var = " << var << " (" << var_expected << ")\n";
+        if (std::abs(mean - mean_expected) > 0.05 || std::abs(var / var_expected - 1) > 0.03) {
+            return false;
+        }
+    }
+
+    // noiseless and saturated
+    sensor.noise = false;
+    std::vector<float> photons {0.f, -5.f, 100.f, 1e9f};
+    camera.Digitise(photons.data(), photons.size(), 0, sensor, counts.data());
+    const unsigned short int max_count = (1 << camera.bit_depth) - 1;
+    return counts[0] == 0 && counts[1] == 0 && 
+           counts[2] == static_cast<unsigned short int>(std::floor(100 * camera.quantum_efficiency / camera.epercount + 0.5)) &&
+           counts[3] == max_count;
+}
 
 
 int main()
@@ -39,4 +129,8 @@ int main()
         std::cout << camera.GetPixelIndexY(camera.pixel_centres_y[i]) << std::endl;
         std::cout << std::endl;
     }   
+
+    std::cout << "test_philox: " << (test_philox() ? "passed" : "failed") << '\n';
+    std::cout << "test_digitise_reproducible: " << (test_digitise_reproducible(camera) ? "passed" : "failed") << '\n';
+    std::cout << "test_digitise_statistics: " << (test_digitise_statistics(camera) ? "passed" : "failed") << '\n';
 }
\ No newline at end of file
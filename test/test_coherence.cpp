@@ -1,3 +1,4 @@
+#include <chrono>
 #include "include/coherence.h"
 #include "include/maths.h"
 #include "include/spectrum.h"
@@ -32,6 +33,105 @@ bool test_coherence_gaussian()
 }
 
 
+/**
+ * @brief test the coherence of a multiplet against the sum of its lines' analytic coherences, up to the maximum delay 
+ * its wavelength grid was chosen for
+ */
+bool test_coherence_multiplet()
+{
+    std::vector<cispp::SpectralLine> lines {{464.742e-9, 0.02e-9, 500}, {465.025e-9, 0.02e-9, 300}, 
+                                            {465.147e-9, 0.02e-9, 100}};
+    const double flux = 900;
+    const double wld = 464e-9;
+    const double tol = 1e-7;
+    cispp::Spectrum spec = cispp::get_gaussian_multiplet(lines, tol, 4e4);
+    std::cout << "nbins = " << spec.wavelength.size() << '\n';
+
+    for (double delay : {0., 1e4, 4e4})
+    {
+        std::complex<double> coherence_a = 0;
+        for (const cispp::SpectralLine& line : lines) {
+            coherence_a += cispp::coherence_gaussian(line.wavelength, line.sigma, line.flux, delay, wld);
+        }
+        std::complex<double> coherence_n = cispp::calculate_coherence(spec.wavelength, spec.s0, delay, wld);
+        if (std::abs(coherence_n - coherence_a) > tol * flux) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/**
+ * @brief test that CoherenceEvaluator agrees with calculate_coherence at arbitrary delays and on a uniform delay grid,
+ * including long runs between phasor resyncs
+ */
+bool test_coherence_evaluator()
+{
+    const double wld = 464e-9;
+    cispp::Spectrum spec = cispp::gaussian(465e-9, 0.05e-9, 1000, 2000, 10);
+    const double flux = cispp::trapz(spec.wavelength, spec.s0);
+    cispp::CoherenceEvaluator evaluator(spec.wavelength, spec.s0, wld);
+    const double tol = 1e-10;
+
+    const size_t n = 500;
+    std::vector<double> delay(n);
+    for (size_t j = 0; j < n; j++) {
+        delay[j] = 1e5 * std::sin(j);
+    }
+    std::vector<std::complex<double>> coherence(n);
+    evaluator.Evaluate(delay.data(), n, coherence.data());
+    for (size_t j = 0; j < n; j++)
+    {
+        if (std::abs(coherence[j] - cispp::calculate_coherence(spec.wavelength, spec.s0, delay[j], wld)) > tol * flux) {
+            return false;
+        }
+    }
+
+    const double delay0 = -2e4;
+    const double ddelay = 37.1;
+    for (size_t resync_interval : {1, 64, 1000})
+    {
+        evaluator.resync_interval = resync_interval;
+        evaluator.EvaluateUniform(delay0, ddelay, n, coherence.data());
+        for (size_t j = 0; j < n; j++)
+        {
+            const double delay_j = delay0 + j * ddelay;
+            if (std::abs(coherence[j] - cispp::calculate_coherence(spec.wavelength, spec.s0, delay_j, wld)) > 
+                tol * flux) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+
+/**
+ * @brief time a coherence-vs-delay curve with calculate_coherence and with CoherenceEvaluator
+ */
+bool test_coherence_evaluator_throughput()
+{
+    const double wld = 464e-9;
+    cispp::Spectrum spec = cispp::gaussian(465e-9, 0.05e-9, 1000, 1000, 10);
+    const size_t n = 10000;
+    const double ddelay = 10.;
+    std::vector<std::complex<double>> coherence(n);
+
+    auto t0 = std::chrono::steady_clock::now();
+    for (size_t j = 0; j < n; j++) {
+        coherence[j] = cispp::calculate_coherence(spec.wavelength, spec.s0, j * ddelay, wld);
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    cispp::CoherenceEvaluator evaluator(spec.wavelength, spec.s0, wld);
+    evaluator.EvaluateUniform(0, ddelay, n, coherence.data());
+    auto t2 = std::chrono::steady_clock::now();
+
+    std::cout << "calculate_coherence: " << std::chrono::duration<double>(t1 - t0).count() << " s, " 
+              << "EvaluateUniform: " << std::chrono::duration<double>(t2 - t1).count() << " s" << '\n';
+    return true;
+}
+
 
 int main() {
 
@@ -41,6 +141,9 @@ int main() {
     } else {
         std::cout << "failed" << '\n';
     }
-    
+
+    std::cout << "test_coherence_multiplet: " << (test_coherence_multiplet() ? "passed" : "failed") << '\n';
+    std::cout << "test_coherence_evaluator: " << (test_coherence_evaluator() ? "passed" : "failed") << '\n';
+    std::cout << "test_coherence_evaluator_throughput: " << (test_coherence_evaluator_throughput() ? "passed" : "failed") << '\n';
     return 0;
 }
\ No newline at end of file
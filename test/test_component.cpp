@@ -1,7 +1,235 @@
 #include <iostream>
+#include <vector>
 #include "include/component.h"
 
 
+/**
+ * @brief test that the batch UniaxialCrystal delay agrees exactly with the scalar delay
+ */
+bool test_delay_batch()
+{
+    cispp::UniaxialCrystal crystal(M_PI / 4, 0.01, -0.02, 8e-3, M_PI / 4, "a-BBO");
+    const double wavelength = 465e-9;
+    const size_t n = 1000;
+
+    std::vector<double> inc_angle(n);
+    std::vector<double> azim_angle(n);
+    std::vector<double> delay(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        inc_angle[i] = 0.1 * i / n;
+        azim_angle[i] = 2 * M_PI * i / n;
+    }
+    crystal.GetDelayBatch(wavelength, inc_angle.data(), azim_angle.data(), delay.data(), n);
+    for (size_t i = 0; i < n; i++)
+    {
+        if (delay[i] != crystal.GetDelay(wavelength, inc_angle[i], azim_angle[i])) {
+            return false;
+        }
+    }
+
+    std::vector<double> wl(n);
+    for (size_t i = 0; i < n; i++) {
+        wl[i] = 460e-9 + 10e-9 * i / n;
+    }
+    crystal.GetDelayBatch(wl.data(), inc_angle[n / 2], azim_angle[n / 3], delay.data(), n);
+    for (size_t i = 0; i < n; i++)
+    {
+        if (delay[i] != crystal.GetDelay(wl[i], inc_angle[n / 2], azim_angle[n / 3])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/**
+ * @brief test that delays from a wavelength table agree exactly with the scalar delay, for a crystal and for a 
+ * component using the default table
+ */
+bool test_delay_table()
+{
+    std::vector<std::unique_ptr<cispp::Component>> components;
+    components.push_back(std::make_unique<cispp::UniaxialCrystal>(M_PI / 4, 0., 0., 25e-3, 0., "a-BBO"));
+    components.push_back(std::make_unique<cispp::QuarterWaveplate>(M_PI / 4));
+    std::vector<double> wl {464e-9, 465e-9, 466e-9};
+
+    const size_t n = 3;
+    double inc_angle[n] = {0., 0.02, 0.05};
+    double azim_angle[n] = {0., 1., -2.};
+    double s_inc[n], s_azim[n], c_azim[n], delay[n];
+    for (size_t i = 0; i < n; i++)
+    {
+        s_inc[i] = sin(inc_angle[i]);
+        s_azim[i] = sin(azim_angle[i]);
+        c_azim[i] = cos(azim_angle[i]);
+    }
+    cispp::RayBatch rays {inc_angle, azim_angle, s_inc, s_azim, c_azim, n};
+
+    for (auto& component : components)
+    {
+        std::unique_ptr<cispp::DelayTable> table = component->GetDelayTable(wl);
+        for (size_t iwl = 0; iwl < wl.size(); iwl++)
+        {
+            table->GetDelayBatch(iwl, rays, delay);
+            for (size_t i = 0; i < n; i++)
+            {
+                if (delay[i] != component->GetDelay(wl[iwl], inc_angle[i], azim_angle[i])) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+
+/**
+ * @brief test that the single-precision delay deviation keeps the fringe phase of a thick crystal accurate
+ */
+bool test_delay_deviation()
+{
+    cispp::UniaxialCrystal crystal(M_PI / 4, 0., 0., 25e-3, M_PI / 4, "a-BBO");
+    std::vector<double> wl {465e-9};
+    std::unique_ptr<cispp::DelayTable> table = crystal.GetDelayTable(wl);
+
+    const size_t n = 1000;
+    std::vector<double> inc_angle(n), azim_angle(n), s_inc(n), s_azim(n), c_azim(n), delay(n);
+    std::vector<float> inc_angle_f(n), azim_angle_f(n), s_inc_f(n), s_azim_f(n), c_azim_f(n), ddelay(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        inc_angle[i] = 0.1 * i / n;
+        azim_angle[i] = 2 * M_PI * i / n;
+        s_inc[i] = sin(inc_angle[i]);
+        s_azim[i] = sin(azim_angle[i]);
+        c_azim[i] = cos(azim_angle[i]);
+        inc_angle_f[i] = inc_angle[i];
+        azim_angle_f[i] = azim_angle[i];
+        s_inc_f[i] = s_inc[i];
+        s_azim_f[i] = s_azim[i];
+        c_azim_f[i] = c_azim[i];
+    }
+    cispp::RayBatch rays {inc_angle.data(), azim_angle.data(), s_inc.data(), s_azim.data(), c_azim.data(), n};
+    cispp::RayBatchF rays_f {inc_angle_f.data(), azim_angle_f.data(), s_inc_f.data(), s_azim_f.data(), c_azim_f.data(), n};
+    table->GetDelayBatch(0, rays, delay.data());
+    table->GetDelayDeviationBatch(0, rays_f, ddelay.data());
+
+    const float delay_0 = table->GetDelayOnAxisReduced(0);
+    for (size_t i = 0; i < n; i++)
+    {
+        if (std::abs(std::remainder(delay[i] - (delay_0 + ddelay[i]), 2 * M_PI)) > 1e-3) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/**
+ * @brief partial polariser with a fixed delay, to test the default Component Mueller matrix
+ */
+class TestDiattenuator: public cispp::Component
+{
+    public:
+
+    TestDiattenuator(double orientation)
+    : Component(orientation)
+    {}
+
+    double GetT1(double wavelength, double incidence_angle, double azimuthal_angle) override {
+        return 0.9;
+    }
+
+    double GetT2(double wavelength, double incidence_angle, double azimuthal_angle) override {
+        return 0.3;
+    }
+
+    double GetDelay(double wavelength, double incidence_angle, double azimuthal_angle) override {
+        return 1.;
+    }
+};
+
+
+/**
+ * @brief test that the structured Mueller operators agree with the dense Mueller matrices
+ */
+bool test_mueller_operators()
+{
+    std::vector<std::unique_ptr<cispp::Component>> components;
+    components.push_back(std::make_unique<cispp::Polariser>(0.3));
+    components.push_back(std::make_unique<cispp::QuarterWaveplate>(-0.7));
+    components.push_back(std::make_unique<cispp::UniaxialCrystal>(M_PI / 4, 0., 0., 8e-3, M_PI / 4, "a-BBO"));
+    components.push_back(std::make_unique<TestDiattenuator>(1.1));
+    const double wavelength = 465e-9;
+    const double inc_angle = 0.03;
+    const double azim_angle = 0.8;
+    const double tol = 1e-12;
+
+    // S0 row through the whole chain
+    Eigen::RowVector4d row(1., 0., 0., 0.);
+    Eigen::RowVector4d row_dense = row;
+    for (auto& component : components)
+    {
+        component->ApplyMuellerRow(wavelength, inc_angle, azim_angle, row);
+        row_dense = row_dense * component->GetMuellerMatrix(wavelength, inc_angle, azim_angle);
+    }
+    if ((row - row_dense).cwiseAbs().maxCoeff() > tol) {
+        return false;
+    }
+
+    // composed operators applied to a Stokes vector
+    auto op = cispp::Rotate(cispp::MuellerRetarder::FromDelay(0.4), 0.2) * cispp::Rotate(cispp::MuellerPolariser(), 0.5);
+    Eigen::Vector4d stokes(1., 0.2, -0.3, 0.1);
+    Eigen::Vector4d stokes_dense = op.Matrix() * stokes;
+    op.Apply(stokes);
+    return (stokes - stokes_dense).cwiseAbs().maxCoeff() < tol;
+}
+
+
+/**
+ * @brief test that a crystal's delays with a Chebyshev dispersion band match the Sellmeier delays within the band's 
+ * error bound, that wavelengths outside the band throw, and that clearing the band restores the exact delays
+ */
+bool test_dispersion_band()
+{
+    cispp::UniaxialCrystal crystal(M_PI / 4, 0.01, -0.02, 15e-3, M_PI / 4, "a-BBO");
+    const size_t n = 1000;
+    std::vector<double> wl(n), delay(n), delay_c(n);
+    for (size_t i = 0; i < n; i++) {
+        wl[i] = 464.5e-9 + 1e-9 * i / (n - 1);
+    }
+    const double inc_angle = 0.05;
+    const double azim_angle = 0.7;
+    crystal.GetDelayBatch(wl.data(), inc_angle, azim_angle, delay.data(), n);
+    const double kappa = crystal.GetKappa(465e-9);
+
+    const cispp::ChebyshevBand& band = crystal.SetDispersionBand(wl.front(), wl.back());
+    crystal.GetDelayBatch(wl.data(), inc_angle, azim_angle, delay_c.data(), n);
+    // delay ~ 2 pi thickness (ne - no) / wavelength, so index errors scale by 2 pi thickness / wavelength
+    const double tol = 2 * 2 * M_PI * crystal.thickness / wl.front() * (band.error + 1e-14);
+    for (size_t i = 0; i < n; i++)
+    {
+        if (std::abs(delay_c[i] - delay[i]) > tol || 
+            std::abs(crystal.GetDelay(wl[i], inc_angle, azim_angle) - delay_c[i]) > 1e-9) {
+            return false;
+        }
+    }
+    if (std::abs(crystal.GetKappa(465e-9) - kappa) > 1e-6) {
+        return false;
+    }
+    try 
+    {
+        crystal.GetDelay(470e-9, inc_angle, azim_angle);
+        return false;
+    }
+    catch (const std::out_of_range&) {}
+
+    crystal.ClearDispersionBand();
+    crystal.GetDelayBatch(wl.data(), inc_angle, azim_angle, delay_c.data(), n);
+    return delay_c == delay;
+}
+
+
 int main()
 {
     cispp::Polariser p(0);
@@ -9,5 +237,10 @@ int main()
     std::cout << p.orientation << std::endl;
     // std::cout << p.get_mueller_matrix() << std::endl;
 
+    std::cout << "test_delay_batch: " << (test_delay_batch() ? "passed" : "failed") << '\n';
+    std::cout << "test_delay_table: " << (test_delay_table() ? "passed" : "failed") << '\n';
+    std::cout << "test_delay_deviation: " << (test_delay_deviation() ? "passed" : "failed") << '\n';
+    std::cout << "test_dispersion_band: " << (test_dispersion_band() ? "passed" : "failed") << '\n';
+    std::cout << "test_mueller_operators: " << (test_mueller_operators() ? "passed" : "failed") << '\n';
     return 1;
-}
\ No newline at end of file
+}
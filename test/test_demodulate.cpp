@@ -0,0 +1,311 @@
+#include <iostream>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <vector>
+#include "include/camera.h"
+#include "include/demodulate.h"
+
+
+/**
+ * @brief pixelated-camera interferogram, I = I0 (1 + contrast cos(phase + mask)) / 4, with the camera's phase mask and 
+ * a smoothly varying phase and contrast
+ */
+std::vector<unsigned short int> get_test_image_pixelated(size_t nx, size_t ny, std::vector<double>* phase, 
+                                                         std::vector<double>* contrast)
+{
+    const double i0 = 12000;
+    cispp::Camera camera(nx, ny, 3.45e-6, 12, 0.35, 0.46, 2.5, "monochrome_polarised");
+    std::vector<double> mask(nx);
+    std::vector<unsigned short int> image(nx * ny);
+    phase->resize(nx * ny);
+    contrast->resize(nx * ny);
+    for (size_t iy = 0; iy < ny; iy++)
+    {
+        camera.GetPixelatedPhaseMaskRow(iy, 0, nx, mask.data());
+        for (size_t ix = 0; ix < nx; ix++)
+        {
+            const size_t i = ix + iy * nx;
+            (*phase)[i] = 3 * sin(2 * M_PI * ix / nx) + 2 * cos(2 * M_PI * iy / ny);
+            (*contrast)[i] = 0.5 + 0.1 * cos(2 * M_PI * iy / ny);
+            image[i] = static_cast<unsigned short int>(std::round(i0 * (1 + (*contrast)[i] * cos((*phase)[i] + mask[ix])) / 4));
+        }
+    }
+    return image;
+}
+
+
+/**
+ * @brief max phase and contrast errors of a demodulated image, against the truth sampled at the output pixel centres
+ */
+void get_errors_pixelated(const cispp::DemodResult& result, const std::vector<double>& phase, 
+                          const std::vector<double>& contrast, size_t nx, bool upsample, double* max_phase_error, 
+                          double* max_contrast_error)
+{
+    *max_phase_error = 0;
+    *max_contrast_error = 0;
+    const size_t nox = upsample ? nx : nx / 2;
+    for (size_t i = 0; i < result.phase.size(); i++)
+    {
+        // super-pixel outputs are compared with the mean of the four pixels' truth
+        double phase_i, contrast_i;
+        if (upsample)
+        {
+            phase_i = phase[i];
+            contrast_i = contrast[i];
+        }
+        else
+        {
+            const size_t j = 2 * (i % nox) + 2 * (i / nox) * nx;
+            phase_i = 0.25 * (phase[j] + phase[j + 1] + phase[j + nx] + phase[j + nx + 1]);
+            contrast_i = 0.25 * (contrast[j] + contrast[j + 1] + contrast[j + nx] + contrast[j + nx + 1]);
+        }
+        *max_phase_error = std::max(*max_phase_error, std::abs(std::remainder(result.phase[i] - phase_i, 2 * M_PI)));
+        *max_contrast_error = std::max(*max_contrast_error, std::abs(result.contrast[i] - contrast_i));
+    }
+}
+
+
+/**
+ * @brief test that super-pixel demodulation recovers phase and contrast, at super-pixel and full resolution, and that 
+ * a multi-frame stack gives the same result as single frames for any thread count
+ */
+bool test_demodulate_pixelated()
+{
+    const size_t nx = 512;
+    const size_t ny = 384;
+    std::vector<double> phase, contrast;
+    std::vector<unsigned short int> image = get_test_image_pixelated(nx, ny, &phase, &contrast);
+
+    for (bool upsample : {false, true})
+    {
+        cispp::PixelatedDemodOptions opts;
+        opts.upsample = upsample;
+        opts.nthreads = 1;
+        cispp::PixelatedDemodulator demod(nx, ny, opts);
+        cispp::DemodResult result;
+        demod.Demodulate(image.data(), &result);
+        if (result.phase.size() != demod.GetOutputWidth() * demod.GetOutputHeight() || 
+            demod.GetOutputWidth() != (upsample ? nx : nx / 2)) {
+            return false;
+        }
+        double max_phase_error, max_contrast_error;
+        get_errors_pixelated(result, phase, contrast, nx, upsample, &max_phase_error, &max_contrast_error);
+        std::cout << "max_phase_error = " << max_phase_error << ", max_contrast_error = " << max_contrast_error << '\n';
+        if (max_phase_error > (upsample ? 0.04 : 0.02) || max_contrast_error > 0.02) {
+            return false;
+        }
+
+        // stack, in parallel
+        std::vector<unsigned short int> frames(image);
+        frames.insert(frames.end(), image.rbegin(), image.rend());
+        opts.nthreads = 3;
+        opts.rows_per_task = 5;
+        cispp::PixelatedDemodulator demod_stack(nx, ny, opts);
+        std::vector<cispp::DemodResult> results;
+        demod_stack.Demodulate(frames.data(), 2, &results);
+        cispp::DemodResult result_1;
+        demod.Demodulate(&frames[nx * ny], &result_1);
+        if (results[0].phase != result.phase || results[0].contrast != result.contrast || results[0].dc != result.dc || 
+            results[1].phase != result_1.phase) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/**
+ * @brief test that the super-pixel phase is atan2(S, C) of the pixel values to within 2e-8 rad, the polynomial 
+ * atan2's documented error, at phases spread over all octants
+ */
+bool test_demodulate_pixelated_atan2()
+{
+    const size_t nx = 2048;
+    const size_t ny = 2;
+    std::vector<unsigned short int> image(nx * ny);
+    for (size_t jx = 0; jx < nx / 2; jx++)
+    {
+        // quadratures from 4000 cos / sin of a phase stepping around the circle, rounded to pixel counts
+        const double phase = 2 * M_PI * jx / (nx / 2) + 0.001;
+        const int c = static_cast<int>(std::round(4000 * cos(phase)));
+        const int s = static_cast<int>(std::round(4000 * sin(phase)));
+        image[2 * jx] = static_cast<unsigned short int>(5000 + c);           // 0
+        image[2 * jx + 1] = 5000;                                            // pi/2
+        image[nx + 2 * jx] = static_cast<unsigned short int>(5000 + s);      // 3 pi/2
+        image[nx + 2 * jx + 1] = 5000;                                       // pi
+    }
+
+    cispp::PixelatedDemodOptions opts;
+    opts.nthreads = 1;
+    cispp::PixelatedDemodulator demod(nx, ny, opts);
+    cispp::DemodResult result;
+    demod.Demodulate(image.data(), &result);
+    double max_error = 0;
+    for (size_t jx = 0; jx < nx / 2; jx++)
+    {
+        const double c = static_cast<double>(image[2 * jx]) - image[nx + 2 * jx + 1];
+        const double s = static_cast<double>(image[nx + 2 * jx]) - image[2 * jx + 1];
+        max_error = std::max(max_error, std::abs(std::remainder(result.phase[jx] - std::atan2(s, c), 2 * M_PI)));
+    }
+    std::cout << "max_atan2_error = " << max_error << '\n';
+    return max_error < 2e-8;
+}
+
+
+/**
+ * @brief report the super-pixel demodulation frame rate for a stack of camera-sized frames
+ */
+bool test_demodulate_pixelated_throughput()
+{
+    const size_t nx = 2448;
+    const size_t ny = 2048;
+    const size_t nframes = 8;
+    std::vector<double> phase, contrast;
+    std::vector<unsigned short int> image = get_test_image_pixelated(nx, ny, &phase, &contrast);
+    std::vector<unsigned short int> frames;
+    for (size_t iframe = 0; iframe < nframes; iframe++) {
+        frames.insert(frames.end(), image.begin(), image.end());
+    }
+
+    for (bool upsample : {false, true})
+    {
+        cispp::PixelatedDemodOptions opts;
+        opts.upsample = upsample;
+        cispp::PixelatedDemodulator demod(nx, ny, opts);
+        std::vector<cispp::DemodResult> results;
+        demod.Demodulate(frames.data(), 1, &results);  // allocate outputs
+        auto start = std::chrono::high_resolution_clock::now();
+        demod.Demodulate(frames.data(), nframes, &results);
+        auto stop = std::chrono::high_resolution_clock::now();
+        const double duration = std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count() * 1e-6;
+        std::cout << "frame rate" << (upsample ? " (upsampled)" : "") << " = " << nframes / duration << " fps" << '\n';
+    }
+    return true;
+}
+
+
+#ifdef CISPP_HAVE_FFTW
+
+
+/**
+ * @brief linear-carrier interferogram, I = I0 (1 + contrast cos(phase)) / 2, with a slowly varying phase offset and 
+ * contrast
+ */
+std::vector<unsigned short int> get_test_image(size_t nx, size_t ny, double fx, double fy, 
+                                               std::vector<double>* phase, std::vector<double>* contrast)
+{
+    const double i0 = 3000;
+    std::vector<unsigned short int> image(nx * ny);
+    phase->resize(nx * ny);
+    contrast->resize(nx * ny);
+    for (size_t iy = 0; iy < ny; iy++)
+    {
+        for (size_t ix = 0; ix < nx; ix++)
+        {
+            const size_t i = ix + iy * nx;
+            (*phase)[i] = 2 * M_PI * (fx * ix + fy * iy) + 0.5 * sin(2 * M_PI * ix / nx) * cos(2 * M_PI * iy / ny);
+            (*contrast)[i] = 0.6 + 0.1 * cos(2 * M_PI * ix / nx);
+            image[i] = static_cast<unsigned short int>(std::round(i0 * (1 + (*contrast)[i] * cos((*phase)[i])) / 2));
+        }
+    }
+    return image;
+}
+
+
+/**
+ * @brief test that phase and contrast are recovered away from the image edges, with and without a known carrier
+ */
+bool test_demodulate()
+{
+    const size_t nx = 256;
+    const size_t ny = 192;
+    const double fx = 0.21;
+    const double fy = -0.04;
+    std::vector<double> phase, contrast;
+    std::vector<unsigned short int> image = get_test_image(nx, ny, fx, fy, &phase, &contrast);
+
+    cispp::DemodOptions opts;
+    opts.effort = cispp::FFTWEffort::Estimate;
+    for (bool set_carrier : {true, false})
+    {
+        cispp::LinearDemodulator demod(nx, ny, opts);
+        if (set_carrier) {
+            demod.SetCarrier(fx, fy);
+        }
+        cispp::DemodResult result;
+        demod.Demodulate(image.data(), &result);
+        // an estimated carrier should be within a frequency bin
+        std::cout << "carrier = " << demod.GetCarrierX() << ", " << demod.GetCarrierY() << '\n';
+        if (std::abs(demod.GetCarrierX() - fx) > 1. / nx || std::abs(demod.GetCarrierY() - fy) > 1. / ny) {
+            return false;
+        }
+
+        double max_phase_error = 0;
+        double max_contrast_error = 0;
+        const size_t margin = 24;
+        for (size_t iy = margin; iy < ny - margin; iy++)
+        {
+            for (size_t ix = margin; ix < nx - margin; ix++)
+            {
+                const size_t i = ix + iy * nx;
+                max_phase_error = std::max(max_phase_error, std::abs(std::remainder(result.phase[i] - phase[i], 2 * M_PI)));
+                max_contrast_error = std::max(max_contrast_error, std::abs(result.contrast[i] - contrast[i]));
+            }
+        }
+        std::cout << "max_phase_error = " << max_phase_error << ", max_contrast_error = " << max_contrast_error << '\n';
+        if (max_phase_error > 0.02 || max_contrast_error > 0.02) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/**
+ * @brief test that wisdom is saved, and report the frame rate for a camera-sized frame
+ */
+bool test_demodulate_throughput()
+{
+    const size_t nx = 2448;
+    const size_t ny = 2048;
+    std::vector<double> phase, contrast;
+    std::vector<unsigned short int> image = get_test_image(nx, ny, 0.2, 0.05, &phase, &contrast);
+    std::filesystem::path fp_wisdom = std::filesystem::temp_directory_path() / "cispp_test_demodulate.wisdom";
+
+    cispp::DemodOptions opts;
+    opts.effort = cispp::FFTWEffort::Estimate;
+    opts.wisdom_file = fp_wisdom;
+    cispp::LinearDemodulator demod(nx, ny, opts);
+    cispp::DemodResult result;
+    demod.Demodulate(image.data(), &result);
+
+    const size_t nframes = 3;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (size_t iframe = 0; iframe < nframes; iframe++) {
+        demod.Demodulate(image.data(), &result);
+    }
+    auto stop = std::chrono::high_resolution_clock::now();
+    const double duration = std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count() * 1e-6;
+    std::cout << "frame rate = " << nframes / duration << " fps" << '\n';
+
+    const bool wisdom_saved = std::filesystem::exists(fp_wisdom);
+    std::filesystem::remove(fp_wisdom);
+    return wisdom_saved && result.phase.size() == nx * ny;
+}
+
+
+#endif  // CISPP_HAVE_FFTW
+
+
+int main()
+{
+    std::cout << "test_demodulate_pixelated: " << (test_demodulate_pixelated() ? "passed" : "failed") << '\n';
+    std::cout << "test_demodulate_pixelated_atan2: " << (test_demodulate_pixelated_atan2() ? "passed" : "failed") << '\n';
+    std::cout << "test_demodulate_pixelated_throughput: " << (test_demodulate_pixelated_throughput() ? "passed" : "failed") << '\n';
+#ifdef CISPP_HAVE_FFTW
+    std::cout << "test_demodulate: " << (test_demodulate() ? "passed" : "failed") << '\n';
+    std::cout << "test_demodulate_throughput: " << (test_demodulate_throughput() ? "passed" : "failed") << '\n';
+#endif
+    return 0;
+}
@@ -0,0 +1,173 @@
+#include <iostream>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+#include "include/h5output.h"
+
+
+/**
+ * @brief test frames of 12-bit counts
+ */
+std::vector<unsigned short int> get_test_frames(size_t npix)
+{
+    std::vector<unsigned short int> frames(npix);
+    for (size_t i = 0; i < npix; i++) {
+        frames[i] = static_cast<unsigned short int>((i * 37) % 4096);
+    }
+    return frames;
+}
+
+
+/**
+ * @brief read back a whole (frame, y, x) uint16 dataset
+ */
+std::vector<unsigned short int> read_dataset(const std::string& fpath, const std::string& name, hsize_t dims[3])
+{
+    hid_t file = H5Fopen(fpath.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+    hid_t dataset = H5Dopen2(file, name.c_str(), H5P_DEFAULT);
+    hid_t space = H5Dget_space(dataset);
+    H5Sget_simple_extent_dims(space, dims, nullptr);
+    std::vector<unsigned short int> frames(dims[0] * dims[1] * dims[2]);
+    H5Dread(dataset, H5T_NATIVE_USHORT, H5S_ALL, H5S_ALL, H5P_DEFAULT, frames.data());
+    H5Sclose(space);
+    H5Dclose(dataset);
+    H5Fclose(file);
+    return frames;
+}
+
+
+/**
+ * @brief test that frames round-trip, for synchronous and asynchronous writes and a frame count that is not a 
+ * multiple of the chunk size
+ */
+bool test_round_trip()
+{
+    const size_t nx = 40;
+    const size_t ny = 30;
+    const size_t nframes = 11;
+    std::vector<unsigned short int> frames = get_test_frames(nx * ny * nframes);
+    std::filesystem::path fpath = std::filesystem::temp_directory_path() / "cispp_test_h5output.h5";
+
+    for (size_t queue_depth : {0, 3})
+    {
+        cispp::H5WriterOptions opts;
+        opts.chunk_frames = 4;
+        opts.chunk_rows = 16;
+        opts.queue_depth = queue_depth;
+        {
+            cispp::H5FrameWriter writer(fpath, "frames", nx, ny, 12, opts);
+            for (size_t iframe = 0; iframe < nframes; iframe++) {
+                writer.Write(&frames[iframe * nx * ny]);
+            }
+            if (writer.GetFrameCount() != nframes || writer.GetChunkRows() != 16 || writer.GetChunkCols() != nx) {
+                return false;
+            }
+        }
+        hsize_t dims[3];
+        std::vector<unsigned short int> frames_r = read_dataset(fpath, "frames", dims);
+        if (dims[0] != nframes || dims[1] != ny || dims[2] != nx || frames_r != frames) {
+            return false;
+        }
+    }
+    std::filesystem::remove(fpath);
+    return true;
+}
+
+
+/**
+ * @brief test that attributes are written to the dataset
+ */
+bool test_attributes()
+{
+    const size_t nx = 8;
+    const size_t ny = 4;
+    std::vector<unsigned short int> frame = get_test_frames(nx * ny);
+    std::filesystem::path fpath = std::filesystem::temp_directory_path() / "cispp_test_h5output_attr.h5";
+    std::vector<double> wl {464e-9, 465e-9, 466e-9};
+    {
+        cispp::H5FrameWriter writer(fpath, "frames", nx, ny, 12);
+        writer.SetAttribute("comment", "test");
+        writer.SetAttribute("wavelength", wl);
+        writer.SetAttribute("exposure_time", 0.25);
+        writer.Write(frame.data());
+        writer.Close();
+    }
+
+    hid_t file = H5Fopen(fpath.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+    hid_t dataset = H5Dopen2(file, "frames", H5P_DEFAULT);
+    double bit_depth, exposure_time;
+    std::vector<double> wl_r(wl.size());
+    char comment[5] = {0};
+    hid_t attr = H5Aopen(dataset, "bit_depth", H5P_DEFAULT);
+    H5Aread(attr, H5T_NATIVE_DOUBLE, &bit_depth);
+    H5Aclose(attr);
+    attr = H5Aopen(dataset, "exposure_time", H5P_DEFAULT);
+    H5Aread(attr, H5T_NATIVE_DOUBLE, &exposure_time);
+    H5Aclose(attr);
+    attr = H5Aopen(dataset, "wavelength", H5P_DEFAULT);
+    H5Aread(attr, H5T_NATIVE_DOUBLE, wl_r.data());
+    H5Aclose(attr);
+    attr = H5Aopen(dataset, "comment", H5P_DEFAULT);
+    hid_t type = H5Aget_type(attr);
+    H5Aread(attr, type, comment);
+    H5Tclose(type);
+    H5Aclose(attr);
+    H5Dclose(dataset);
+    H5Fclose(file);
+    std::filesystem::remove(fpath);
+
+    return bit_depth == 12 && exposure_time == 0.25 && wl_r == wl && std::string(comment) == "test";
+}
+
+
+/**
+ * @brief test several asynchronous writers at once, created and closed while the others' writer threads are busy
+ */
+bool test_concurrent_writers()
+{
+    const size_t nx = 64;
+    const size_t ny = 48;
+    const size_t nframes = 20;
+    const size_t nwriters = 4;
+    std::vector<unsigned short int> frames = get_test_frames(nx * ny * nframes);
+    std::vector<std::filesystem::path> fpaths;
+    for (size_t iw = 0; iw < nwriters; iw++) {
+        fpaths.push_back(std::filesystem::temp_directory_path() / ("cispp_test_h5output_" + std::to_string(iw) + ".h5"));
+    }
+
+    cispp::H5WriterOptions opts;
+    opts.chunk_frames = 2;
+    opts.queue_depth = 4;
+    std::vector<std::thread> threads;
+    for (size_t iw = 0; iw < nwriters; iw++)
+    {
+        threads.emplace_back([&, iw]() {
+            cispp::H5FrameWriter writer(fpaths[iw], "frames", nx, ny, 12, opts);
+            for (size_t iframe = 0; iframe < nframes; iframe++) {
+                writer.Write(&frames[iframe * nx * ny]);
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    bool ok = true;
+    for (const std::filesystem::path& fpath : fpaths)
+    {
+        hsize_t dims[3];
+        ok = ok && read_dataset(fpath, "frames", dims) == frames && dims[0] == nframes;
+        std::filesystem::remove(fpath);
+    }
+    return ok;
+}
+
+
+int main()
+{
+    std::cout << "test_round_trip: " << (test_round_trip() ? "passed" : "failed") << '\n';
+    std::cout << "test_attributes: " << (test_attributes() ? "passed" : "failed") << '\n';
+    std::cout << "test_concurrent_writers: " << (test_concurrent_writers() ? "passed" : "failed") << '\n';
+    return 0;
+}
@@ -0,0 +1,144 @@
+#include <algorithm>
+#include <iostream>
+#include <filesystem>
+#include <vector>
+#include "include/imageio.h"
+
+
+/**
+ * @brief test image of 12-bit counts
+ */
+std::vector<unsigned short int> get_test_image(size_t npix)
+{
+    std::vector<unsigned short int> image(npix);
+    for (size_t i = 0; i < npix; i++) {
+        image[i] = static_cast<unsigned short int>((i * 37) % 4096);
+    }
+    return image;
+}
+
+
+/**
+ * @brief test that a PGM file round-trips, with the right maxval and big-endian pixels, for both write methods
+ */
+bool test_pgm()
+{
+    const size_t nx = 31;
+    const size_t ny = 17;
+    std::vector<unsigned short int> image = get_test_image(nx * ny);
+    std::filesystem::path fpath = std::filesystem::temp_directory_path() / "cispp_test_imageio.pgm";
+
+    for (cispp::WriteMethod method : {cispp::WriteMethod::Write, cispp::WriteMethod::MemoryMap})
+    {
+        cispp::WritePGM(fpath, image.data(), nx, ny, 12, method);
+        size_t nx_r, ny_r;
+        int maxval;
+        std::vector<unsigned short int> image_r = cispp::ReadPGM(fpath, &nx_r, &ny_r, &maxval);
+        if (nx_r != nx || ny_r != ny || maxval != 4095 || image_r != image) {
+            return false;
+        }
+        std::string header = "P5\n31 17\n4095\n";
+        if (std::filesystem::file_size(fpath) != header.size() + 2 * nx * ny) {
+            return false;
+        }
+    }
+    std::filesystem::remove(fpath);
+    return true;
+}
+
+
+/**
+ * @brief test that multi-frame container files round-trip, whether written at once or frame by frame
+ */
+bool test_frame_stack()
+{
+    const size_t nx = 20;
+    const size_t ny = 10;
+    const size_t nframes = 5;
+    std::vector<unsigned short int> frames = get_test_image(nx * ny * nframes);
+    std::filesystem::path fpath = std::filesystem::temp_directory_path() / "cispp_test_imageio.cisf";
+    cispp::FrameStackHeader header;
+
+    for (cispp::WriteMethod method : {cispp::WriteMethod::Write, cispp::WriteMethod::MemoryMap})
+    {
+        cispp::WriteFrameStack(fpath, frames.data(), nx, ny, nframes, 12, method);
+        if (cispp::ReadFrameStack(fpath, &header) != frames || header.nframes != nframes || header.bit_depth != 12) {
+            return false;
+        }
+    }
+    {
+        cispp::FrameStackWriter writer(fpath, nx, ny, 12);
+        writer.Write(frames.data(), 2);
+        for (size_t iframe = 2; iframe < nframes; iframe++) {
+            writer.Write(&frames[iframe * nx * ny]);
+        }
+    }
+    bool ok = (cispp::ReadFrameStack(fpath, &header) == frames && header.nframes == nframes);
+    std::filesystem::remove(fpath);
+    return ok;
+}
+
+
+/**
+ * @brief test that raw dumps hold exactly the pixel data
+ */
+bool test_raw()
+{
+    std::vector<unsigned short int> image = get_test_image(1000);
+    std::filesystem::path fpath = std::filesystem::temp_directory_path() / "cispp_test_imageio.raw";
+    cispp::WriteRaw(fpath, image.data(), image.size(), cispp::WriteMethod::MemoryMap);
+    bool ok = (std::filesystem::file_size(fpath) == 2 * image.size());
+    std::filesystem::remove(fpath);
+    return ok;
+}
+
+
+/**
+ * @brief test that frames written through a memory mapping read back, through both the mapping and ReadFrameStack
+ */
+bool test_mapped_frame_stack()
+{
+    const size_t nx = 20;
+    const size_t ny = 10;
+    const size_t nframes = 5;
+    std::vector<unsigned short int> frames = get_test_image(nx * ny * nframes);
+    std::filesystem::path fpath = std::filesystem::temp_directory_path() / "cispp_test_imageio_mapped.cisf";
+    {
+        cispp::MappedFrameStack stack = cispp::MappedFrameStack::Create(fpath, nx, ny, nframes, 12);
+        for (size_t iframe = 0; iframe < nframes; iframe++) {
+            std::copy_n(&frames[iframe * nx * ny], nx * ny, stack.GetWritableFrame(iframe));
+        }
+        stack.Flush();
+    }
+    if (std::filesystem::file_size(fpath) != cispp::FrameStackHeader::size + 2 * nx * ny * nframes) {
+        return false;
+    }
+
+    cispp::FrameStackHeader header;
+    if (cispp::ReadFrameStack(fpath, &header) != frames || header.nframes != nframes || header.bit_depth != 12) {
+        return false;
+    }
+
+    cispp::MappedFrameStack stack = cispp::MappedFrameStack::Open(fpath);
+    std::vector<unsigned short int> frames_r(stack.GetFrame(0), stack.GetFrame(0) + nx * ny * nframes);
+    bool read_only_ok = false;
+    try {
+        stack.GetWritableFrame(0);
+    }
+    catch (const std::logic_error& e) {
+        read_only_ok = true;
+    }
+    stack.Close();
+    std::filesystem::remove(fpath);
+    return read_only_ok && frames_r == frames && stack.GetHeader().nx == nx;
+}
+
+
+int main()
+{
+    std::cout << "test_pgm: " << (test_pgm() ? "passed" : "failed") << '\n';
+    std::cout << "test_frame_stack: " << (test_frame_stack() ? "passed" : "failed") << '\n';
+    std::cout << "test_raw: " << (test_raw() ? "passed" : "failed") << '\n';
+    std::cout << "test_mapped_frame_stack: " << (test_mapped_frame_stack() ? "passed" : "failed") << '\n';
+    return 0;
+}
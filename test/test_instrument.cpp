@@ -5,6 +5,7 @@
 #include <vector>
 #include <chrono>
 #include <filesystem>
+#include <fstream>
 #include <Eigen/Dense>
 
 #include "include/component.h"
@@ -93,13 +94,629 @@ bool TestCaptureInstVsMueller(std::string instname, std::string specname)
         std::cout << "duration = " << duration.count() * 1e-6 << " s" << std::endl;
     }
 
-    inst->SaveImage("TestCapture" + specname + instname + ".pbm", &image);
-    inst_m->SaveImage("TestCapture" + specname + instname + "ForceMueller.pbm", &image_m);
+    inst->SaveImage("TestCapture" + specname + instname + ".pgm", &image);
+    inst_m->SaveImage("TestCapture" + specname + instname + "ForceMueller.pgm", &image_m);
 
     return Test2ImagesSame(image, image_m);
 }
 
 
+/**
+ * @brief benchmark multithreaded Capture against the serial path, and test that their outputs are identical
+ * 
+ * @param instname 
+ * @param specname 
+ * @return true 
+ * @return false 
+ */
+bool TestCaptureParallel(std::string instname, std::string specname)
+{
+    std::filesystem::path rootPath = cispp::getRootPath();
+    std::string fp_config = (((rootPath / "test") / "config") / (instname + ".yaml"));
+    auto inst = cispp::LoadInstrument(fp_config);
+    std::vector<unsigned short int> image_s(inst->camera.sensor_format_x * inst->camera.sensor_format_y);
+    std::vector<unsigned short int> image_p(inst->camera.sensor_format_x * inst->camera.sensor_format_y);
+
+    cispp::CaptureOptions opts_s;
+    opts_s.nthreads = 1;
+    cispp::CaptureOptions opts_p;
+    opts_p.nthreads = 0;  // all hardware threads
+    opts_p.tile_rows = 8;
+
+    double wavelength = 465e-9;
+    double flux = 500;
+    cispp::Spectrum spec = cispp::gaussian(wavelength, 0.1e-9, flux, 15, 4);
+
+    auto capture = [&](std::vector<unsigned short int>& image, cispp::CaptureOptions& opts) {
+        auto start = std::chrono::high_resolution_clock::now();
+        if (specname == "Monochrome") {
+            inst->Capture(wavelength, flux, &image, opts);
+        }
+        else {
+            inst->Capture(spec.wavelength, spec.s0, &image, opts);
+        }
+        auto stop = std::chrono::high_resolution_clock::now();
+        return std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count() * 1e-6;
+    };
+
+    double duration_s = capture(image_s, opts_s);
+    double duration_p = capture(image_p, opts_p);
+    std::cout << "nthreads = " << cispp::GetHardwareThreadCount() << '\n';
+    std::cout << "duration (serial) = " << duration_s << " s" << '\n';
+    std::cout << "duration (parallel) = " << duration_p << " s" << '\n';
+    std::cout << "speedup = " << duration_s / duration_p << '\n';
+
+    return Test2ImagesSame(image_s, image_p);
+}
+
+
+/**
+ * @brief test that captures using the geometry cache are identical to uncached captures, including after a component 
+ * tilt changes, and report the time saved on repeated captures
+ * 
+ * @param instname 
+ * @param force_mueller 
+ * @return true 
+ * @return false 
+ */
+bool TestCaptureGeometryCache(std::string instname, bool force_mueller)
+{
+    std::filesystem::path rootPath = cispp::getRootPath();
+    std::string fp_config = (((rootPath / "test") / "config") / (instname + ".yaml"));
+    auto inst = cispp::LoadInstrument(fp_config, force_mueller);
+    auto inst_c = cispp::LoadInstrument(fp_config, force_mueller);
+    inst_c->EnableGeometryCache();
+    std::vector<unsigned short int> image(inst->camera.sensor_format_x * inst->camera.sensor_format_y);
+    std::vector<unsigned short int> image_c(inst->camera.sensor_format_x * inst->camera.sensor_format_y);
+
+    double wavelength = 465e-9;
+    double flux = 500;
+    bool same = true;
+
+    auto capture = [&](std::unique_ptr<cispp::Instrument>& inst_i, std::vector<unsigned short int>& image_i) {
+        auto start = std::chrono::high_resolution_clock::now();
+        inst_i->Capture(wavelength, flux, &image_i);
+        auto stop = std::chrono::high_resolution_clock::now();
+        return std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count() * 1e-6;
+    };
+
+    double duration = capture(inst, image);
+    double duration_c0 = capture(inst_c, image_c);  // builds cache
+    same = same && Test2ImagesSame(image, image_c);
+    double duration_c1 = capture(inst_c, image_c);
+    same = same && Test2ImagesSame(image, image_c);
+    std::cout << "duration (no cache) = " << duration << " s" << '\n';
+    std::cout << "duration (building cache) = " << duration_c0 << " s" << '\n';
+    std::cout << "duration (cached) = " << duration_c1 << " s" << '\n';
+
+    // cache must be rebuilt after a change of tilt
+    inst->components[1]->tilt_x = 0.02;
+    inst_c->components[1]->tilt_x = 0.02;
+    capture(inst, image);
+    capture(inst_c, image_c);
+    same = same && Test2ImagesSame(image, image_c);
+
+    return same;
+}
+
+
+/**
+ * @brief test the coherence-based spectral capture against the full spectral integral
+ * 
+ * @param instname 
+ * @return true 
+ * @return false 
+ */
+bool TestCaptureCoherence(std::string instname)
+{
+    std::filesystem::path rootPath = cispp::getRootPath();
+    std::string fp_config = (((rootPath / "test") / "config") / (instname + ".yaml"));
+    auto inst = cispp::LoadInstrument(fp_config);
+    auto inst_sd = dynamic_cast<cispp::InstrumentSingleDelay*>(inst.get());
+    std::vector<unsigned short int> image(inst->camera.sensor_format_x * inst->camera.sensor_format_y);
+    std::vector<unsigned short int> image_c(inst->camera.sensor_format_x * inst->camera.sensor_format_y);
+
+    double flux = 500;
+    cispp::Spectrum spec = cispp::gaussian(465e-9, 0.1e-9, flux, 200, 6);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    inst->Capture(spec.wavelength, spec.s0, &image);
+    auto stop = std::chrono::high_resolution_clock::now();
+    std::cout << "duration = " << std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count() * 1e-6 << " s" << '\n';
+
+    start = std::chrono::high_resolution_clock::now();
+    cispp::CoherenceCaptureReport report = inst_sd->CaptureCoherence(spec.wavelength, spec.s0, &image_c);
+    stop = std::chrono::high_resolution_clock::now();
+    std::cout << "duration (coherence) = " << std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count() * 1e-6 << " s" << '\n';
+
+    int err_max = 0;
+    for (size_t i = 0; i < image.size(); i++) {
+        err_max = std::max(err_max, std::abs(static_cast<int>(image[i]) - static_cast<int>(image_c[i])));
+    }
+    std::cout << "kappa = " << report.kappa << '\n';
+    std::cout << "error_bound = " << report.error_bound << '\n';
+    std::cout << "error_max (sampled) = " << report.error_max << '\n';
+    std::cout << "error_max (all pixels) = " << err_max << '\n';
+
+    // sampled error should be representative of the whole image, to within truncation to integer counts
+    bool ok = (err_max <= report.error_max + 2 && err_max < 0.01 * flux);
+
+    // zero flux: the same dark frame as Capture
+    std::vector<double> s0_zero(spec.s0.size(), 0.);
+    inst->Capture(spec.wavelength, s0_zero, &image);
+    report = inst_sd->CaptureCoherence(spec.wavelength, s0_zero, &image_c);
+    return ok && image_c == image && report.wavelength_ref == 0 && report.error_max == 0;
+}
+
+
+/**
+ * @brief test the coherence lookup-table spectral capture against the full spectral integral, for a spectrum broad 
+ * enough that the contrast varies across the sensor
+ * 
+ * @param instname 
+ * @return true 
+ * @return false 
+ */
+bool TestCaptureCoherenceTable(std::string instname)
+{
+    std::filesystem::path rootPath = cispp::getRootPath();
+    std::string fp_config = (((rootPath / "test") / "config") / (instname + ".yaml"));
+    auto inst = cispp::LoadInstrument(fp_config);
+    auto inst_sd = dynamic_cast<cispp::InstrumentSingleDelay*>(inst.get());
+    std::vector<unsigned short int> image(inst->camera.sensor_format_x * inst->camera.sensor_format_y);
+    std::vector<unsigned short int> image_c(inst->camera.sensor_format_x * inst->camera.sensor_format_y);
+
+    double flux = 500;
+    cispp::Spectrum spec = cispp::gaussian(465e-9, 0.3e-9, flux, 400, 6);
+    const double max_error = 0.01;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    inst->Capture(spec.wavelength, spec.s0, &image);
+    auto stop = std::chrono::high_resolution_clock::now();
+    std::cout << "duration = " << std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count() * 1e-6 << " s" << '\n';
+
+    start = std::chrono::high_resolution_clock::now();
+    cispp::CoherenceCaptureReport report = inst_sd->CaptureCoherenceTable(spec.wavelength, spec.s0, &image_c, max_error);
+    stop = std::chrono::high_resolution_clock::now();
+    std::cout << "duration (coherence table) = " << std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count() * 1e-6 << " s" << '\n';
+
+    int err_max = 0;
+    for (size_t i = 0; i < image.size(); i++) {
+        err_max = std::max(err_max, std::abs(static_cast<int>(image[i]) - static_cast<int>(image_c[i])));
+    }
+    std::cout << "error_bound = " << report.error_bound << '\n';
+    std::cout << "error_max (sampled) = " << report.error_max << '\n';
+    std::cout << "error_max (all pixels) = " << err_max << '\n';
+
+    bool ok = (report.error_bound <= max_error && err_max <= report.error_max + 2 && err_max < 0.01 * flux);
+
+    // zero flux: the same dark frame as Capture
+    std::vector<double> s0_zero(spec.s0.size(), 0.);
+    inst->Capture(spec.wavelength, s0_zero, &image);
+    report = inst_sd->CaptureCoherenceTable(spec.wavelength, s0_zero, &image_c, max_error);
+    return ok && image_c == image && report.wavelength_ref == 0 && report.error_max == 0;
+}
+
+
+/**
+ * @brief test a Gauss-Hermite quadrature capture of a Gaussian line against the trapezoidal capture on a fine grid
+ * 
+ * @param instname 
+ * @return true 
+ * @return false 
+ */
+bool TestCaptureQuadrature(std::string instname)
+{
+    std::filesystem::path rootPath = cispp::getRootPath();
+    std::string fp_config = (((rootPath / "test") / "config") / (instname + ".yaml"));
+    auto inst = cispp::LoadInstrument(fp_config);
+    std::vector<unsigned short int> image(inst->camera.sensor_format_x * inst->camera.sensor_format_y);
+    std::vector<unsigned short int> image_q(inst->camera.sensor_format_x * inst->camera.sensor_format_y);
+
+    const double wl0 = 465e-9;
+    const double wlsigma = 0.1e-9;
+    const double flux = 500;
+    cispp::Spectrum spec = cispp::gaussian(wl0, wlsigma, flux, 400, 8);
+    cispp::QuadratureGrid grid = cispp::gauss_hermite({{wl0, wlsigma, flux}}, 64);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    inst->Capture(spec.wavelength, spec.s0, &image);
+    auto stop = std::chrono::high_resolution_clock::now();
+    std::cout << "duration (" << spec.wavelength.size() << " wavelengths) = " << std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count() * 1e-6 << " s" << '\n';
+
+    start = std::chrono::high_resolution_clock::now();
+    inst->CaptureQuadrature(grid, &image_q);
+    stop = std::chrono::high_resolution_clock::now();
+    std::cout << "duration (" << grid.wavelength.size() << " Gauss-Hermite nodes) = " << std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count() * 1e-6 << " s" << '\n';
+
+    int err_max = 0;
+    for (size_t i = 0; i < image.size(); i++) {
+        err_max = std::max(err_max, std::abs(static_cast<int>(image[i]) - static_cast<int>(image_q[i])));
+    }
+    std::cout << "error_max = " << err_max << '\n';
+    return err_max <= 1;
+}
+
+
+/**
+ * @brief test the compiled Mueller pipeline against the uncompiled Mueller pipeline. The two differ only by rounding, 
+ * so images may differ by at most 1 count
+ * 
+ * @param instname 
+ * @param specname 
+ * @return true 
+ * @return false 
+ */
+bool TestCaptureCompiled(std::string instname, std::string specname)
+{
+    std::filesystem::path rootPath = cispp::getRootPath();
+    std::string fp_config = (((rootPath / "test") / "config") / (instname + ".yaml"));
+    auto inst = cispp::LoadInstrument(fp_config, true);
+    auto inst_c = cispp::LoadInstrument(fp_config, true);
+    inst_c->Compile();
+    std::vector<unsigned short int> image(inst->camera.sensor_format_x * inst->camera.sensor_format_y);
+    std::vector<unsigned short int> image_c(inst->camera.sensor_format_x * inst->camera.sensor_format_y);
+
+    double wavelength = 465e-9;
+    double flux = 500;
+    cispp::Spectrum spec = cispp::gaussian(wavelength, 0.1e-9, flux, 50, 6);
+
+    auto capture = [&](std::unique_ptr<cispp::Instrument>& inst_i, std::vector<unsigned short int>& image_i) {
+        auto start = std::chrono::high_resolution_clock::now();
+        if (specname == "Monochrome") {
+            inst_i->Capture(wavelength, flux, &image_i);
+        }
+        else {
+            inst_i->Capture(spec.wavelength, spec.s0, &image_i);
+        }
+        auto stop = std::chrono::high_resolution_clock::now();
+        return std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count() * 1e-6;
+    };
+    auto max_diff = [&]() {
+        int diff = 0;
+        for (size_t i = 0; i < image.size(); i++) {
+            diff = std::max(diff, std::abs(static_cast<int>(image[i]) - static_cast<int>(image_c[i])));
+        }
+        return diff;
+    };
+
+    std::cout << "duration = " << capture(inst, image) << " s" << '\n';
+    std::cout << "duration (compiled) = " << capture(inst_c, image_c) << " s" << '\n';
+    bool ok = (max_diff() <= 1);
+
+    // compiled pipeline must follow a change of orientation
+    inst->components[1]->orientation += 0.1;
+    inst_c->components[1]->orientation += 0.1;
+    capture(inst, image);
+    capture(inst_c, image_c);
+    return ok && (max_diff() <= 1);
+}
+
+
+/**
+ * @brief test single-precision capture against double-precision capture, for the fast path and the compiled Mueller 
+ * path
+ * 
+ * @param instname 
+ * @param specname 
+ * @param force_mueller 
+ * @return true 
+ * @return false 
+ */
+bool TestCapturePrecision(std::string instname, std::string specname, bool force_mueller)
+{
+    std::filesystem::path rootPath = cispp::getRootPath();
+    std::string fp_config = (((rootPath / "test") / "config") / (instname + ".yaml"));
+    auto inst = cispp::LoadInstrument(fp_config, force_mueller);
+    if (force_mueller) {
+        inst->Compile();
+    }
+
+    double wavelength = 465e-9;
+    double flux = 500;
+    cispp::Spectrum spec = cispp::gaussian(wavelength, 0.1e-9, flux, 50, 6);
+
+    cispp::PrecisionReport report;
+    if (specname == "Monochrome") {
+        report = inst->ComparePrecision(wavelength, flux);
+    }
+    else {
+        report = inst->ComparePrecision(spec.wavelength, spec.s0);
+    }
+    std::cout << "duration (double) = " << report.duration_double << " s" << '\n';
+    std::cout << "duration (single) = " << report.duration_single << " s" << '\n';
+    std::cout << "max_count_error = " << report.max_count_error << '\n';
+    std::cout << "max_phase_error = " << report.max_phase_error << '\n';
+
+    return (report.max_count_error <= 1 && report.max_phase_error < 1e-3);
+}
+
+
+/**
+ * @brief test batch capture of a time series of spectra against frame-by-frame capture
+ * 
+ * @param instname 
+ * @param force_mueller 
+ * @return true 
+ * @return false 
+ */
+bool TestCaptureBatch(std::string instname, bool force_mueller)
+{
+    std::filesystem::path rootPath = cispp::getRootPath();
+    std::string fp_config = (((rootPath / "test") / "config") / (instname + ".yaml"));
+    auto inst = cispp::LoadInstrument(fp_config, force_mueller);
+    const size_t npix = inst->camera.sensor_format_x * inst->camera.sensor_format_y;
+
+    // Doppler-shifting, brightening line on a shared wavelength grid. Fewer frames and bins for the (slow) Mueller model
+    const size_t nframes = force_mueller ? 4 : 8;
+    const double wl0 = 465e-9;
+    const double wlsigma = 0.05e-9;
+    cispp::Spectrum spec = cispp::gaussian(wl0, wlsigma, 500, force_mueller ? 20 : 100, 8);
+    std::vector<std::vector<double>> spec_flux(nframes, std::vector<double>(spec.wavelength.size()));
+    for (size_t iframe = 0; iframe < nframes; iframe++)
+    {
+        const double shift = 0.02e-9 * iframe;
+        for (size_t iwl = 0; iwl < spec.wavelength.size(); iwl++) {
+            spec_flux[iframe][iwl] = (1 + 0.1 * iframe) * spec.s0[iwl] * 
+                                     exp(-(pow(spec.wavelength[iwl] - wl0 - shift, 2) - pow(spec.wavelength[iwl] - wl0, 2)) / (2 * pow(wlsigma, 2)));
+        }
+    }
+
+    std::vector<unsigned short int> frames(nframes * npix);
+    auto start = std::chrono::high_resolution_clock::now();
+    inst->CaptureBatch(spec.wavelength, spec_flux, &frames);
+    auto stop = std::chrono::high_resolution_clock::now();
+    std::cout << "duration (batch) = " << std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count() * 1e-6 << " s" << '\n';
+
+    std::vector<unsigned short int> image(npix);
+    int max_diff = 0;
+    start = std::chrono::high_resolution_clock::now();
+    for (size_t iframe = 0; iframe < nframes; iframe++)
+    {
+        inst->Capture(spec.wavelength, spec_flux[iframe], &image);
+        for (size_t i = 0; i < npix; i++) {
+            max_diff = std::max(max_diff, std::abs(static_cast<int>(image[i]) - static_cast<int>(frames[iframe * npix + i])));
+        }
+    }
+    stop = std::chrono::high_resolution_clock::now();
+    std::cout << "duration (frame by frame) = " << std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count() * 1e-6 << " s" << '\n';
+    std::cout << "max_diff = " << max_diff << '\n';
+
+    // empty batches, with a shared wavelength grid and with a grid per frame
+    std::vector<unsigned short int> frames_empty;
+    inst->CaptureBatch(spec.wavelength, {}, &frames_empty);
+    inst->CaptureBatch(std::vector<std::vector<double>>(), {}, &frames_empty);
+
+    return (max_diff <= 1);
+}
+
+
+/**
+ * @brief test that capturing into a memory-mapped frame stack gives the same frames as capturing into vectors
+ * 
+ * @return true 
+ * @return false 
+ */
+bool TestCaptureFrameStack(std::string instname)
+{
+    std::filesystem::path rootPath = cispp::getRootPath();
+    std::string fp_config = (((rootPath / "test") / "config") / (instname + ".yaml"));
+    auto inst = cispp::LoadInstrument(fp_config);
+    const size_t npix = inst->camera.sensor_format_x * inst->camera.sensor_format_y;
+    std::filesystem::path fpath = std::filesystem::temp_directory_path() / ("cispp_test_" + instname + ".cisf");
+
+    cispp::Spectrum spec = cispp::gaussian(465e-9, 0.05e-9, 500, 50, 8);
+    std::vector<std::vector<double>> spec_flux {spec.s0, spec.s0};
+    for (double& f : spec_flux[1]) {
+        f *= 2;
+    }
+    std::vector<unsigned short int> frames(3 * npix);
+    inst->Capture(465e-9, 1000, frames.data());
+    inst->CaptureBatch(spec.wavelength, spec_flux, &frames[npix]);
+    {
+        cispp::MappedFrameStack stack = inst->CreateFrameStack(fpath, 3);
+        inst->Capture(465e-9, 1000, stack.GetWritableFrame(0));
+        inst->CaptureBatch(spec.wavelength, spec_flux, stack.GetWritableFrame(1));
+    }
+
+    cispp::FrameStackHeader header;
+    std::vector<unsigned short int> frames_r = cispp::ReadFrameStack(fpath, &header);
+    std::filesystem::remove(fpath);
+    return header.nframes == 3 && header.bit_depth == static_cast<uint32_t>(inst->camera.bit_depth) && frames_r == frames;
+}
+
+
+/**
+ * @brief test that captures with the sensor model are reproducible for any thread count and tiling, and are clipped 
+ * to the camera bit depth
+ * 
+ * @return true 
+ * @return false 
+ */
+bool TestCaptureSensor(std::string instname)
+{
+    std::filesystem::path rootPath = cispp::getRootPath();
+    std::string fp_config = (((rootPath / "test") / "config") / (instname + ".yaml"));
+    auto inst = cispp::LoadInstrument(fp_config);
+    const size_t npix = inst->camera.sensor_format_x * inst->camera.sensor_format_y;
+    cispp::Spectrum spec = cispp::gaussian(465e-9, 0.05e-9, 20000, 50, 8);
+
+    std::vector<unsigned short int> image(npix), image_noiseless(npix), image_tiled(npix);
+    cispp::CaptureOptions opts;
+    auto start = std::chrono::high_resolution_clock::now();
+    inst->Capture(spec.wavelength, spec.s0, &image_noiseless, opts);
+    auto stop = std::chrono::high_resolution_clock::now();
+    std::cout << "duration (no sensor model) = " << std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count() * 1e-6 << " s" << '\n';
+
+    opts.sensor.enable = true;
+    opts.sensor.seed = 42;
+    start = std::chrono::high_resolution_clock::now();
+    inst->Capture(spec.wavelength, spec.s0, &image, opts);
+    stop = std::chrono::high_resolution_clock::now();
+    std::cout << "duration (sensor model) = " << std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count() * 1e-6 << " s" << '\n';
+
+    opts.nthreads = 3;
+    opts.tile_rows = 5;
+    opts.tile_cols = 7;
+    inst->Capture(spec.wavelength, spec.s0, &image_tiled, opts);
+
+    const unsigned short int max_count = (1 << inst->camera.bit_depth) - 1;
+    bool clipped = false;
+    for (size_t i = 0; i < npix; i++) 
+    {
+        if (image[i] > max_count) {
+            return false;
+        }
+        clipped |= (image_noiseless[i] > max_count && image[i] == max_count);
+    }
+    std::cout << "clipped = " << clipped << '\n';
+    return image == image_tiled && image != image_noiseless && clipped;
+}
+
+
+/**
+ * @brief test that an instrument loaded from a snapshot, with and without its geometry cache, has the same type and 
+ * captures the same images as the instrument loaded from its config file
+ * 
+ * @param instname 
+ * @param force_mueller 
+ * @return true 
+ * @return false 
+ */
+bool TestLoadSnapshot(std::string instname, bool force_mueller)
+{
+    std::filesystem::path rootPath = cispp::getRootPath();
+    std::string fp_config = (((rootPath / "test") / "config") / (instname + ".yaml"));
+    std::filesystem::path fpath = std::filesystem::temp_directory_path() / ("cispp_test_" + instname + ".snap");
+    std::filesystem::path fpath_g = std::filesystem::temp_directory_path() / ("cispp_test_" + instname + "_g.snap");
+
+    auto start = std::chrono::high_resolution_clock::now();
+    auto inst = cispp::LoadInstrument(fp_config, force_mueller);
+    auto mid = std::chrono::high_resolution_clock::now();
+    inst->SaveSnapshot(fpath);
+    inst->SaveSnapshot(fpath_g, true);
+    auto mid_s = std::chrono::high_resolution_clock::now();
+    auto inst_s = cispp::LoadInstrumentSnapshot(fpath);
+    auto stop = std::chrono::high_resolution_clock::now();
+    auto inst_g = cispp::LoadInstrumentSnapshot(fpath_g);
+    std::cout << "duration (config) = " << std::chrono::duration<double>(mid - start).count() << " s" << '\n';
+    std::cout << "duration (snapshot) = " << std::chrono::duration<double>(stop - mid_s).count() << " s" << '\n';
+    std::filesystem::remove(fpath);
+    std::filesystem::remove(fpath_g);
+
+    const size_t npix = inst->camera.sensor_format_x * inst->camera.sensor_format_y;
+    std::vector<unsigned short int> image(npix), image_s(npix), image_g(npix);
+    cispp::Spectrum spec = cispp::gaussian(465e-9, 0.05e-9, 500, 50, 8);
+    inst->Capture(spec.wavelength, spec.s0, &image);
+    inst_s->Capture(spec.wavelength, spec.s0, &image_s);
+    inst_g->Capture(spec.wavelength, spec.s0, &image_g);
+    return (inst_s->type == inst->type && inst_g->type == inst->type && inst_s->fp_config == inst->fp_config && 
+            image_s == image && image_g == image);
+}
+
+
+/**
+ * @brief test that a crystal given Sellmeier coefficients in the config file matches the crystal given the material 
+ * name, when the coefficients are the material's
+ * 
+ * @return true 
+ * @return false 
+ */
+bool TestConfigSellmeierCoefs()
+{
+    std::filesystem::path rootPath = cispp::getRootPath();
+    std::string fp_config = (((rootPath / "test") / "config") / "SingleDelayLinear.yaml");
+    std::filesystem::path fpath = std::filesystem::temp_directory_path() / "cispp_test_sellmeier_coefs.yaml";
+
+    // the config, with the material's coefficients added to the crystal
+    YAML::Node node = YAML::LoadFile(fp_config);
+    cispp::MaterialProperties mp = cispp::GetMaterialProperties("a-BBO");
+    const std::string alphabet = "ABCDEF";
+    for (size_t i = 0; i < mp.sellmeier_e.size(); i++)
+    {
+        node["interferometer"][1]["UniaxialCrystal"]["sellmeier_coefs"][alphabet.substr(i, 1) + "e"] = mp.sellmeier_e[i];
+        node["interferometer"][1]["UniaxialCrystal"]["sellmeier_coefs"][alphabet.substr(i, 1) + "o"] = mp.sellmeier_o[i];
+    }
+    {
+        std::ofstream file(fpath);
+        file << node;
+    }
+    auto inst = cispp::LoadInstrument(fp_config);
+    auto inst_c = cispp::LoadInstrument(fpath);
+    std::filesystem::remove(fpath);
+
+    if (inst_c->components.size() != inst->components.size() || inst_c->type != inst->type) {
+        return false;
+    }
+    return inst_c->components[1]->GetDelay(465e-9, 0.05, 0.3) == inst->components[1]->GetDelay(465e-9, 0.05, 0.3);
+}
+
+
+/**
+ * @brief test the reduced instrument type against the full Mueller matrix calculation, for captures through Capture 
+ * and through the transmission-row path of CaptureQuadrature. The two differ only by rounding, so images may differ by 
+ * at most 1 count
+ * 
+ * @param instname 
+ * @param specname 
+ * @return true 
+ * @return false 
+ */
+bool TestCaptureReduced(std::string instname, std::string specname)
+{
+    std::filesystem::path rootPath = cispp::getRootPath();
+    std::string fp_config = (((rootPath / "test") / "config") / (instname + ".yaml"));
+    auto inst = cispp::LoadInstrument(fp_config);
+    auto inst_m = cispp::LoadInstrument(fp_config, true);  // force_mueller
+    if (inst->type != "reduced") {
+        return false;
+    }
+    std::vector<unsigned short int> image(inst->camera.sensor_format_x * inst->camera.sensor_format_y);
+    std::vector<unsigned short int> image_m(inst->camera.sensor_format_x * inst->camera.sensor_format_y);
+
+    double wavelength = 465e-9;
+    double flux = 500;
+    cispp::Spectrum spec = cispp::gaussian(wavelength, 0.1e-9, flux, 15, 4);
+
+    auto capture = [&](std::unique_ptr<cispp::Instrument>& inst_i, std::vector<unsigned short int>& image_i) {
+        auto start = std::chrono::high_resolution_clock::now();
+        if (specname == "Monochrome") {
+            inst_i->Capture(wavelength, flux, &image_i);
+        }
+        else {
+            inst_i->Capture(spec.wavelength, spec.s0, &image_i);
+        }
+        auto stop = std::chrono::high_resolution_clock::now();
+        return std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count() * 1e-6;
+    };
+    auto max_diff = [&]() {
+        int diff = 0;
+        for (size_t i = 0; i < image.size(); i++) {
+            diff = std::max(diff, std::abs(static_cast<int>(image[i]) - static_cast<int>(image_m[i])));
+        }
+        return diff;
+    };
+
+    std::cout << "duration = " << capture(inst, image) << " s" << '\n';
+    std::cout << "duration (force_mueller) = " << capture(inst_m, image_m) << " s" << '\n';
+    bool ok = (max_diff() <= 1);
+
+    // transmission rows, through CaptureQuadrature
+    inst->CaptureQuadrature(cispp::sampled_quadrature(spec.wavelength, spec.s0, cispp::QuadratureRule::Trapezoid), 
+                            &image);
+    if (specname == "Spectrum") {
+        ok = ok && (max_diff() <= 1);
+    }
+
+    // the transfer function must follow a change of orientation
+    inst->components[1]->orientation += 0.1;
+    inst_m->components[1]->orientation += 0.1;
+    capture(inst, image);
+    capture(inst_m, image_m);
+    return ok && (max_diff() <= 1);
+}
+
+
 int main ()
 {
     std::vector<std::string> instnames { "SingleDelayLinear", "SingleDelayPixelated" };
@@ -122,5 +739,201 @@ int main ()
             std::cout << "\n\n\n";
         }
     }
+
+    for (const std::string& instname: instnames)
+    {
+        for (const std::string& specname: specnames)
+        {
+            std::cout << "TestCaptureParallel" + specname + instname + ":\n";
+            if (TestCaptureParallel(instname, specname))
+            {
+                std::cout << "passed";
+            }
+            else 
+            {
+                std::cout << "failed";
+            }
+            std::cout << "\n\n\n";
+        }
+    }
+
+    for (const std::string& instname: instnames)
+    {
+        for (bool force_mueller: { false, true })
+        {
+            std::cout << "TestCaptureGeometryCache" + instname + (force_mueller ? "ForceMueller" : "") + ":\n";
+            if (TestCaptureGeometryCache(instname, force_mueller))
+            {
+                std::cout << "passed";
+            }
+            else 
+            {
+                std::cout << "failed";
+            }
+            std::cout << "\n\n\n";
+        }
+    }
+
+    for (const std::string& instname: instnames)
+    {
+        std::cout << "TestCaptureCoherence" + instname + ":\n";
+        if (TestCaptureCoherence(instname))
+        {
+            std::cout << "passed";
+        }
+        else 
+        {
+            std::cout << "failed";
+        }
+        std::cout << "\n\n\n";
+    }
+
+    for (const std::string& instname: instnames)
+    {
+        std::cout << "TestCaptureQuadrature" + instname + ":\n";
+        if (TestCaptureQuadrature(instname))
+        {
+            std::cout << "passed";
+        }
+        else 
+        {
+            std::cout << "failed";
+        }
+        std::cout << "\n\n\n";
+    }
+
+    for (const std::string& instname: instnames)
+    {
+        std::cout << "TestCaptureCoherenceTable" + instname + ":\n";
+        if (TestCaptureCoherenceTable(instname))
+        {
+            std::cout << "passed";
+        }
+        else 
+        {
+            std::cout << "failed";
+        }
+        std::cout << "\n\n\n";
+    }
+
+    for (const std::string& instname: instnames)
+    {
+        for (const std::string& specname: specnames)
+        {
+            std::cout << "TestCaptureCompiled" + specname + instname + ":\n";
+            if (TestCaptureCompiled(instname, specname))
+            {
+                std::cout << "passed";
+            }
+            else 
+            {
+                std::cout << "failed";
+            }
+            std::cout << "\n\n\n";
+        }
+    }
+    for (const std::string& instname: instnames)
+    {
+        for (const std::string& specname: specnames)
+        {
+            for (bool force_mueller: { false, true })
+            {
+                std::cout << "TestCapturePrecision" + specname + instname + (force_mueller ? "ForceMueller" : "") + ":\n";
+                if (TestCapturePrecision(instname, specname, force_mueller))
+                {
+                    std::cout << "passed";
+                }
+                else 
+                {
+                    std::cout << "failed";
+                }
+                std::cout << "\n\n\n";
+            }
+        }
+    }
+    for (const std::string& instname: instnames)
+    {
+        for (bool force_mueller: { false, true })
+        {
+            std::cout << "TestCaptureBatch" + instname + (force_mueller ? "ForceMueller" : "") + ":\n";
+            if (TestCaptureBatch(instname, force_mueller))
+            {
+                std::cout << "passed";
+            }
+            else 
+            {
+                std::cout << "failed";
+            }
+            std::cout << "\n\n\n";
+        }
+    }
+    for (const std::string& instname: instnames)
+    {
+        std::cout << "TestCaptureFrameStack" + instname + ":\n";
+        if (TestCaptureFrameStack(instname))
+        {
+            std::cout << "passed";
+        }
+        else 
+        {
+            std::cout << "failed";
+        }
+        std::cout << "\n\n\n";
+    }
+    for (const std::string& instname: instnames)
+    {
+        for (bool force_mueller: { false, true })
+        {
+            std::cout << "TestLoadSnapshot" + instname + (force_mueller ? "ForceMueller" : "") + ":\n";
+            if (TestLoadSnapshot(instname, force_mueller))
+            {
+                std::cout << "passed";
+            }
+            else 
+            {
+                std::cout << "failed";
+            }
+            std::cout << "\n\n\n";
+        }
+    }
+    std::cout << "TestConfigSellmeierCoefs:\n";
+    if (TestConfigSellmeierCoefs())
+    {
+        std::cout << "passed";
+    }
+    else 
+    {
+        std::cout << "failed";
+    }
+    std::cout << "\n\n\n";
+    for (std::string instname: { "MultiDelayLinear", "MultiDelayPixelated" })
+    {
+        for (const std::string& specname: specnames)
+        {
+            std::cout << "TestCaptureReduced" + specname + instname + ":\n";
+            if (TestCaptureReduced(instname, specname))
+            {
+                std::cout << "passed";
+            }
+            else 
+            {
+                std::cout << "failed";
+            }
+            std::cout << "\n\n\n";
+        }
+    }
+    for (const std::string& instname: instnames)
+    {
+        std::cout << "TestCaptureSensor" + instname + ":\n";
+        if (TestCaptureSensor(instname))
+        {
+            std::cout << "passed";
+        }
+        else 
+        {
+            std::cout << "failed";
+        }
+        std::cout << "\n\n\n";
+    }
     return 0;
 }
\ No newline at end of file
@@ -1,7 +1,258 @@
+#include <algorithm>
+#include <chrono>
+#include <functional>
 #include <iostream>
+#include <thread>
+#include <type_traits>
 #include "include/material.h"
 
 
+/**
+ * @brief test lookups by material name and by Sellmeier source
+ */
+bool test_registry_lookup()
+{
+    cispp::MaterialRegistry& registry = cispp::MaterialRegistry::Instance();
+
+    std::vector<std::string> sources = registry.GetSources("b-BBO");
+    if (sources.size() != 4 || sources[0] != "kato1986" || sources[2] != "kato2010") {
+        return false;
+    }
+    cispp::MaterialProperties mp = registry.Get("b-BBO");
+    cispp::MaterialProperties mp_2010 = registry.Get("b-BBO", "kato2010");
+    if (mp.source != "kato1986" || mp.sellmeier_e.size() != 4 || mp_2010.sellmeier_e.size() != 5 || 
+        mp_2010.sellmeier_o[4] != -67.8505) {
+        return false;
+    }
+
+    // the default source is the first listed
+    cispp::MaterialProperties mp_default = cispp::GetMaterialProperties("a-BBO");
+    cispp::MaterialProperties mp_kim = cispp::GetMaterialProperties("a-BBO", "kim");
+    if (mp_default.sellmeier_e != mp_kim.sellmeier_e || mp_default.sellmeier_o != mp_kim.sellmeier_o) {
+        return false;
+    }
+
+    std::vector<std::string> names = registry.GetMaterialNames();
+    if (std::find(names.begin(), names.end(), "calcite") == names.end()) {
+        return false;
+    }
+
+    // invalid names and sources throw
+    std::vector<std::function<void()>> lookups {[&]() { registry.Get("unobtainium"); }, 
+                                                [&]() { registry.Get("a-BBO", "nobody"); }};
+    for (auto& lookup : lookups)
+    {
+        try 
+        {
+            lookup();
+            return false;
+        }
+        catch (const std::logic_error&) {}
+    }
+    return true;
+}
+
+
+/**
+ * @brief test concurrent lookups from several threads, and time repeated lookups
+ */
+bool test_registry_threads()
+{
+    const cispp::MaterialProperties expected = cispp::GetMaterialProperties("calcite");
+    const size_t nthreads = 4;
+    const size_t nlookups = 1000;
+    std::vector<int> ok(nthreads, 1);
+    std::vector<std::thread> threads;
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t t = 0; t < nthreads; t++)
+    {
+        threads.emplace_back([&, t]() 
+        {
+            for (size_t i = 0; i < nlookups; i++)
+            {
+                const std::string name = (i % 2) ? "calcite" : "YVO";
+                cispp::MaterialProperties mp = cispp::GetMaterialProperties(name);
+                if (i % 2 && mp.sellmeier_e != expected.sellmeier_e) {
+                    ok[t] = 0;
+                }
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    auto stop = std::chrono::steady_clock::now();
+    std::cout << "duration (" << nthreads * nlookups << " lookups) = " 
+              << std::chrono::duration<double>(stop - start).count() << " s" << '\n';
+    return std::find(ok.begin(), ok.end(), 0) == ok.end();
+}
+
+
+/**
+ * @brief test that the compiled dispersion models agree exactly with the Sellmeier equations, for every material and 
+ * source, for scalar and array evaluation
+ */
+bool test_dispersion_model()
+{
+    cispp::MaterialRegistry& registry = cispp::MaterialRegistry::Instance();
+    const size_t n = 300;
+    std::vector<double> wl(n), ne(n), no(n);
+    for (size_t i = 0; i < n; i++) {
+        wl[i] = 400e-9 + 300e-9 * i / n;
+    }
+    std::vector<size_t> forms;
+    for (const std::string& name : registry.GetMaterialNames())
+    {
+        for (const std::string& source : registry.GetSources(name))
+        {
+            cispp::MaterialProperties mp = registry.Get(name, source);
+            cispp::DispersionModel model = cispp::MakeDispersionModel(mp);
+            forms.push_back(model.index());
+            std::visit([&](const auto& m) { m(wl.data(), ne.data(), no.data(), n); }, model);
+            for (size_t i = 0; i < n; i++)
+            {
+                const double wl_um2 = pow(wl[i] * 1e6, 2);
+                const std::vector<double>& e = mp.sellmeier_e;
+                const std::vector<double>& o = mp.sellmeier_o;
+                double ne_i, no_i;
+                if (e.size() == 4) 
+                {
+                    ne_i = cispp::SellmeierEqn(wl_um2, e[0], e[1], e[2], e[3]);
+                    no_i = cispp::SellmeierEqn(wl_um2, o[0], o[1], o[2], o[3]);
+                }
+                else if (e.size() == 5) 
+                {
+                    ne_i = cispp::SellmeierEqn(wl_um2, e[0], e[1], e[2], e[3], e[4]);
+                    no_i = cispp::SellmeierEqn(wl_um2, o[0], o[1], o[2], o[3], o[4]);
+                }
+                else 
+                {
+                    ne_i = cispp::SellmeierEqn(wl_um2, e[0], e[1], e[2], e[3], e[4], e[5]);
+                    no_i = cispp::SellmeierEqn(wl_um2, o[0], o[1], o[2], o[3], o[4], o[5]);
+                }
+                std::pair<double, double> neno = std::visit([&](const auto& m) { return m(wl[i]); }, model);
+                if (ne[i] != ne_i || no[i] != no_i || neno.first != ne_i || neno.second != no_i) {
+                    return false;
+                }
+            }
+        }
+    }
+    // all three forms were covered
+    std::sort(forms.begin(), forms.end());
+    return std::unique(forms.begin(), forms.end()) - forms.begin() == 3;
+}
+
+
+/**
+ * @brief Birefringence ne - no and its derivative from a Chebyshev surrogate, or NaN for a Sellmeier equation
+ */
+std::pair<double, double> GetBirefringence(double wavelength, const cispp::DispersionModel& model)
+{
+    return std::visit([wavelength](const auto& m) 
+    {
+        if constexpr (std::is_base_of_v<cispp::ChebyshevBand, std::decay_t<decltype(m)>>) {
+            return m.Birefringence(wavelength);
+        }
+        else {
+            return std::pair<double, double>(NAN, NAN);
+        }
+    }, model);
+}
+
+
+/**
+ * @brief test Chebyshev surrogates against the Sellmeier equations, for every material and source, over a narrow band 
+ * and a broad band: the index and birefringence derivative errors must be within the recorded bounds, and kappa must 
+ * agree with the finite-difference kappa
+ */
+bool test_chebyshev_dispersion()
+{
+    cispp::MaterialRegistry& registry = cispp::MaterialRegistry::Instance();
+    const std::vector<std::pair<double, double>> bands {{464.5e-9, 465.5e-9}, {420e-9, 700e-9}};
+    const size_t n = 2001;
+    size_t degree_max[2] = {0, 0};
+    for (const std::string& name : registry.GetMaterialNames())
+    {
+        for (const std::string& source : registry.GetSources(name))
+        {
+            cispp::MaterialProperties mp = registry.Get(name, source);
+            cispp::DispersionModel model = cispp::MakeDispersionModel(mp);
+            for (size_t iband = 0; iband < bands.size(); iband++)
+            {
+                const double wl_min = bands[iband].first;
+                const double wl_max = bands[iband].second;
+                const cispp::DispersionModel model_c = cispp::MakeChebyshevDispersion(model, wl_min, wl_max);
+                const cispp::ChebyshevBand& band = *cispp::GetChebyshevBand(model_c);
+                degree_max[iband] = std::max(degree_max[iband], band.degree);
+                if (band.error > 1e-12) {
+                    return false;
+                }
+                double err = 0, err_deriv = 0, err_kappa = 0;
+                for (size_t i = 0; i < n; i++)
+                {
+                    const double wl = wl_min + (wl_max - wl_min) * i / (n - 1);
+                    auto get_neno = [&model](double w) {
+                        return std::visit([w](const auto& m) { return m(w); }, model);
+                    };
+                    std::pair<double, double> neno = get_neno(wl);
+                    std::pair<double, double> neno_c = std::visit([wl](const auto& m) { return m(wl); }, model_c);
+                    err = std::max({err, std::abs(neno_c.first - neno.first), std::abs(neno_c.second - neno.second)});
+                    // fourth-order central difference
+                    const double h = 1e-10;
+                    double dbiref = 0;
+                    const double steps[4] = {-2, -1, 1, 2};
+                    const double weights[4] = {1, -8, 8, -1};
+                    for (size_t s = 0; s < 4; s++)
+                    {
+                        std::pair<double, double> neno_s = get_neno(wl + steps[s] * h);
+                        dbiref += weights[s] * (neno_s.first - neno_s.second) / (12 * h);
+                    }
+                    err_deriv = std::max(err_deriv, std::abs(GetBirefringence(wl, model_c).second - dbiref));
+                    err_kappa = std::max(err_kappa, std::abs(cispp::GetKappa(wl, model_c) - cispp::GetKappa(wl, mp)));
+                }
+                // allow for rounding in the Sellmeier and Clenshaw evaluations, and for the finite difference, whose 
+                // error is of order 1e-5 per metre (dn/dwl is of order 1e5 per metre)
+                if (err > band.error + 1e-14 || err_deriv > band.error_deriv + 1e-3 || err_kappa > 1e-6) {
+                    return false;
+                }
+            }
+        }
+    }
+    std::cout << "max degree: " << degree_max[0] << " (1 nm band), " << degree_max[1] << " (280 nm band)\n";
+
+    // outside the band
+    const cispp::DispersionModel model = cispp::MakeDispersionModel(registry.Get("a-BBO"));
+    const cispp::DispersionModel model_c = cispp::MakeChebyshevDispersion(model, bands[0].first, bands[0].second);
+    try 
+    {
+        std::visit([&bands](const auto& m) { return m(bands[0].second + 1e-12); }, model_c);
+        return false;
+    }
+    catch (const std::out_of_range&) {}
+
+    // kappa throughput
+    std::vector<double> wl(100000);
+    for (size_t i = 0; i < wl.size(); i++) {
+        wl[i] = bands[0].first + (bands[0].second - bands[0].first) * i / wl.size();
+    }
+    double sum = 0, sum_c = 0;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (double w : wl) {
+        sum += cispp::GetKappa(w, model);
+    }
+    auto mid = std::chrono::high_resolution_clock::now();
+    for (double w : wl) {
+        sum_c += cispp::GetKappa(w, model_c);
+    }
+    auto stop = std::chrono::high_resolution_clock::now();
+    std::cout << "kappa duration (" << wl.size() << " wavelengths): Sellmeier = " 
+              << std::chrono::duration<double>(mid - start).count() << " s, Chebyshev = " 
+              << std::chrono::duration<double>(stop - mid).count() << " s\n";
+    return std::abs(sum - sum_c) < 1e-6 * wl.size();
+}
+
+
 int main()
 {
     double wavelength = 465e-9;
@@ -9,4 +260,9 @@ int main()
     cispp::MaterialProperties mp = cispp::GetMaterialProperties(material_name);
     std::pair<double,double> nn = cispp::GetRefractiveIndices(wavelength, mp);
     std::cout << nn.first << ' ' << nn.second << std::endl;
-}
\ No newline at end of file
+
+    std::cout << "test_registry_lookup: " << (test_registry_lookup() ? "passed" : "failed") << '\n';
+    std::cout << "test_dispersion_model: " << (test_dispersion_model() ? "passed" : "failed") << '\n';
+    std::cout << "test_chebyshev_dispersion: " << (test_chebyshev_dispersion() ? "passed" : "failed") << '\n';
+    std::cout << "test_registry_threads: " << (test_registry_threads() ? "passed" : "failed") << '\n';
+}
@@ -0,0 +1,92 @@
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+#include "include/parallel.h"
+
+
+/**
+ * @brief test that every tile pixel is covered exactly once
+ */
+bool test_tiles()
+{
+    size_t nx = 37;
+    size_t ny = 23;
+    std::vector<int> count(nx * ny, 0);
+    for (const cispp::Tile& tile : cispp::GetTiles(nx, ny, 8, 5))
+    {
+        for (size_t iy = tile.iy0; iy < tile.iy1; iy++)
+        {
+            for (size_t ix = tile.ix0; ix < tile.ix1; ix++)
+            {
+                count[ix + iy * nx]++;
+            }
+        }
+    }
+    for (int c : count)
+    {
+        if (c != 1) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/**
+ * @brief test that every task runs exactly once, and that the pool can be reused
+ */
+bool test_parallel_for()
+{
+    for (size_t nthreads : {1, 2, 4})
+    {
+        cispp::ThreadPool pool(nthreads);
+        for (size_t repeat = 0; repeat < 3; repeat++)
+        {
+            size_t ntasks = 1000;
+            std::vector<int> count(ntasks, 0);
+            bool worker_ok = true;
+            pool.ParallelFor(ntasks, [&](size_t itask, size_t iworker) {
+                count[itask]++;
+                if (iworker >= pool.GetThreadCount()) {
+                    worker_ok = false;
+                }
+            });
+            for (int c : count)
+            {
+                if (c != 1 || !worker_ok) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+
+/**
+ * @brief test that an exception thrown in a task reaches the caller
+ */
+bool test_parallel_for_exception()
+{
+    cispp::ThreadPool pool(3);
+    try {
+        pool.ParallelFor(100, [](size_t itask, size_t iworker) {
+            if (itask == 50) {
+                throw std::runtime_error("task failed");
+            }
+        });
+    }
+    catch (const std::runtime_error& e) {
+        return true;
+    }
+    return false;
+}
+
+
+int main()
+{
+    std::cout << "test_tiles: " << (test_tiles() ? "passed" : "failed") << '\n';
+    std::cout << "test_parallel_for: " << (test_parallel_for() ? "passed" : "failed") << '\n';
+    std::cout << "test_parallel_for_exception: " << (test_parallel_for_exception() ? "passed" : "failed") << '\n';
+    return 0;
+}
@@ -0,0 +1,114 @@
+#include <atomic>
+#include <iostream>
+#include <chrono>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "include/pipeline.h"
+
+
+/**
+ * @brief test that frames are written in order with the right contents, from a fixed set of reused buffers
+ */
+bool test_pipeline_order()
+{
+    const size_t frame_size = 1000;
+    const size_t nframes = 50;
+    cispp::FramePipeline pipeline(frame_size, 3);
+
+    std::vector<size_t> written;
+    std::set<const unsigned short int*> buffers;
+    bool contents_ok = true;
+
+    cispp::PipelineStats stats = pipeline.Run(nframes, 
+        [&](size_t iframe, std::vector<unsigned short int>* frame) {
+            std::fill(frame->begin(), frame->end(), static_cast<unsigned short int>(iframe));
+        },
+        [&](size_t iframe, std::vector<unsigned short int>* frame) {
+            written.push_back(iframe);
+            buffers.insert(frame->data());
+            contents_ok = contents_ok && frame->size() == frame_size && (*frame)[frame_size - 1] == iframe;
+        }
+    );
+    std::cout << "fps = " << stats.fps << '\n';
+
+    for (size_t i = 0; i < written.size(); i++)
+    {
+        if (written[i] != i) {
+            return false;
+        }
+    }
+    return contents_ok && written.size() == nframes && stats.nframes == nframes && buffers.size() <= 3 + 1;
+}
+
+
+/**
+ * @brief test that a slow writer blocks capture once the queue is full
+ */
+bool test_pipeline_backpressure()
+{
+    const size_t queue_depth = 2;
+    cispp::FramePipeline pipeline(10, queue_depth);
+    std::atomic<size_t> ncaptured {0};
+    std::atomic<size_t> nwritten {0};
+    size_t ahead_max = 0;
+
+    pipeline.Run(20, 
+        [&](size_t iframe, std::vector<unsigned short int>* frame) {
+            ncaptured++;
+        },
+        [&](size_t iframe, std::vector<unsigned short int>* frame) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            // frames captured (or being captured) and waiting to be written, besides this one
+            ahead_max = std::max(ahead_max, ncaptured.load() - nwritten.load() - 1);
+            nwritten++;
+        }
+    );
+    return nwritten == 20 && ahead_max <= queue_depth;
+}
+
+
+/**
+ * @brief test that an exception in either stage reaches the caller, and that the pipeline can be rerun
+ */
+bool test_pipeline_exception()
+{
+    cispp::FramePipeline pipeline(10, 2);
+    auto capture_ok = [](size_t iframe, std::vector<unsigned short int>* frame) {};
+    auto write_ok = [](size_t iframe, std::vector<unsigned short int>* frame) {};
+    auto capture_fail = [](size_t iframe, std::vector<unsigned short int>* frame) {
+        if (iframe == 5) {
+            throw std::runtime_error("capture failed");
+        }
+    };
+    auto write_fail = [](size_t iframe, std::vector<unsigned short int>* frame) {
+        if (iframe == 5) {
+            throw std::runtime_error("write failed");
+        }
+    };
+
+    size_t ncaught = 0;
+    try {
+        pipeline.Run(20, capture_fail, write_ok);
+    }
+    catch (const std::runtime_error& e) {
+        ncaught++;
+    }
+    try {
+        pipeline.Run(20, capture_ok, write_fail);
+    }
+    catch (const std::runtime_error& e) {
+        ncaught++;
+    }
+    return ncaught == 2 && pipeline.Run(20, capture_ok, write_ok).nframes == 20;
+}
+
+
+int main()
+{
+    std::cout << "test_pipeline_order: " << (test_pipeline_order() ? "passed" : "failed") << '\n';
+    std::cout << "test_pipeline_backpressure: " << (test_pipeline_backpressure() ? "passed" : "failed") << '\n';
+    std::cout << "test_pipeline_exception: " << (test_pipeline_exception() ? "passed" : "failed") << '\n';
+    return 0;
+}
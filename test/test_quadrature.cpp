@@ -0,0 +1,175 @@
+#include <complex>
+#include <iostream>
+#include "include/coherence.h"
+#include "include/quadrature.h"
+#include "include/spectrum.h"
+
+
+/**
+ * @brief coherence of a quadrature grid, sum_i weight_i exp(i delay wld / wl_i)
+ */
+std::complex<double> get_coherence(const cispp::QuadratureGrid& grid, double delay, double wld)
+{
+    std::complex<double> out = 0;
+    for (size_t i = 0; i < grid.wavelength.size(); i++) {
+        out += grid.weight[i] * std::exp(std::complex<double>(0, delay * wld / grid.wavelength[i]));
+    }
+    return out;
+}
+
+
+/**
+ * @brief test that the trapezoidal weights reproduce trapz, and that the Simpson weights integrate quadratics exactly
+ * on non-uniform grids with odd and even numbers of intervals
+ */
+bool test_sampled_weights()
+{
+    for (size_t n : {2, 3, 4, 7, 10})
+    {
+        std::vector<double> x(n), y(n);
+        for (size_t i = 0; i < n; i++)
+        {
+            x[i] = i + 0.3 * std::sin(3. * i);
+            y[i] = 2 - x[i] + 0.5 * x[i] * x[i];
+        }
+        std::vector<double> w_t = cispp::trapz_weights(x);
+        std::vector<double> w_s = cispp::simpson_weights(x);
+        double sum_t = 0, sum_s = 0;
+        for (size_t i = 0; i < n; i++)
+        {
+            sum_t += w_t[i] * y[i];
+            sum_s += w_s[i] * y[i];
+        }
+        auto antiderivative = [](double x) {
+            return 2 * x - 0.5 * x * x + x * x * x / 6;
+        };
+        const double exact = antiderivative(x[n - 1]) - antiderivative(x[0]);
+        if (std::abs(sum_t - cispp::trapz(x, y)) > 1e-12 * std::abs(exact)) {
+            return false;
+        }
+        if (n > 2 && std::abs(sum_s - exact) > 1e-12 * std::abs(exact)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/**
+ * @brief test Gauss-Hermite grids for a multiplet against the lines' analytic coherences, and report the node count
+ * of a uniform trapezoidal grid of the same accuracy
+ */
+bool test_gauss_hermite()
+{
+    std::vector<cispp::SpectralLine> lines {{464.742e-9, 0.05e-9, 500}, {465.025e-9, 0.05e-9, 300},
+                                            {465.147e-9, 0.05e-9, 100}};
+    const double flux = 900;
+    const double wld = 464e-9;
+    const std::vector<double> delays {0., 2e3, 5e3, 1e4};
+    auto get_error = [&](const cispp::QuadratureGrid& grid)
+    {
+        double err = 0;
+        for (double delay : delays)
+        {
+            std::complex<double> coherence_a = 0;
+            for (const cispp::SpectralLine& line : lines) {
+                coherence_a += cispp::coherence_gaussian(line.wavelength, line.sigma, line.flux, delay, wld);
+            }
+            err = std::max(err, std::abs(get_coherence(grid, delay, wld) - coherence_a) / flux);
+        }
+        return err;
+    };
+
+    const size_t n = 16;
+    cispp::QuadratureGrid grid_gh = cispp::gauss_hermite(lines, n);
+    const double err_gh = get_error(grid_gh);
+
+    // uniform trapezoidal grids over the lines, doubled until they match the Gauss-Hermite accuracy
+    auto get_s0 = [&](double wl)
+    {
+        double s0 = 0;
+        for (const cispp::SpectralLine& line : lines)
+        {
+            const double c = (line.sigma + line.wavelength) / line.sigma;
+            const double u = (line.wavelength - wl) / wl;
+            s0 += line.flux * c * line.wavelength / (std::sqrt(2 * M_PI) * wl * wl) * std::exp(-0.5 * u * u * c * c);
+        }
+        return s0;
+    };
+    const double wl_min = lines.front().wavelength - 10 * lines.front().sigma;
+    const double wl_max = lines.back().wavelength + 10 * lines.back().sigma;
+    size_t nbins = n;
+    double err_t = 1;
+    while (err_t > err_gh && nbins < 100000)
+    {
+        nbins *= 2;
+        std::vector<double> wl(nbins), s0(nbins);
+        for (size_t i = 0; i < nbins; i++)
+        {
+            wl[i] = wl_min + (wl_max - wl_min) * i / (nbins - 1);
+            s0[i] = get_s0(wl[i]);
+        }
+        err_t = get_error(cispp::sampled_quadrature(wl, s0, cispp::QuadratureRule::Trapezoid));
+    }
+    std::cout << "Gauss-Hermite: " << lines.size() * n << " nodes, error = " << err_gh << "; trapezoid: " << nbins
+              << " nodes, error = " << err_t << '\n';
+    return err_gh < 1e-8;
+}
+
+
+/**
+ * @brief test Clenshaw-Curtis, Simpson and adaptive Simpson on a broad smooth spectrum with a narrow feature
+ */
+bool test_smooth_spectrum()
+{
+    const double wl_min = 450e-9;
+    const double wl_max = 480e-9;
+    auto spec_flux = [](double wl) {
+        const double x = (wl - 465e-9) / 10e-9;
+        return 1e11 * (1 + 0.5 * x - 0.3 * x * x) + 5e11 * std::exp(-0.5 * std::pow((wl - 470e-9) / 0.3e-9, 2));
+    };
+    const double wld = 464e-9;
+    const double delay = 50.;
+
+    // reference: fine Simpson grid
+    const size_t nref = 200001;
+    std::vector<double> wl(nref), s0(nref);
+    for (size_t i = 0; i < nref; i++)
+    {
+        wl[i] = wl_min + (wl_max - wl_min) * i / (nref - 1);
+        s0[i] = spec_flux(wl[i]);
+    }
+    cispp::QuadratureGrid grid_ref = cispp::sampled_quadrature(wl, s0, cispp::QuadratureRule::Simpson);
+    const std::complex<double> coherence_ref = get_coherence(grid_ref, delay, wld);
+    double flux_ref = 0;
+    for (double w : grid_ref.weight) {
+        flux_ref += w;
+    }
+
+    cispp::QuadratureGrid grid_cc = cispp::clenshaw_curtis(spec_flux, wl_min, wl_max, 256);
+    const double err_cc = std::abs(get_coherence(grid_cc, delay, wld) - coherence_ref) / flux_ref;
+
+    const double tol = 1e-8;
+    cispp::QuadratureGrid grid_a = cispp::adaptive_simpson(spec_flux, wl_min, wl_max, tol);
+    double flux_a = 0;
+    for (double w : grid_a.weight) {
+        flux_a += w;
+    }
+    const double err_a = std::abs(get_coherence(grid_a, delay, wld) - coherence_ref) / flux_ref;
+
+    std::cout << "Clenshaw-Curtis: " << grid_cc.wavelength.size() << " nodes, error = " << err_cc << '\n';
+    std::cout << "adaptive Simpson: " << grid_a.wavelength.size() << " nodes, error = " << err_a
+              << ", flux error = " << std::abs(flux_a - flux_ref) / flux_ref << ", estimate = "
+              << grid_a.error / flux_ref << '\n';
+    return (err_cc < 1e-8 && err_a < 1e-6 && std::abs(flux_a - flux_ref) < 10 * tol * flux_ref &&
+            grid_a.error < 10 * tol * flux_ref);
+}
+
+
+int main()
+{
+    std::cout << "test_sampled_weights: " << (test_sampled_weights() ? "passed" : "failed") << '\n';
+    std::cout << "test_gauss_hermite: " << (test_gauss_hermite() ? "passed" : "failed") << '\n';
+    std::cout << "test_smooth_spectrum: " << (test_smooth_spectrum() ? "passed" : "failed") << '\n';
+    return 0;
+}
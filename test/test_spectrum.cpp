@@ -1,6 +1,37 @@
 #include "include/spectrum.h"
 
 
+/**
+ * @brief test that a multiplet integrates to its total flux within the tolerance, and that a tighter tolerance gives 
+ * more bins
+ */
+bool test_gaussian_multiplet()
+{
+    // C III triplet and He II line
+    std::vector<cispp::SpectralLine> lines {{464.742e-9, 0.02e-9, 500}, {465.025e-9, 0.02e-9, 300}, 
+                                            {465.147e-9, 0.02e-9, 100}, {468.6e-9, 0.05e-9, 200}};
+    const double flux = 1100;
+    size_t nbins_prev = 0;
+    for (double tol : {1e-4, 1e-6, 1e-8})
+    {
+        cispp::Spectrum spec = cispp::get_gaussian_multiplet(lines, tol);
+        double flux_n = cispp::trapz(spec.wavelength, spec.s0);
+        std::cout << "tol = " << tol << ", nbins = " << spec.wavelength.size() << ", flux_n = " << flux_n << '\n';
+        for (size_t i = 1; i < spec.wavelength.size(); i++)
+        {
+            if (spec.wavelength[i] <= spec.wavelength[i - 1]) {
+                return false;
+            }
+        }
+        if (std::abs(flux_n - flux) > tol * flux || spec.wavelength.size() <= nbins_prev) {
+            return false;
+        }
+        nbins_prev = spec.wavelength.size();
+    }
+    return true;
+}
+
+
 int main()
 {
     double wl0 = 465e-9;
@@ -12,5 +43,7 @@ int main()
     double flux_n = cispp::trapz(spec.wavelength, spec.s0);
     std::cout << "flux = " << flux << '\n';
     std::cout << "flux_n = " << flux_n << '\n';
+
+    std::cout << "test_gaussian_multiplet: " << (test_gaussian_multiplet() ? "passed" : "failed") << '\n';
     return 0;
 }
\ No newline at end of file
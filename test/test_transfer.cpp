@@ -0,0 +1,200 @@
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+#include "include/component.h"
+#include "include/transfer.h"
+
+
+/**
+ * @brief Linear polariser that reports an angle dependence, standing in for a non-ideal component
+ */
+class AngleDependentPolariser: public cispp::Polariser
+{
+    public:
+
+    AngleDependentPolariser(double orientation)
+    : cispp::Polariser(orientation)
+    {}
+
+    bool IsAngleDependent() override {
+        return true;
+    }
+};
+
+
+/**
+ * @brief test the reduced transfer function against the Mueller matrix product of the chain, at rays of random
+ * wavelength and direction, for each camera variant
+ */
+bool test_reduce(std::vector<std::unique_ptr<cispp::Component>>& components,
+                 const std::vector<Eigen::Matrix4d>& camera_mueller, size_t ndelays)
+{
+    cispp::TransferFunction transfer;
+    if (!cispp::ReduceInterferometer(components, camera_mueller, &transfer)) {
+        return false;
+    }
+    const size_t nvariants = camera_mueller.empty() ? 1 : camera_mueller.size();
+    if (transfer.icomp.size() != ndelays || transfer.GetVariantCount() != nvariants) {
+        return false;
+    }
+
+    std::mt19937 gen(1);
+    std::uniform_real_distribution<double> uniform(0, 1);
+    std::vector<double> delay(ndelays);
+    for (size_t itest = 0; itest < 100; itest++)
+    {
+        const double wavelength = 450e-9 + 50e-9 * uniform(gen);
+        const double inc_angle = 0.1 * uniform(gen);
+        const double azim_angle = 2 * M_PI * uniform(gen);
+        Eigen::Matrix4d mtot = Eigen::Matrix4d::Identity();
+        for (const std::unique_ptr<cispp::Component>& component : components) {
+            mtot = mtot * component->GetMuellerMatrix(wavelength, inc_angle, azim_angle);
+        }
+        for (size_t k = 0; k < ndelays; k++) {
+            delay[k] = components[transfer.icomp[k]]->GetDelay(wavelength, inc_angle, azim_angle);
+        }
+        for (size_t v = 0; v < nvariants; v++)
+        {
+            const double t_mueller = camera_mueller.empty() ? mtot(0, 0) : (mtot * camera_mueller[v])(0, 0);
+            if (std::abs(transfer.Evaluate(delay.data(), v) - t_mueller) > 1e-12) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+
+/**
+ * @brief test reduction of single- and multi-delay chains, with and without a pixelated polariser camera
+ */
+bool test_reduce_chains()
+{
+    std::vector<Eigen::Matrix4d> camera_pixelated;
+    for (double orientation : {0., M_PI / 4, 3 * M_PI / 4, M_PI / 2}) {
+        camera_pixelated.push_back(cispp::Polariser(orientation).GetMuellerMatrix());
+    }
+
+    std::vector<std::unique_ptr<cispp::Component>> single;
+    single.push_back(std::make_unique<cispp::Polariser>(0));
+    single.push_back(std::make_unique<cispp::UniaxialCrystal>(M_PI / 4, 0, 0, 4e-3, M_PI / 4, "a-BBO"));
+    single.push_back(std::make_unique<cispp::Polariser>(0));
+
+    std::vector<std::unique_ptr<cispp::Component>> multi;
+    multi.push_back(std::make_unique<cispp::Polariser>(0));
+    multi.push_back(std::make_unique<cispp::UniaxialCrystal>(M_PI / 4, 0, 0, 4e-3, M_PI / 4, "a-BBO"));
+    multi.push_back(std::make_unique<cispp::UniaxialCrystal>(M_PI / 8, 0, 0, 6e-3, 0, "a-BBO"));
+    multi.push_back(std::make_unique<cispp::Polariser>(0));
+
+    std::vector<std::unique_ptr<cispp::Component>> multi_pixelated;
+    multi_pixelated.push_back(std::make_unique<cispp::Polariser>(0));
+    multi_pixelated.push_back(std::make_unique<cispp::UniaxialCrystal>(M_PI / 4, 0, 0, 4e-3, M_PI / 4, "a-BBO"));
+    multi_pixelated.push_back(std::make_unique<cispp::UniaxialCrystal>(M_PI / 8, 0, 0, 6e-3, 0, "a-BBO"));
+    multi_pixelated.push_back(std::make_unique<cispp::QuarterWaveplate>(M_PI / 2));
+
+    return (test_reduce(single, {}, 1) && test_reduce(multi, {}, 2) && test_reduce(multi, camera_pixelated, 2) &&
+            test_reduce(multi_pixelated, camera_pixelated, 2));
+}
+
+
+/**
+ * @brief test the closed form of the single-delay linear interferometer, t = (1 + cos(delay)) / 4
+ */
+bool test_single_delay_terms()
+{
+    std::vector<std::unique_ptr<cispp::Component>> components;
+    components.push_back(std::make_unique<cispp::Polariser>(0));
+    components.push_back(std::make_unique<cispp::UniaxialCrystal>(M_PI / 4, 0, 0, 4e-3, M_PI / 4, "a-BBO"));
+    components.push_back(std::make_unique<cispp::Polariser>(0));
+    cispp::TransferFunction transfer;
+    if (!cispp::ReduceInterferometer(components, {}, &transfer) || transfer.terms.size() != 1) {
+        return false;
+    }
+    const cispp::FourierTerm& term = transfer.terms[0];
+    return (std::abs(transfer.constant[0] - 0.25) < 1e-15 && term.m == std::vector<int>{1} &&
+            std::abs(term.a[0] - 0.25) < 1e-15 && std::abs(term.b[0]) < 1e-15);
+}
+
+
+/**
+ * @brief test that the batch kernel agrees with the scalar evaluation
+ */
+bool test_evaluate_batch()
+{
+    std::vector<Eigen::Matrix4d> camera_pixelated;
+    for (double orientation : {0., M_PI / 4, 3 * M_PI / 4, M_PI / 2}) {
+        camera_pixelated.push_back(cispp::Polariser(orientation).GetMuellerMatrix());
+    }
+    std::vector<std::unique_ptr<cispp::Component>> components;
+    components.push_back(std::make_unique<cispp::Polariser>(0));
+    components.push_back(std::make_unique<cispp::UniaxialCrystal>(M_PI / 4, 0, 0, 4e-3, M_PI / 4, "a-BBO"));
+    components.push_back(std::make_unique<cispp::UniaxialCrystal>(M_PI / 8, 0, 0, 6e-3, 0, "a-BBO"));
+    components.push_back(std::make_unique<cispp::UniaxialCrystal>(M_PI / 3, 0, 0, 2e-3, M_PI / 4, "a-BBO"));
+    cispp::TransferFunction transfer;
+    if (!cispp::ReduceInterferometer(components, camera_pixelated, &transfer)) {
+        return false;
+    }
+
+    const size_t n = 257;
+    const size_t ndelays = transfer.icomp.size();
+    std::vector<std::vector<double>> delay(ndelays, std::vector<double>(n));
+    std::vector<const double*> delay_row(ndelays);
+    std::vector<uint8_t> variant(n);
+    for (size_t k = 0; k < ndelays; k++)
+    {
+        for (size_t i = 0; i < n; i++) {
+            delay[k][i] = 1e3 * (k + 1) + 0.37 * i * (k + 2);
+        }
+        delay_row[k] = delay[k].data();
+    }
+    for (size_t i = 0; i < n; i++) {
+        variant[i] = i % 4;
+    }
+    std::vector<double> scratch((2 * ndelays + 2) * n);
+    std::vector<double> t(n);
+    transfer.EvaluateBatch(delay_row.data(), variant.data(), n, scratch.data(), t.data());
+
+    std::vector<double> delay_i(ndelays);
+    for (size_t i = 0; i < n; i++)
+    {
+        for (size_t k = 0; k < ndelays; k++) {
+            delay_i[k] = delay[k][i];
+        }
+        if (std::abs(t[i] - transfer.Evaluate(delay_i.data(), variant[i])) > 1e-12) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/**
+ * @brief test that chains with non-ideal components, or too many delays, do not reduce
+ */
+bool test_no_reduce()
+{
+    std::vector<std::unique_ptr<cispp::Component>> components;
+    components.push_back(std::make_unique<AngleDependentPolariser>(0));
+    components.push_back(std::make_unique<cispp::UniaxialCrystal>(M_PI / 4, 0, 0, 4e-3, M_PI / 4, "a-BBO"));
+    components.push_back(std::make_unique<cispp::Polariser>(0));
+    cispp::TransferFunction transfer;
+    if (cispp::ReduceInterferometer(components, {}, &transfer)) {
+        return false;
+    }
+
+    components[0] = std::make_unique<cispp::Polariser>(0);
+    return (cispp::ReduceInterferometer(components, {}, &transfer) &&
+            !cispp::ReduceInterferometer(components, {}, &transfer, 0));
+}
+
+
+int main()
+{
+    std::cout << "test_reduce_chains: " << (test_reduce_chains() ? "passed" : "failed") << '\n';
+    std::cout << "test_single_delay_terms: " << (test_single_delay_terms() ? "passed" : "failed") << '\n';
+    std::cout << "test_evaluate_batch: " << (test_evaluate_batch() ? "passed" : "failed") << '\n';
+    std::cout << "test_no_reduce: " << (test_no_reduce() ? "passed" : "failed") << '\n';
+    return 0;
+}